@@ -36,7 +36,15 @@
 #include "stm32f1xx_it.h"
 
 /* USER CODE BEGIN 0 */
-
+#include "cpuload.h"
+extern DMA_HandleTypeDef hdma_usart3_tx;
+extern DMA_HandleTypeDef hdma_usart3_rx;
+extern void sched_irq(void);
+extern void midi_in_uart_irq(void);
+extern DMA_HandleTypeDef hdma_usart2_tx;
+extern DMA_HandleTypeDef hdma_usart2_rx;
+extern void hostlink_uart_irq(void);
+extern DMA_HandleTypeDef hdma_tim4_ch1;
 /* USER CODE END 0 */
 
 /* External variables --------------------------------------------------------*/
@@ -61,11 +69,12 @@ extern UART_HandleTypeDef huart3;
 void DMA1_Channel4_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel4_IRQn 0 */
+  cpuload_irq_enter();
 
   /* USER CODE END DMA1_Channel4_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_tim1_ch4_trig_com);
   /* USER CODE BEGIN DMA1_Channel4_IRQn 1 */
-
+  cpuload_irq_exit(CPULOAD_KEYMAT);
   /* USER CODE END DMA1_Channel4_IRQn 1 */
 }
 
@@ -75,11 +84,12 @@ void DMA1_Channel4_IRQHandler(void)
 void DMA1_Channel5_IRQHandler(void)
 {
   /* USER CODE BEGIN DMA1_Channel5_IRQn 0 */
+  cpuload_irq_enter();
 
   /* USER CODE END DMA1_Channel5_IRQn 0 */
   HAL_DMA_IRQHandler(&hdma_tim1_up);
   /* USER CODE BEGIN DMA1_Channel5_IRQn 1 */
-
+  cpuload_irq_exit(CPULOAD_KEYMAT);
   /* USER CODE END DMA1_Channel5_IRQn 1 */
 }
 
@@ -89,15 +99,105 @@ void DMA1_Channel5_IRQHandler(void)
 void USART3_IRQHandler(void)
 {
   /* USER CODE BEGIN USART3_IRQn 0 */
-
+  cpuload_irq_enter();
+  midi_in_uart_irq();
   /* USER CODE END USART3_IRQn 0 */
   HAL_UART_IRQHandler(&huart3);
   /* USER CODE BEGIN USART3_IRQn 1 */
-
+  cpuload_irq_exit(CPULOAD_MIDI);
   /* USER CODE END USART3_IRQn 1 */
 }
 
 /* USER CODE BEGIN 1 */
 
+/**
+* @brief This function handles DMA1 channel2 global interrupt (USART3 TX, see midi_out.cpp).
+*/
+void DMA1_Channel2_IRQHandler(void)
+{
+  cpuload_irq_enter();
+  HAL_DMA_IRQHandler(&hdma_usart3_tx);
+  cpuload_irq_exit(CPULOAD_MIDI);
+}
+
+/**
+* @brief This function handles DMA1 channel3 global interrupt (USART3 RX, see midi_in.cpp).
+*/
+void DMA1_Channel3_IRQHandler(void)
+{
+  cpuload_irq_enter();
+  HAL_DMA_IRQHandler(&hdma_usart3_rx);
+  cpuload_irq_exit(CPULOAD_MIDI);
+}
+
+/**
+* @brief This function handles DMA1 channel6 global interrupt (USART2 RX, see hostlink.cpp).
+*/
+void DMA1_Channel6_IRQHandler(void)
+{
+  cpuload_irq_enter();
+  HAL_DMA_IRQHandler(&hdma_usart2_rx);
+  cpuload_irq_exit(CPULOAD_HOSTLINK);
+}
+
+/**
+* @brief This function handles DMA1 channel7 global interrupt (USART2 TX, see hostlink.cpp).
+*/
+void DMA1_Channel7_IRQHandler(void)
+{
+  cpuload_irq_enter();
+  HAL_DMA_IRQHandler(&hdma_usart2_tx);
+  cpuload_irq_exit(CPULOAD_HOSTLINK);
+}
+
+/**
+* @brief This function handles USART2 global interrupt (host link, see hostlink.cpp).
+*/
+void USART2_IRQHandler(void)
+{
+  cpuload_irq_enter();
+  hostlink_uart_irq();
+  cpuload_irq_exit(CPULOAD_HOSTLINK);
+}
+
+/**
+* @brief This function handles TIM2 global interrupt (output scheduling, see sched.cpp).
+*/
+void TIM2_IRQHandler(void)
+{
+  cpuload_irq_enter();
+  sched_irq();
+  cpuload_irq_exit(CPULOAD_SCHED);
+}
+
+/**
+* @brief This function handles DMA1 channel1 global interrupt (TIM4 CH1, see synth_pwm.cpp).
+*/
+void DMA1_Channel1_IRQHandler(void)
+{
+  cpuload_irq_enter();
+  HAL_DMA_IRQHandler(&hdma_tim4_ch1);
+  cpuload_irq_exit(CPULOAD_SYNTH);
+}
+
+/*
+ * EXTI: only armed while the keyboard matrix sleeps (wake-up on any column);
+ * all lines are forwarded, HAL_GPIO_EXTI_Callback() lives in keymat.cpp
+ */
+
+void EXTI0_IRQHandler(void)     { HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_0); }
+void EXTI1_IRQHandler(void)     { HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_1); }
+void EXTI2_IRQHandler(void)     { HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_2); }
+void EXTI3_IRQHandler(void)     { HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_3); }
+void EXTI4_IRQHandler(void)     { HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_4); }
+void EXTI9_5_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_5|GPIO_PIN_6|GPIO_PIN_7|GPIO_PIN_8|GPIO_PIN_9);
+}
+void EXTI15_10_IRQHandler(void)
+{
+  HAL_GPIO_EXTI_IRQHandler(GPIO_PIN_10|GPIO_PIN_11|GPIO_PIN_12|GPIO_PIN_13|GPIO_PIN_14|GPIO_PIN_15);
+}
+
 /* USER CODE END 1 */
 /************************ (C) COPYRIGHT STMicroelectronics *****END OF FILE****/
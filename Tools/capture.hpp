@@ -0,0 +1,76 @@
+#pragma once
+
+// raw scan capture file (host side): a recorded scan stream, replayable
+// through the debouncer (see keymat_replay.cpp)
+// file: | magic "KMC1" (4) | row_n (1) | col_n (1) | field period us (2) | packet ... |
+// packet: | length (2) | scope packet (see User/scope_codec.hpp) |
+// - multi-byte values are little-endian
+// - timing: field number x field period; fields missing between packets
+//   (lost on the link) keep the rows of the last field before them
+// - recorded on the instrument: the SCAN channel payloads as received (see
+//   scan_scope.cpp `--capture`); synthesized: any sequence of fields through
+//   `CaptureWriter`
+
+#include <stdio.h>
+#include <string.h>
+
+#include "keymat_conf.hpp"
+#include "scope_codec.hpp"
+
+static const char CAPTURE_MAGIC[4] = {'K', 'M', 'C', '1'};
+static const size_t CAPTURE_HEADER_n = 8;
+static const size_t CAPTURE_PACKET_MAX = 0xFFFF;
+
+static inline bool capture_write_header(FILE* f) {
+    uint8_t h[CAPTURE_HEADER_n];
+    memcpy(h, CAPTURE_MAGIC, 4);
+    h[4] = KEYMAT_ROW_n;
+    h[5] = KEYMAT_COL_n;
+    h[6] = KEYMAT_FIELD_PERIOD_Tus;
+    h[7] = KEYMAT_FIELD_PERIOD_Tus >> 8;
+    return fwrite(h, 1, sizeof(h), f) == sizeof(h);
+}
+
+static inline bool capture_write_packet(FILE* f, const uint8_t* p, size_t n) {
+    uint8_t len[2] = {(uint8_t)n, (uint8_t)(n >> 8)};
+    return n <= CAPTURE_PACKET_MAX && fwrite(len, 1, 2, f) == 2 && fwrite(p, 1, n, f) == n;
+}
+
+// return: false unless a capture of this matrix at this scan rate
+static inline bool capture_read_header(FILE* f) {
+    uint8_t h[CAPTURE_HEADER_n];
+    if (fread(h, 1, sizeof(h), f) != sizeof(h)) return false;
+    return !memcmp(h, CAPTURE_MAGIC, 4) && h[4] == KEYMAT_ROW_n && h[5] == KEYMAT_COL_n
+        && (h[6] | (h[7] << 8)) == KEYMAT_FIELD_PERIOD_Tus;
+}
+
+// p: at least CAPTURE_PACKET_MAX bytes
+// return: packet length, or -1 at the end of the file
+static inline long capture_read_packet(FILE* f, uint8_t* p) {
+    uint8_t len[2];
+    if (fread(len, 1, 2, f) != 2) return -1;
+    size_t n = len[0] | (len[1] << 8);
+    return fread(p, 1, n, f) == n ? (long)n : -1;
+}
+
+// synthesized capture: one field at a time (same layout as `keymat_state`),
+// starting at field 0
+struct CaptureWriter {
+    FILE* f;
+    ScopeEncoder enc;
+    uint8_t buf[4096];
+
+    explicit CaptureWriter(FILE* f) : f(f) {
+        enc.reset();
+        enc.open(buf, sizeof(buf));
+    }
+
+    bool add(const uint16_t* rows) {
+        if (enc.add(rows)) return true;
+        if (!capture_write_packet(f, buf, enc.close())) return false;
+        enc.open(buf, sizeof(buf));
+        return enc.add(rows);
+    }
+
+    bool close() { return capture_write_packet(f, buf, enc.close()); }
+};
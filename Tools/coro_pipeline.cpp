@@ -0,0 +1,220 @@
+// coroutine pipeline simulation (host side, see User/coro.hpp): the event
+// pipeline written as cooperative tasks, run against a simulated tick
+// - "ISR": the firmware's own debouncing (User/keymat_debounce.cpp) on a
+//   benchmark pattern (see User/keymat_bench.hpp), key events into a ring
+// - map task: keymap => MIDI 1.0 message => transmit ring
+// - transmit task: one message at a time over a simulated DMA UART (31250
+//   baud), waiting for the transfer-complete signal
+// - stats task: samples the transmit queue depth every few ms
+//
+//   g++ -std=c++11 -O2 -IUser -o coro_pipeline Tools/coro_pipeline.cpp User/coro.cpp User/keymat_bench.cpp User/keymat_debounce.cpp User/keymap.cpp User/midi_event.cpp User/midi1.cpp
+//   ./coro_pipeline [idle|chord|bounce]    # default: chord
+//
+// output: one line per message sent (time the transfer completed)
+//   <time us> midi <MIDI 1.0 message (hex)> <latency us>
+// latency: from the end of the field that produced the key event
+// stderr: summary (events, drops, queue depths, executor passes, host ns per
+// task switch, task sizes)
+// exit status: 0 if no key event was dropped
+// NOTE: bounce overloads the output on purpose: every key pressed and
+// released every 25.6ms (~7800 events per second), ~8 times what 31250 baud
+// carries (~1000 messages per second) -- the ring fills up, and the drops
+// show it
+
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "coro.hpp"
+#include "keymap.hpp"
+#include "keymat_bench.hpp"
+#include "keymat_debounce.hpp"
+#include "midi1.hpp"
+#include "ring.hpp"
+
+
+// simulated time
+static uint32_t now_us = 0;
+static uint32_t sim_tick() { return now_us / 1000; }
+
+struct KeyRaw {
+    uint8_t ri, ci;
+    bool state;
+    uint32_t t_us;
+};
+
+struct Msg {
+    uint8_t data[3];
+    uint8_t n;
+    uint32_t t_us; // key event time
+};
+
+// worst burst: every key changes state in the same field (e.g. CHORD)
+static Ring<KeyRaw, 128> key_ring;  // ISR => map
+static_assert(KEYMAT_ROW_n * KEYMAT_COL_n <= 128, "key ring too small for a full field");
+static Ring<Msg, 8> tx_ring;        // map => transmit
+static uint32_t key_events = 0;
+static uint32_t key_drops = 0;
+static size_t key_max = 0;
+static uint32_t messages = 0;
+
+// "ISR" side
+static void key_handler(uint8_t ri, uint8_t ci, bool state) {
+    KeyRaw k = {ri, ci, state, now_us};
+    ++key_events;
+    if (!key_ring.push(k)) ++key_drops;
+    if (key_ring.size() > key_max) key_max = key_ring.size();
+}
+
+// simulated DMA UART: busy until `dma_end_us`, then raises `dma_done`
+static CoroSignal dma_done;
+static bool dma_busy = false;
+static uint32_t dma_end_us = 0;
+static const uint32_t BYTE_us = 320; // 10 bits @ 31250 baud
+
+static void dma_start(uint8_t n) {
+    dma_busy = true;
+    dma_end_us = now_us + n * BYTE_us;
+}
+
+static void dma_poll() {
+    if (dma_busy && (int32_t)(now_us - dma_end_us) >= 0) {
+        dma_busy = false;
+        dma_done.raise();
+    }
+}
+
+
+////////////////////////////////////////
+// tasks
+
+// NOTE: `midi1_encode` reports through a plain callback -- staged here, the
+// task then waits for room in the ring
+static Msg* map_staged;
+static void map_output(const uint8_t* msg, size_t n) {
+    if (n > sizeof(map_staged->data)) n = sizeof(map_staged->data);
+    memcpy(map_staged->data, msg, n);
+    map_staged->n = n;
+}
+
+struct MapTask : Coro {
+    KeyRaw k;
+    Msg msg;
+
+    MapTask() : Coro(body) {}
+
+    static bool body(Coro& c) {
+        MapTask& t = static_cast<MapTask&>(c);
+        CORO_BEGIN(c);
+        while (1) {
+            CORO_AWAIT_POP(c, key_ring, t.k);
+            {
+                uint8_t note = t.k.state ? keymap_press(t.k.ri, t.k.ci) : keymap_release(t.k.ri, t.k.ci);
+                if (note == KEYMAP_NONE) continue;
+                MidiEvent e = MidiEvent();
+                e.type = t.k.state ? MIDI_EV_NOTE_ON : MIDI_EV_NOTE_OFF;
+                e.note = note;
+                e.velocity = 0x8000;
+                t.msg.n = 0;
+                t.msg.t_us = t.k.t_us;
+                map_staged = &t.msg;
+                midi1_encode(e, map_output);
+                if (!t.msg.n) continue;
+            }
+            CORO_AWAIT_PUSH(c, tx_ring, t.msg);
+        }
+        CORO_END(c);
+    }
+};
+
+struct TxTask : Coro {
+    Msg msg;
+
+    TxTask() : Coro(body) {}
+
+    static bool body(Coro& c) {
+        TxTask& t = static_cast<TxTask&>(c);
+        CORO_BEGIN(c);
+        while (1) {
+            CORO_AWAIT_POP(c, tx_ring, t.msg);
+            dma_start(t.msg.n);
+            CORO_AWAIT_SIGNAL(c, dma_done);
+            printf("%u midi", now_us);
+            for (uint8_t i = 0 ; i < t.msg.n ; ++i) printf(" %02X", t.msg.data[i]);
+            printf(" %u\n", now_us - t.msg.t_us);
+            ++messages;
+        }
+        CORO_END(c);
+    }
+};
+
+struct StatsTask : Coro {
+    size_t tx_max;
+
+    StatsTask() : Coro(body), tx_max(0) {}
+
+    static bool body(Coro& c) {
+        StatsTask& t = static_cast<StatsTask&>(c);
+        CORO_BEGIN(c);
+        while (1) {
+            if (tx_ring.size() > t.tx_max) t.tx_max = tx_ring.size();
+            CORO_SLEEP(c, 2);
+        }
+        CORO_END(c);
+    }
+};
+
+static MapTask map_task;
+static TxTask tx_task;
+static StatsTask stats_task;
+
+
+int main(int argc, char** argv) {
+    static const char* const PATTERNS[KEYMAT_BENCH_n] = {"idle", "chord", "bounce"};
+    keymat_bench_pattern_t pattern = KEYMAT_BENCH_CHORD;
+    if (argc > 1) {
+        uint8_t p = 0;
+        while (p < KEYMAT_BENCH_n && strcmp(argv[1], PATTERNS[p])) ++p;
+        if (p == KEYMAT_BENCH_n) {
+            fprintf(stderr, "unknown pattern: %s\n", argv[1]);
+            return 2;
+        }
+        pattern = (keymat_bench_pattern_t)p;
+    }
+
+    keymap_init();
+    keymat_debounce_init();
+    keymat_callback = key_handler;
+    coro_tick = sim_tick;
+    coro_start(map_task);
+    coro_start(tx_task);
+    coro_start(stats_task);
+
+    typedef std::chrono::steady_clock clk;
+    double run_ns = 0;
+    uint32_t passes = 0;
+    uint32_t in[KEYMAT_ROW_n];
+    // run on until the last message has gone out
+    for (uint32_t f = 0 ; f < KEYMAT_BENCH_FIELDS || !key_ring.empty() || !tx_ring.empty() || dma_busy ; ++f) {
+        now_us = (f + 1) * KEYMAT_FIELD_PERIOD_Tus;
+        if (f < KEYMAT_BENCH_FIELDS) {
+            keymat_bench_input(pattern, f, in);
+            keymat_debounce_field(in);
+        }
+        dma_poll();
+        // all tasks until everyone waits (the firmware would sleep here)
+        clk::time_point t0 = clk::now();
+        do ++passes; while (coro_run());
+        run_ns += std::chrono::duration<double, std::nano>(clk::now() - t0).count();
+    }
+
+    uint32_t switches = passes * coro_count();
+    fprintf(stderr, "%s: %u key events (%u dropped), %u messages\n", PATTERNS[pattern], key_events, key_drops, messages);
+    fprintf(stderr, "queue depth max: keys %u, transmit %u\n", (unsigned)key_max, (unsigned)stats_task.tx_max);
+    fprintf(stderr, "%u executor passes, %u task switches, %.1f ns per switch (host)\n", passes, switches, run_ns / switches);
+    fprintf(stderr, "task sizes: map %u, transmit %u, stats %u bytes (Coro %u)\n",
+            (unsigned)sizeof(MapTask), (unsigned)sizeof(TxTask), (unsigned)sizeof(StatsTask), (unsigned)sizeof(Coro));
+    if (key_drops) fprintf(stderr, "FAILED: key events dropped\n");
+    return key_drops ? 1 : 0;
+}
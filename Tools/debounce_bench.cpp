@@ -0,0 +1,194 @@
+// debouncing benchmark (see User/keymat_bench.hpp)
+// - host: times the debouncing engines over the benchmark patterns; compare
+//   engines / revisions with each other (host time says little about the target)
+// - target: decodes the startup benchmark from a telemetry snapshot (cycles
+//   measured with DWT, USER_BENCH in user_conf.h)
+//
+//   g++ -std=c++11 -O2 -IUser -o debounce_bench Tools/debounce_bench.cpp User/keymat_bench.cpp User/keymat_debounce.cpp User/hostlink_frame.cpp
+//   ./debounce_bench [--budget <pct>]       # host
+//   ./debounce_bench --request > /dev/ttyUSB0   # ask for a telemetry snapshot
+//   ./debounce_bench --target < /dev/ttyUSB0    # target (exits on the first snapshot)
+//
+// report: per engine (host) or per pattern (target)
+//   <pattern> <engine> <per key> <per field mean> <per field max> <% of field period> <PASS|FAIL>
+// host: ns, the budget is --budget % of the field period (default 25);
+// target: cycles, against USER_BENCH_BUDGET_PCT
+// exit status: 1 if anything failed
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+
+#include "debouncer.hpp"
+#include "hostlink.hpp"
+#include "keymat_bench.hpp"
+#include "keymat_debounce.hpp"
+
+
+static const char* const PATTERN_NAMES[KEYMAT_BENCH_n] = {"idle", "chord", "bounce"};
+static const uint32_t KEY_n = KEYMAT_ROW_n * KEYMAT_COL_n;
+
+// inputs of all fields, in column order (for the engines running per key)
+static uint32_t inputs[KEYMAT_BENCH_FIELDS][KEYMAT_ROW_n];
+static bool keys_in[KEYMAT_BENCH_FIELDS][KEY_n];
+
+// keeps the optimizer from dropping the work
+static volatile uint32_t sink;
+
+static bool report(const char* pattern, const char* engine, double mean, double max, double period, double budget, const char* unit) {
+    bool pass = max <= budget;
+    printf("%-7s %-16s %8.2f %s/key %9.1f %s mean %9.1f %s max %6.2f%% %s\n",
+           pattern, engine, mean / KEY_n, unit, mean, unit, max, unit, 100 * max / period, pass ? "PASS" : "FAIL");
+    return pass;
+}
+
+
+////////////////////////////////////////
+// host
+
+typedef std::chrono::steady_clock clk;
+
+// run the pattern from a fresh state, field by field, several times over;
+// each field's time is its fastest run (least disturbed)
+// return: ns per field (mean, max)
+template <typename Engine>
+static void time_engine(Engine& engine, double& mean, double& max) {
+    static const int REPEAT = 50;
+    static double best[KEYMAT_BENCH_FIELDS];
+    for (int r = 0 ; r < REPEAT ; ++r) {
+        engine.reset();
+        for (uint32_t f = 0 ; f < KEYMAT_BENCH_FIELDS ; ++f) {
+            clk::time_point t0 = clk::now();
+            engine.step(f);
+            double ns = std::chrono::duration<double, std::nano>(clk::now() - t0).count();
+            if (!r || ns < best[f]) best[f] = ns;
+        }
+    }
+    mean = 0;
+    max = 0;
+    for (uint32_t f = 0 ; f < KEYMAT_BENCH_FIELDS ; ++f) {
+        mean += best[f];
+        if (best[f] > max) max = best[f];
+    }
+    mean /= KEYMAT_BENCH_FIELDS;
+}
+
+// compile-time thresholds (the original engine)
+typedef Debouncer<int8_t, KEYMAT_BOUNCE_THRES_TRANSIENT_Tus / KEYMAT_FIELD_PERIOD_Tus,
+                  KEYMAT_BOUNCE_THRES_STEADY_Tus / KEYMAT_FIELD_PERIOD_Tus> StaticDebouncer;
+
+struct StepStatic {
+    StaticDebouncer d[KEY_n];
+    void reset() {
+        for (uint32_t k = 0 ; k < KEY_n ; ++k) d[k].init(false);
+    }
+    void step(uint32_t f) {
+        uint32_t changes = 0;
+        for (uint32_t k = 0 ; k < KEY_n ; ++k) changes += d[k].update(keys_in[f][k]);
+        sink = changes;
+    }
+};
+
+// run-time thresholds (what the firmware uses)
+typedef DebouncerVar<keymat_debounce_counter_t> VarDebouncer;
+
+struct StepVar {
+    VarDebouncer d[KEY_n];
+    VarDebouncer::Thres th;
+    void reset() {
+        th.set(KEYMAT_BOUNCE_THRES_TRANSIENT_Tus / KEYMAT_FIELD_PERIOD_Tus, KEYMAT_BOUNCE_THRES_STEADY_Tus / KEYMAT_FIELD_PERIOD_Tus);
+        for (uint32_t k = 0 ; k < KEY_n ; ++k) d[k].init(false, th);
+    }
+    void step(uint32_t f) {
+        uint32_t changes = 0;
+        for (uint32_t k = 0 ; k < KEY_n ; ++k) changes += d[k].update(keys_in[f][k], th);
+        sink = changes;
+    }
+};
+
+// the whole field handler (pin extraction, state bits, callbacks detached)
+struct StepField {
+    void reset() { keymat_debounce_init(); }
+    void step(uint32_t f) { keymat_debounce_field(inputs[f]); }
+};
+
+static int host(double budget_pct) {
+    static const char* const ENGINES[] = {"Debouncer", "DebouncerVar", "field handler"};
+    double period = KEYMAT_FIELD_PERIOD_Tus * 1000.0;
+    bool pass = true;
+    for (uint8_t p = 0 ; p < KEYMAT_BENCH_n ; ++p) {
+        for (uint32_t f = 0 ; f < KEYMAT_BENCH_FIELDS ; ++f) {
+            keymat_bench_input((keymat_bench_pattern_t)p, f, inputs[f]);
+            for (uint32_t k = 0 ; k < KEY_n ; ++k) {
+                keys_in[f][k] = (inputs[f][k / KEYMAT_COL_n] >> KEYMAT_COL_PINS[k % KEYMAT_COL_n]) & 1;
+            }
+        }
+        static StepStatic step_static;
+        static StepVar step_var;
+        static StepField step_field;
+        double mean[3], max[3];
+        time_engine(step_static, mean[0], max[0]);
+        time_engine(step_var, mean[1], max[1]);
+        time_engine(step_field, mean[2], max[2]);
+        for (uint8_t e = 0 ; e < 3 ; ++e) {
+            pass &= report(PATTERN_NAMES[p], ENGINES[e], mean[e], max[e], period, period * budget_pct / 100, "ns");
+        }
+    }
+    return pass ? 0 : 1;
+}
+
+
+////////////////////////////////////////
+// target
+
+// NOTE: later versions only append
+static const uint8_t TELEMETRY_VERSION = 3;
+static const size_t TELEMETRY_BENCH_AT = 1 + 4 * 12; // see `telemetry_send` (user_main.cpp)
+
+static uint32_t rd32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int target() {
+    static HostlinkDecoder link;
+    int c;
+    while ((c = getchar()) != EOF) {
+        if (!link.feed(c) || link.channel != HOSTLINK_CH_TELEMETRY) continue;
+        const uint8_t* t = link.payload;
+        if (link.payload_n < TELEMETRY_BENCH_AT + 4 * (2 + 2 * KEYMAT_BENCH_n) || t[0] < TELEMETRY_VERSION) {
+            fprintf(stderr, "unexpected telemetry (version %u, %u bytes)\n", t[0], (unsigned)link.payload_n);
+            return 2;
+        }
+        const uint8_t* p = t + TELEMETRY_BENCH_AT;
+        uint32_t period = rd32(p);
+        uint32_t budget_pct = rd32(p + 4);
+        p += 8;
+        if (!period) {
+            fprintf(stderr, "no benchmark (USER_BENCH off)\n");
+            return 2;
+        }
+        fprintf(stderr, "field period %u cycles, budget %u%%\n", period, budget_pct);
+        bool pass = true;
+        for (uint8_t i = 0 ; i < KEYMAT_BENCH_n ; ++i, p += 8) {
+            pass &= report(PATTERN_NAMES[i], "field handler", rd32(p), rd32(p + 4), period, period * budget_pct / 100.0, "cyc");
+        }
+        return pass ? 0 : 1;
+    }
+    fprintf(stderr, "no telemetry received\n");
+    return 2;
+}
+
+
+int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "--request")) {
+        uint8_t frame[HOSTLINK_FRAME_n];
+        fwrite(frame, 1, hostlink_frame_encode(HOSTLINK_CH_TELEMETRY, nullptr, 0, frame), stdout);
+        return 0;
+    }
+    if (argc > 1 && !strcmp(argv[1], "--target")) return target();
+    double budget = 25;
+    if (argc > 2 && !strcmp(argv[1], "--budget")) budget = atof(argv[2]);
+    return host(budget);
+}
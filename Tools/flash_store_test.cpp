@@ -0,0 +1,170 @@
+// settings store check (host side): drives the firmware's own log-structured
+// store (User/flash_store.cpp) on the RAM-backed emulator (User/flash_emu.cpp)
+//
+//   g++ -std=c++11 -O2 -IUser -o flash_store_test Tools/flash_store_test.cpp User/flash_store.cpp User/flash_emu.cpp
+//   ./flash_store_test
+//
+// - round trips: records of every length, with reboots in between; the
+//   latest record always wins, and each page started costs exactly one
+//   erase (of the page left behind, alternating between the pages)
+// - power cuts: a write (incl. page switch and background erase) is cut at
+//   every operation index in turn, after a varying number of earlier
+//   records; after the reboot, the previous record (or the new one, once
+//   complete) must be read back, and the store must take new records
+// stderr: failures, then a summary
+// exit status: 0 if all checks passed
+
+#include <stdio.h>
+#include <string.h>
+
+#include "flash_emu.hpp"
+#include "flash_store.hpp"
+
+
+static unsigned failures = 0;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        ++failures; \
+        fprintf(stderr, "FAIL %s:%d: %s -- ", __FILE__, __LINE__, #cond); \
+        fprintf(stderr, __VA_ARGS__); \
+        fputc('\n', stderr); \
+    } \
+} while (0)
+
+// record contents: distinct for every (index, length)
+static size_t record_fill(uint8_t* buf, uint32_t index) {
+    size_t n = 1 + (index * 37) % FLASH_STORE_DATA_n;
+    for (size_t i = 0 ; i < n ; ++i) buf[i] = (uint8_t)(index * 131 + i * 7);
+    return n;
+}
+
+// whether the latest record equals `record_fill(index)` (-1: no record)
+static bool record_is(int32_t index) {
+    const uint8_t* data;
+    size_t n;
+    if (!flash_store_read(data, n)) return index < 0;
+    if (index < 0) return false;
+    uint8_t buf[FLASH_STORE_DATA_n];
+    size_t want = record_fill(buf, index);
+    return n == want && !memcmp(data, buf, n);
+}
+
+// write one record and poll it out (then let the background erase run)
+// return: false if it did not complete within a generous number of polls
+static bool record_write(uint32_t index, bool allow_erase = true) {
+    uint8_t buf[FLASH_STORE_DATA_n];
+    size_t n = record_fill(buf, index);
+    if (!flash_store_write(buf, n)) return false;
+    for (int i = 0 ; i < 1000 && flash_store_busy() ; ++i) flash_store_poll(allow_erase);
+    if (flash_store_busy()) return false;
+    flash_store_poll(allow_erase);
+    return true;
+}
+
+static void reboot() {
+    flash_emu_power_cut(-1);
+    flash_store_init(&flash_emu);
+}
+
+
+////////////////////////////////////////
+// round trips
+
+static const uint32_t ROUND_TRIP_n = 500;
+
+static void test_round_trips() {
+    flash_emu_reset();
+    flash_store_init(&flash_emu);
+    flash_store_erases = 0;
+    CHECK(record_is(-1), "blank flash reads a record");
+
+    // replay the layout (see flash_store.cpp): page header 8 bytes, record
+    // header 4 + payload padded to even + CRC 4
+    uint32_t wpos = FLASH_STORE_PAGE_n, pages = 0;
+    for (uint32_t i = 0 ; i < ROUND_TRIP_n ; ++i) {
+        uint8_t buf[FLASH_STORE_DATA_n];
+        uint32_t r = 4 + ((record_fill(buf, i) + 1) & ~1u) + 4;
+        if (wpos + r > FLASH_STORE_PAGE_n) {
+            // NOTE: the very first page too -- the other one is not known to
+            // be blank then (e.g. a torn page header)
+            ++pages;
+            wpos = 8;
+        }
+        wpos += r;
+
+        CHECK(record_write(i), "record %u not written", i);
+        CHECK(record_is(i), "record %u not read back", i);
+        if (i % 7 == 0) {
+            reboot();
+            CHECK(record_is(i), "record %u not read back after reboot", i);
+        }
+    }
+    uint32_t e0 = flash_emu_erases[0], e1 = flash_emu_erases[1];
+    CHECK(e0 + e1 == pages, "%u + %u erases, %u pages started", e0, e1, pages);
+    CHECK(e0 == e1 || e0 == e1 + 1 || e1 == e0 + 1, "wear not levelled: %u / %u erases", e0, e1);
+    CHECK(flash_store_errors == 0, "%u errors", (unsigned)flash_store_errors);
+    fprintf(stderr, "round trips: %u records, %u pages started, erases %u / %u\n",
+            ROUND_TRIP_n, pages, e0, e1);
+}
+
+
+////////////////////////////////////////
+// power cuts
+
+// earlier records before the cut write: enough for a few pages
+static const uint32_t HISTORY_MAX = 24;
+
+static uint32_t cuts = 0, cuts_new = 0;
+
+// `history` records, then record `history` cut after `ops` operations
+// allow_erase: whether the background erase may run before the cut write
+// return: whether the cut write completed before the cut
+static bool power_cut(uint32_t history, int32_t ops, bool allow_erase) {
+    flash_emu_reset();
+    flash_store_init(&flash_emu);
+    for (uint32_t i = 0 ; i < history ; ++i) record_write(i, allow_erase || i + 1 < history);
+
+    flash_emu_power_cut(ops);
+    uint8_t buf[FLASH_STORE_DATA_n];
+    size_t n = record_fill(buf, history);
+    flash_store_write(buf, n);
+    for (int i = 0 ; i < 1000 && flash_store_busy() ; ++i) flash_store_poll(true);
+    bool done = !flash_store_busy();
+
+    reboot();
+    int32_t prev = (int32_t)history - 1;
+    ++cuts;
+    if (done) {
+        ++cuts_new;
+        CHECK(record_is(history), "history %u, cut at %d: completed record lost", history, ops);
+    } else {
+        CHECK(record_is(prev) || record_is(history),
+              "history %u, cut at %d: previous record lost", history, ops);
+    }
+
+    // still usable afterwards
+    CHECK(record_write(history + 1), "history %u, cut at %d: no write after reboot", history, ops);
+    CHECK(record_is(history + 1), "history %u, cut at %d: no read after reboot", history, ops);
+    reboot();
+    CHECK(record_is(history + 1), "history %u, cut at %d: no read after 2nd reboot", history, ops);
+    return done;
+}
+
+static void test_power_cuts() {
+    for (uint32_t history = 0 ; history <= HISTORY_MAX ; ++history) {
+        for (int erase = 0 ; erase < 2 ; ++erase) {
+            // every operation index until the write gets through
+            for (int32_t ops = 0 ; !power_cut(history, ops, erase) ; ++ops);
+        }
+    }
+    fprintf(stderr, "power cuts: %u (%u after the write completed)\n", cuts, cuts_new);
+}
+
+
+int main() {
+    test_round_trips();
+    test_power_cuts();
+    fprintf(stderr, "%s (%u failures)\n", failures ? "FAILED" : "ok", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,317 @@
+// capture replay (host side): runs raw scan captures (see capture.hpp)
+// through the firmware's own debouncing (User/keymat_debounce.cpp) and note
+// output (User/note.cpp: keymap, coupler, MPE and MIDI encoders), and prints every key event and every message
+// produced, with its time -- a golden output checks changes to any of these
+// for bit-exact behavior
+//
+//   g++ -std=c++11 -O2 -IUser -o keymat_replay Tools/keymat_replay.cpp User/keymat_debounce.cpp User/note.cpp User/keymap.cpp User/coupler.cpp User/mpe.cpp User/midi_event.cpp User/midi1.cpp User/ump.cpp User/settings.cpp User/flash_store.cpp User/scope_codec.cpp
+//   ./keymat_replay take1.kmc > take1.golden         # record
+//   ./keymat_replay take1.kmc --golden take1.golden  # check (exit 1 on the first difference)
+//   ./keymat_replay --synth < script.txt > synth.kmc # synthesize a capture
+//
+// regression data (Tools/replay): bounce.txt, a synth script of bouncing
+// takes, with its goldens for the default settings, --adaptive and --mpe 4
+// (default build options); check before committing (exit status 0: unchanged):
+//   ./keymat_replay --synth < Tools/replay/bounce.txt > /tmp/bounce.kmc && ./keymat_replay /tmp/bounce.kmc --golden Tools/replay/bounce.golden && ./keymat_replay /tmp/bounce.kmc --adaptive --golden Tools/replay/bounce.adaptive.golden && ./keymat_replay /tmp/bounce.kmc --mpe 4 --golden Tools/replay/bounce.mpe.golden
+//
+// options (settings otherwise at their defaults, see User/settings.cpp):
+//   --debounce <transient us>,<steady us>
+//   --adaptive     # per-key thresholds (see `keymat_set_adaptive`), learned
+//                  # from scratch; the summary adds them
+//   --mpe <member channels>
+//
+// output: one line per event; time: field number x field period
+//   <time us> key <row> <col> <0|1> <latency us>
+//   <time us> midi <MIDI 1.0 message (hex)>
+//   <time us> ump <UMP words (hex)>
+// latency: from the first raw sample disagreeing with the key's debounced
+// state to the key event (scanning and debouncing only)
+// stderr: summary (fields, key events, latency min / mean / max)
+//
+// synth script: one raw contact change per line, in time order ('#': comment)
+//   <time us> <row> <col> <0|1>
+//   <time us> end      # capture length (default: just past the last change)
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.hpp"
+#include "coupler.hpp"
+#include "keymap.hpp"
+#include "keymat_debounce.hpp"
+#include "mpe.hpp"
+#include "note.hpp"
+#include "settings.hpp"
+#include "ump.hpp"
+
+
+////////////////////////////////////////
+// output (or comparison with the golden output)
+
+static FILE* golden = nullptr;
+static uint32_t line_n = 0;
+static bool mismatch = false;
+
+static void emit(const char* fmt, ...) {
+    char line[256];
+    va_list ap;
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    ++line_n;
+    if (!golden) {
+        fputs(line, stdout);
+        return;
+    }
+    if (mismatch) return;
+    char expect[256];
+    if (!fgets(expect, sizeof(expect), golden)) strcpy(expect, "(end of file)\n");
+    if (strcmp(line, expect)) {
+        fprintf(stderr, "line %u differs\n  golden: %s  replay: %s", line_n, expect, line);
+        mismatch = true;
+    }
+}
+
+
+////////////////////////////////////////
+// event pipeline (as in User/user_main.cpp, without scheduling and transport)
+
+static uint32_t field_n = 0; // number of the field being debounced
+
+static uint32_t time_us() { return field_n * KEYMAT_FIELD_PERIOD_Tus; }
+
+// transports: print
+static void replay_midi1(const uint8_t* msg, size_t n) {
+    char hex[3 * 16 + 1] = "";
+    for (size_t i = 0 ; i < n && i < 16 ; ++i) sprintf(hex + 3 * i, " %02X", msg[i]);
+    emit("%u midi%s\n", time_us(), hex);
+}
+
+// UMP byte stream (see ump.hpp) => words
+static void replay_ump(const uint8_t* data, size_t n) {
+    char hex[9 * UMP_WORD_MAX + 1] = "";
+    for (size_t i = 0 ; i + 4 <= n && i < 4 * UMP_WORD_MAX ; i += 4) {
+        uint32_t w = ((uint32_t)data[i] << 24) | (data[i + 1] << 16) | (data[i + 2] << 8) | data[i + 3];
+        sprintf(hex + 9 * (i / 4), " %08X", w);
+    }
+    emit("%u ump%s\n", time_us(), hex);
+}
+
+static void field_handler() {
+    if (settings_field()) note_settings_activate();
+}
+
+// latency measurement
+static const uint32_t FIELD_NONE = 0xFFFFFFFF;
+static uint32_t raw_first[KEYMAT_ROW_n][KEYMAT_COL_n]; // first disagreeing field
+static uint32_t raw_agree[KEYMAT_ROW_n][KEYMAT_COL_n]; // fields agreeing since
+static uint32_t events = 0;
+static uint32_t latency_min = 0xFFFFFFFF, latency_max = 0;
+static uint64_t latency_sum = 0;
+
+static void key_handler(uint8_t ri, uint8_t ci, bool state) {
+    uint32_t first = raw_first[ri][ci];
+    uint32_t latency = first == FIELD_NONE ? 0 : (field_n - first) * KEYMAT_FIELD_PERIOD_Tus;
+    raw_first[ri][ci] = FIELD_NONE;
+    ++events;
+    latency_sum += latency;
+    if (latency < latency_min) latency_min = latency;
+    if (latency > latency_max) latency_max = latency;
+    emit("%u key %u %u %d %u\n", time_us(), ri, ci, state, latency);
+
+    // as the instrument: mapped in the key callback, played by the thread
+    NoteKey k;
+    if (!note_key(ri, ci, state, k)) return;
+    note_settings_update();
+    note_key_play(k);
+}
+
+// one field: raw rows in column order (see `keymat_state`)
+static void replay_field(const uint16_t* rows) {
+    // a glitch is over once the input has agreed for a whole steady threshold
+    uint32_t steady = settings().debounce_steady_Tus / KEYMAT_FIELD_PERIOD_Tus;
+    uint32_t in[KEYMAT_ROW_n];
+    for (uint8_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        in[ri] = 0;
+        for (uint8_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            bool raw = (rows[ri] >> ci) & 1;
+            if (raw) in[ri] |= 1 << KEYMAT_COL_PINS[ci];
+            if (raw != keymat_state_get(ri, ci)) {
+                if (raw_first[ri][ci] == FIELD_NONE) raw_first[ri][ci] = field_n;
+                raw_agree[ri][ci] = 0;
+            } else if (++raw_agree[ri][ci] >= steady) {
+                raw_first[ri][ci] = FIELD_NONE;
+            }
+        }
+    }
+    keymat_debounce_field(in);
+}
+
+static bool replay_settings(int argc, char** argv) {
+    Settings* s = settings_edit();
+    for (int i = 1 ; i < argc ; ++i) {
+        unsigned a, b;
+        if (!strcmp(argv[i], "--debounce") && i + 1 < argc && sscanf(argv[i + 1], "%u,%u", &a, &b) == 2) {
+            s->debounce_transient_Tus = a;
+            s->debounce_steady_Tus = b;
+            ++i;
+        } else if (!strcmp(argv[i], "--adaptive")) {
+            s->debounce_adapt = true;
+        } else if (!strcmp(argv[i], "--mpe") && i + 1 < argc) {
+            s->mpe = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--golden") && i + 1 < argc) {
+            ++i;
+        } else if (argv[i][0] == '-') {
+            fprintf(stderr, "unknown option %s\n", argv[i]);
+            return false;
+        }
+    }
+    if (!settings_valid(*s)) {
+        fprintf(stderr, "settings out of range\n");
+        return false;
+    }
+    settings_apply();
+    settings_field();
+    return true;
+}
+
+
+////////////////////////////////////////
+// capture => fields
+
+static uint16_t raw[KEYMAT_ROW_n];
+
+static void feed_until(uint32_t field) {
+    for ( ; field_n < field ; ++field_n) replay_field(raw);
+}
+
+// every change is reported at the first field it shows in
+static void on_change(void* /*ctx*/, uint32_t field, uint8_t ri, uint8_t ci, bool state) {
+    feed_until(field);
+    raw[ri] = (raw[ri] & ~(1 << ci)) | (state << ci);
+}
+
+static int replay(FILE* f) {
+    if (!capture_read_header(f)) {
+        fprintf(stderr, "not a capture of this keyboard matrix\n");
+        return 2;
+    }
+    static uint8_t packet[CAPTURE_PACKET_MAX];
+    ScopeDecoder dec;
+    uint32_t bad = 0;
+    long n;
+    while ((n = capture_read_packet(f, packet)) >= 0) {
+        if (!dec.synced && (size_t)n >= SCOPE_HEADER_n) {
+            // the capture starts here, from the base of its first packet
+            field_n = packet[0] | (packet[1] << 8) | (packet[2] << 16) | ((uint32_t)packet[3] << 24);
+            for (uint8_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) raw[ri] = packet[4 + 2 * ri] | (packet[5 + 2 * ri] << 8);
+        }
+        if (!dec.decode(packet, n, on_change, nullptr)) ++bad;
+        feed_until(dec.field);
+    }
+    char extra[256];
+    if (golden && !mismatch && fgets(extra, sizeof(extra), golden)) {
+        fprintf(stderr, "replay ends before line %u\n  golden: %s", line_n + 1, extra);
+        mismatch = true;
+    }
+
+    fprintf(stderr, "fields %u, fields lost %u, bad packets %u, key events %u", field_n, dec.gaps, bad, events);
+    if (events) {
+        fprintf(stderr, ", latency us min %u mean %.1f max %u",
+                latency_min, (double)latency_sum / events, latency_max);
+    }
+    fprintf(stderr, "\n");
+    if (settings().debounce_adapt) {
+        uint8_t learned[KEYMAT_ROW_n * KEYMAT_COL_n];
+        keymat_get_learned(learned);
+        uint32_t lo = 0xFF, hi = 0, sum = 0;
+        for (size_t i = 0 ; i < sizeof(learned) ; ++i) {
+            if (learned[i] < lo) lo = learned[i];
+            if (learned[i] > hi) hi = learned[i];
+            sum += learned[i];
+        }
+        fprintf(stderr, "learned steady us min %u mean %.0f max %u, %u updates\n",
+                lo * KEYMAT_FIELD_PERIOD_Tus, (double)sum * KEYMAT_FIELD_PERIOD_Tus / sizeof(learned),
+                hi * KEYMAT_FIELD_PERIOD_Tus, keymat_adapt_updates);
+    }
+    if (mismatch) return 1;
+    return 0;
+}
+
+
+////////////////////////////////////////
+// synthesized capture
+
+static int synth() {
+    CaptureWriter w(stdout);
+    if (!capture_write_header(stdout)) return 2;
+    uint16_t rows[KEYMAT_ROW_n] = {};
+    uint32_t next = 0; // next field to write
+    uint32_t end = 0;
+    char line[128];
+    for (uint32_t ln = 1 ; fgets(line, sizeof(line), stdin) ; ++ln) {
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        unsigned t, ri, ci, state;
+        char word[8];
+        int k = sscanf(line, "%u %u %u %u", &t, &ri, &ci, &state);
+        bool is_end = k == 1 && sscanf(line, "%*u %7s", word) == 1 && !strcmp(word, "end");
+        if (k <= 0 && !is_end) continue;
+        if (!is_end && (k != 4 || ri >= KEYMAT_ROW_n || ci >= KEYMAT_COL_n || state > 1)) {
+            fprintf(stderr, "line %u: bad change\n", ln);
+            return 2;
+        }
+        uint32_t field = t / KEYMAT_FIELD_PERIOD_Tus;
+        if (field < next) {
+            fprintf(stderr, "line %u: out of order\n", ln);
+            return 2;
+        }
+        for ( ; next < field ; ++next) w.add(rows);
+        if (is_end) {
+            end = field;
+            break;
+        }
+        rows[ri] = (rows[ri] & ~(1 << ci)) | (state << ci);
+        end = field + 1;
+    }
+    for ( ; next < end ; ++next) w.add(rows);
+    return w.close() ? 0 : 2;
+}
+
+
+int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "--synth")) return synth();
+
+    const char* path = nullptr;
+    for (int i = 1 ; i < argc ; ++i) {
+        if (!strcmp(argv[i], "--golden") && i + 1 < argc) {
+            golden = fopen(argv[++i], "r");
+            if (!golden) { perror(argv[i]); return 2; }
+        } else if (argv[i][0] != '-' && (i == 1 || argv[i - 1][0] != '-' || !strcmp(argv[i - 1], "--adaptive"))) {
+            path = argv[i];
+        }
+    }
+    FILE* f = path ? fopen(path, "rb") : stdin;
+    if (!f) { perror(path); return 2; }
+
+    // same initialization order as the firmware
+    keymap_init();
+    coupler_init();
+    note_midi1_output = replay_midi1;
+    note_ump_output = replay_ump;
+    coupler_output = note_output;
+    mpe_output = note_send;
+    settings_init();
+    keymat_debounce_init();
+    if (!replay_settings(argc, argv)) return 2;
+    note_settings_activate();
+    note_settings_update();
+    keymat_callback = key_handler;
+    keymat_field_callback = field_handler;
+    for (uint8_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        for (uint8_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) raw_first[ri][ci] = FIELD_NONE;
+    }
+    return replay(f);
+}
@@ -0,0 +1,177 @@
+// MIDI encoder check (host side): the firmware's own serializers
+// (User/midi1.cpp, User/ump.cpp) and scaling (User/midi_event.cpp) against
+// reference vectors worked out by hand from the MIDI 1.0 / MIDI 2.0 specs
+//
+//   g++ -std=c++11 -O2 -IUser -o midi_encode_test Tools/midi_encode_test.cpp User/midi_event.cpp User/midi1.cpp User/ump.cpp
+//   ./midi_encode_test
+//
+// stderr: failures, then a summary
+// exit status: 0 if all checks passed
+
+#include <stdio.h>
+#include <string.h>
+
+#include "midi1.hpp"
+#include "midi_event.hpp"
+#include "ump.hpp"
+
+
+static unsigned failures = 0, checks = 0;
+
+static void fail(const char* name, const char* what) {
+    ++failures;
+    fprintf(stderr, "FAIL %s: %s\n", name, what);
+}
+
+// MIDI 1.0 output: all messages of one event, concatenated
+static uint8_t midi1_buf[32];
+static size_t midi1_n = 0;
+
+static void midi1_capture(const uint8_t* msg, size_t n) {
+    if (midi1_n + n > sizeof(midi1_buf)) return;
+    memcpy(midi1_buf + midi1_n, msg, n);
+    midi1_n += n;
+}
+
+struct Vector {
+    const char* name;
+    MidiEvent e;
+    uint32_t ump[UMP_WORD_MAX];
+    uint8_t midi1[18];
+    size_t midi1_n;
+};
+
+static MidiEvent note(midi_event_type_t type, uint8_t group, uint8_t channel, uint8_t n,
+                      uint16_t velocity, midi_attr_t attr_type = MIDI_ATTR_NONE, uint16_t attr = 0) {
+    MidiEvent e = midi_event(type, channel);
+    e.group = group;
+    e.note = n;
+    e.velocity = velocity;
+    e.attr_type = attr_type;
+    e.attr = attr;
+    return e;
+}
+
+static MidiEvent value(midi_event_type_t type, uint8_t channel, uint32_t v, uint8_t ctl = 0, uint8_t n = 0, uint16_t param = 0) {
+    MidiEvent e = midi_event(type, channel);
+    e.value = v;
+    e.ctl = ctl;
+    e.note = n;
+    e.param = param;
+    return e;
+}
+
+static void check_vector(const Vector& v) {
+    ++checks;
+    uint32_t words[UMP_WORD_MAX] = {};
+    size_t n = ump_encode(v.e, words);
+    if (n != 2 || words[0] != v.ump[0] || words[1] != v.ump[1]) {
+        char what[96];
+        snprintf(what, sizeof(what), "UMP %08X %08X (%u words), expected %08X %08X",
+                 words[0], words[1], (unsigned)n, v.ump[0], v.ump[1]);
+        fail(v.name, what);
+    }
+    midi1_n = 0;
+    midi1_encode(v.e, midi1_capture);
+    if (midi1_n != v.midi1_n || memcmp(midi1_buf, v.midi1, midi1_n)) {
+        char what[128];
+        int k = snprintf(what, sizeof(what), "MIDI 1.0");
+        for (size_t i = 0 ; i < midi1_n && k < 120 ; ++i) k += snprintf(what + k, sizeof(what) - k, " %02X", midi1_buf[i]);
+        fail(v.name, what);
+    }
+}
+
+static void test_vectors() {
+    const Vector vectors[] = {
+        // note on, attribute: pitch 7.9 = 60.0 semitones
+        {"note on + pitch attr", note(MIDI_EV_NOTE_ON, 0, 2, 60, 0xC000, MIDI_ATTR_PITCH_7_9, 60 << 9),
+         {0x40923C03, 0xC0007800}, {0x92, 0x3C, 0x60}, 3},
+        {"note on, max velocity", note(MIDI_EV_NOTE_ON, 15, 15, 127, 0xFFFF),
+         {0x4F9F7F00, 0xFFFF0000}, {0x9F, 0x7F, 0x7F}, 3},
+        // MIDI 2.0 velocity below 1/128: a MIDI 1.0 note on needs at least 1
+        // (0 would be a note off); the UMP carries it as is
+        {"note on, velocity 0x0100", note(MIDI_EV_NOTE_ON, 0, 0, 60, 0x0100),
+         {0x40903C00, 0x01000000}, {0x90, 0x3C, 0x01}, 3},
+        {"note on, velocity 0", note(MIDI_EV_NOTE_ON, 0, 0, 60, 0),
+         {0x40903C00, 0x00000000}, {0x90, 0x3C, 0x01}, 3},
+        {"note off + manufacturer attr", note(MIDI_EV_NOTE_OFF, 5, 0, 0x40, 0x8000, MIDI_ATTR_MANUFACTURER, 0x1234),
+         {0x45804001, 0x80001234}, {0x80, 0x40, 0x40}, 3},
+        {"note off, velocity 0", note(MIDI_EV_NOTE_OFF, 0, 9, 36, 0),
+         {0x40892400, 0x00000000}, {0x89, 0x24, 0x00}, 3},
+        {"control, center", value(MIDI_EV_CONTROL, 1, 0x80000000, 11),
+         {0x40B10B00, 0x80000000}, {0xB1, 0x0B, 0x40}, 3},
+        {"control, max", value(MIDI_EV_CONTROL, 0, 0xFFFFFFFF, 7),
+         {0x40B00700, 0xFFFFFFFF}, {0xB0, 0x07, 0x7F}, 3},
+        // RPN 0/0 (bend range) = 2 semitones: data entry LSB 0 is left out
+        {"RPN, LSB 0", value(MIDI_EV_RPN, 0, 0x04000000, 0, 0, 0x0000),
+         {0x40200000, 0x04000000},
+         {0xB0, 0x65, 0x00, 0xB0, 0x64, 0x00, 0xB0, 0x06, 0x02, 0xB0, 0x65, 0x7F, 0xB0, 0x64, 0x7F}, 15},
+        // RPN 0/1 (fine tuning), 14-bit 0x2040
+        {"RPN, LSB", value(MIDI_EV_RPN, 3, 0x81020000, 0, 0, 0x0001),
+         {0x40230001, 0x81020000},
+         {0xB3, 0x65, 0x00, 0xB3, 0x64, 0x01, 0xB3, 0x06, 0x40, 0xB3, 0x26, 0x40, 0xB3, 0x65, 0x7F, 0xB3, 0x64, 0x7F}, 18},
+        {"poly pressure", value(MIDI_EV_POLY_PRESSURE, 3, 0xFFFFFFFF, 0, 0x30),
+         {0x40A33000, 0xFFFFFFFF}, {0xA3, 0x30, 0x7F}, 3},
+        {"channel pressure", value(MIDI_EV_CHANNEL_PRESSURE, 4, 0x40000000),
+         {0x40D40000, 0x40000000}, {0xD4, 0x20}, 2},
+        {"pitch bend, min", value(MIDI_EV_PITCH_BEND, 0, 0),
+         {0x40E00000, 0x00000000}, {0xE0, 0x00, 0x00}, 3},
+        {"pitch bend, center", value(MIDI_EV_PITCH_BEND, 0, MIDI_BEND_CENTER),
+         {0x40E00000, 0x80000000}, {0xE0, 0x00, 0x40}, 3},
+        {"pitch bend, max", value(MIDI_EV_PITCH_BEND, 6, 0xFFFFFFFF),
+         {0x40E60000, 0xFFFFFFFF}, {0xE6, 0x7F, 0x7F}, 3},
+    };
+    for (size_t i = 0 ; i < sizeof(vectors) / sizeof(vectors[0]) ; ++i) check_vector(vectors[i]);
+
+    // big-endian byte stream
+    ++checks;
+    uint32_t words[2] = {0x40923C03, 0xC0007800};
+    uint8_t bytes[8];
+    const uint8_t want[8] = {0x40, 0x92, 0x3C, 0x03, 0xC0, 0x00, 0x78, 0x00};
+    if (ump_bytes(words, 2, bytes) != 8 || memcmp(bytes, want, 8)) fail("ump_bytes", "byte order");
+}
+
+// min, center, max (and one value above center) against the spec, then
+// every source value back down
+static void test_scale(uint8_t src_bits, uint8_t dst_bits, uint32_t above, uint32_t above_want) {
+    char name[32];
+    snprintf(name, sizeof(name), "scale %u => %u bits", src_bits, dst_bits);
+    uint32_t max_src = (1u << src_bits) - 1;
+    uint32_t max_dst = dst_bits == 32 ? 0xFFFFFFFF : (1u << dst_bits) - 1;
+    struct { uint32_t v, want; } refs[] = {
+        {0, 0},
+        {1u << (src_bits - 1), 1u << (dst_bits - 1)},
+        {max_src, max_dst},
+        {above, above_want},
+    };
+    for (size_t i = 0 ; i < 4 ; ++i) {
+        ++checks;
+        uint32_t got = midi_scale_up(refs[i].v, src_bits, dst_bits);
+        if (got != refs[i].want) {
+            char what[64];
+            snprintf(what, sizeof(what), "%X => %X, expected %X", refs[i].v, got, refs[i].want);
+            fail(name, what);
+        }
+    }
+    ++checks;
+    for (uint32_t v = 0 ; v <= max_src ; ++v) {
+        uint32_t up = midi_scale_up(v, src_bits, dst_bits);
+        if (midi_scale_down(up, dst_bits, src_bits) != v) {
+            char what[64];
+            snprintf(what, sizeof(what), "%X => %X => %X", v, up, midi_scale_down(up, dst_bits, src_bits));
+            fail(name, what);
+            break;
+        }
+    }
+}
+
+
+int main() {
+    test_vectors();
+    // above center: the bits below the sign bit are repeated downwards
+    test_scale(7, 32, 100, 0xC9249249);
+    test_scale(14, 32, 0x3000, 0xC0020010);
+    test_scale(7, 16, 100, 0xC924);
+    fprintf(stderr, "%s (%u checks, %u failures)\n", failures ? "FAILED" : "ok", checks, failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,88 @@
+// raw scan stream decoder (host side, see User/scope.hpp)
+// reads the host link byte stream (USART2) from stdin, prints a per-key
+// timeline of raw contact changes and a per-key summary
+//
+//   g++ -std=c++11 -O2 -IUser -ITools -o scan_scope Tools/scan_scope.cpp User/hostlink_frame.cpp User/scope_codec.cpp
+//   stty -F /dev/ttyUSB0 1000000 raw
+//   ./scan_scope --start > /dev/ttyUSB0   # start streaming
+//   ./scan_scope < /dev/ttyUSB0
+//   ./scan_scope --capture take1.kmc < /dev/ttyUSB0   # also record (see capture.hpp)
+//
+// output: one line per raw change
+//   <field> <time ms> <row> <col> <0|1> [<fields since the key's last change>]
+// a key's press is its first 0 => 1; the short intervals that follow are bounce
+
+#include <stdio.h>
+#include <string.h>
+
+#include "capture.hpp"
+#include "hostlink.hpp"
+#include "keymat_conf.hpp"
+#include "scope_codec.hpp"
+
+
+struct KeyLog {
+    bool seen;
+    uint32_t last;      // field of the last change
+    uint32_t changes;
+    uint32_t bounces;   // changes within the steady threshold of the last one
+};
+
+static KeyLog keys[KEYMAT_ROW_n][KEYMAT_COL_n];
+
+static const uint32_t BOUNCE_FIELDS = KEYMAT_BOUNCE_THRES_STEADY_Tus / KEYMAT_FIELD_PERIOD_Tus;
+
+static void on_key(void* /*ctx*/, uint32_t field, uint8_t ri, uint8_t ci, bool state) {
+    KeyLog& k = keys[ri][ci];
+    double t_ms = field * (KEYMAT_FIELD_PERIOD_Tus / 1000.0);
+    if (k.seen) {
+        uint32_t dt = field - k.last;
+        printf("%10u %12.3f %2u %2u %d %u\n", field, t_ms, ri, ci, state, dt);
+        if (dt < BOUNCE_FIELDS) ++k.bounces;
+    } else {
+        printf("%10u %12.3f %2u %2u %d\n", field, t_ms, ri, ci, state);
+    }
+    k.seen = true;
+    k.last = field;
+    ++k.changes;
+}
+
+static void start_stop(bool on) {
+    uint8_t frame[HOSTLINK_FRAME_n];
+    uint8_t cmd = on;
+    size_t n = hostlink_frame_encode(HOSTLINK_CH_SCAN, &cmd, 1, frame);
+    fwrite(frame, 1, n, stdout);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "--start")) { start_stop(true); return 0; }
+    if (argc > 1 && !strcmp(argv[1], "--stop")) { start_stop(false); return 0; }
+
+    FILE* capture = nullptr;
+    if (argc > 2 && !strcmp(argv[1], "--capture")) {
+        capture = fopen(argv[2], "wb");
+        if (!capture || !capture_write_header(capture)) { perror(argv[2]); return 2; }
+    }
+
+    static HostlinkDecoder link;
+    ScopeDecoder scope;
+    uint32_t bad = 0;
+    int c;
+    while ((c = getchar()) != EOF) {
+        if (!link.feed(c) || link.channel != HOSTLINK_CH_SCAN) continue;
+        if (!scope.decode(link.payload, link.payload_n, on_key, nullptr)) ++bad;
+        if (capture) capture_write_packet(capture, link.payload, link.payload_n);
+    }
+    if (capture) fclose(capture);
+
+    fprintf(stderr, "frames %u, link errors %u, bad packets %u, fields lost %u\n",
+            link.frames, link.errors, bad, scope.gaps);
+    fprintf(stderr, "row col changes bounces\n");
+    for (uint8_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        for (uint8_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            const KeyLog& k = keys[ri][ci];
+            if (k.changes) fprintf(stderr, "%3u %3u %7u %7u\n", ri, ci, k.changes, k.bounces);
+        }
+    }
+    return 0;
+}
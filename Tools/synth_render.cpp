@@ -0,0 +1,150 @@
+// synthesizer renderer (host side): plays a score through the firmware's own
+// synthesizer (User/synth.cpp) and writes a WAV file (16-bit mono, SYNTH_RATE)
+//
+//   g++ -std=c++11 -O2 -IUser -o synth_render Tools/synth_render.cpp User/synth.cpp User/midi_event.cpp
+//   ./synth_render [--reeds <1..3>] [--detune <cents>] < score.txt > out.wav
+//
+// score: one event per line, in time order ('#': comment)
+//   <time ms> on <note> [<velocity 1..127>]    # default 100
+//   <time ms> off <note>
+//   <time ms> pressure <0..127>                # bellows (default 127)
+//   <time ms> end                              # length (default: last event + 500ms)
+// stderr: summary (samples, peak, voices max, steals, host time per block:
+// mean, and at full polyphony -- compare revisions, not with the target)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <vector>
+
+#include "synth.hpp"
+
+
+struct ScoreEvent {
+    uint32_t t_ms;
+    char what[16];
+    uint32_t arg[2];
+    int args;
+};
+
+static bool read_score(std::vector<ScoreEvent>& score) {
+    char line[128];
+    unsigned n = 0;
+    while (fgets(line, sizeof(line), stdin)) {
+        ++n;
+        char* hash = strchr(line, '#');
+        if (hash) *hash = 0;
+        ScoreEvent e = ScoreEvent();
+        int k = sscanf(line, "%u %15s %u %u", &e.t_ms, e.what, &e.arg[0], &e.arg[1]);
+        if (k <= 0) continue;
+        e.args = k - 2;
+        bool ok = k >= 2 && (!score.size() || e.t_ms >= score.back().t_ms);
+        if (!strcmp(e.what, "on")) ok = ok && e.args >= 1;
+        else if (!strcmp(e.what, "off") || !strcmp(e.what, "pressure")) ok = ok && e.args == 1;
+        else ok = ok && !strcmp(e.what, "end");
+        if (!ok) {
+            fprintf(stderr, "score line %u: cannot parse\n", n);
+            return false;
+        }
+        score.push_back(e);
+    }
+    return true;
+}
+
+static void wr16(FILE* f, uint16_t v) {
+    fputc(v & 0xFF, f);
+    fputc(v >> 8, f);
+}
+
+static void wr32(FILE* f, uint32_t v) {
+    wr16(f, v);
+    wr16(f, v >> 16);
+}
+
+static void wav_header(FILE* f, uint32_t samples) {
+    fwrite("RIFF", 1, 4, f);
+    wr32(f, 36 + 2 * samples);
+    fwrite("WAVEfmt ", 1, 8, f);
+    wr32(f, 16);
+    wr16(f, 1);             // PCM
+    wr16(f, 1);             // mono
+    wr32(f, SYNTH_RATE);
+    wr32(f, 2 * SYNTH_RATE);
+    wr16(f, 2);
+    wr16(f, 16);
+    fwrite("data", 1, 4, f);
+    wr32(f, 2 * samples);
+}
+
+static void note(const ScoreEvent& s, bool on) {
+    MidiEvent e = midi_event(on ? MIDI_EV_NOTE_ON : MIDI_EV_NOTE_OFF, 0);
+    e.note = s.arg[0];
+    e.velocity = midi_scale_up(on && s.args >= 2 ? s.arg[1] : 100, 7, 16);
+    synth_event(e);
+}
+
+int main(int argc, char** argv) {
+    uint8_t reeds = 1, detune = 0;
+    for (int i = 1 ; i + 1 < argc ; i += 2) {
+        if (!strcmp(argv[i], "--reeds")) {
+            reeds = atoi(argv[i + 1]);
+        } else if (!strcmp(argv[i], "--detune")) {
+            detune = atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "unknown option: %s\n", argv[i]);
+            return 2;
+        }
+    }
+    std::vector<ScoreEvent> score;
+    if (!read_score(score)) return 2;
+    uint32_t end_ms = score.size() ? score.back().t_ms + 500 : 500;
+    if (score.size() && !strcmp(score.back().what, "end")) end_ms = score.back().t_ms;
+    uint32_t samples = (uint64_t)end_ms * SYNTH_RATE / 1000;
+
+    synth_init();
+    synth_config(reeds, detune);
+    wav_header(stdout, samples);
+
+    typedef std::chrono::steady_clock clk;
+    double ns = 0, ns_full = 0;
+    uint32_t blocks = 0, blocks_full = 0;
+    uint8_t voices_max = 0;
+    int16_t peak = 0;
+    size_t next = 0;
+    for (uint32_t t = 0 ; t < samples ; t += SYNTH_BLOCK_MAX) {
+        // events take effect at the start of a block (as on the target)
+        uint32_t t_ms = (uint64_t)t * 1000 / SYNTH_RATE;
+        for ( ; next < score.size() && score[next].t_ms <= t_ms ; ++next) {
+            const ScoreEvent& s = score[next];
+            if (!strcmp(s.what, "on")) note(s, true);
+            else if (!strcmp(s.what, "off")) note(s, false);
+            else if (!strcmp(s.what, "pressure")) synth_pressure(midi_scale_up(s.arg[0], 7, 32));
+        }
+        size_t n = samples - t < SYNTH_BLOCK_MAX ? samples - t : SYNTH_BLOCK_MAX;
+        uint8_t voices = synth_voices();
+        if (voices > voices_max) voices_max = voices;
+        int16_t out[SYNTH_BLOCK_MAX];
+        clk::time_point t0 = clk::now();
+        synth_render(out, n);
+        double dt = std::chrono::duration<double, std::nano>(clk::now() - t0).count();
+        ns += dt;
+        ++blocks;
+        if (voices == SYNTH_VOICE_n) {
+            ns_full += dt;
+            ++blocks_full;
+        }
+        for (size_t i = 0 ; i < n ; ++i) {
+            wr16(stdout, out[i]);
+            if (abs(out[i]) > peak) peak = abs(out[i]) > 32767 ? 32767 : abs(out[i]);
+        }
+    }
+
+    fprintf(stderr, "%u samples (%u ms), peak %d, voices max %u, %u steals\n",
+            samples, end_ms, peak, voices_max, synth_steals);
+    fprintf(stderr, "host: %.0f ns per block mean", blocks ? ns / blocks : 0);
+    if (blocks_full) fprintf(stderr, ", %.0f ns at full polyphony", ns_full / blocks_full);
+    fprintf(stderr, " (block: %u samples = %u us)\n", (unsigned)SYNTH_BLOCK_MAX, (unsigned)(SYNTH_BLOCK_MAX * 1000000 / SYNTH_RATE));
+    return 0;
+}
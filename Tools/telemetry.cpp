@@ -0,0 +1,153 @@
+// telemetry decoder (host side, see `telemetry_send` in User/user_main.cpp)
+// reads the host link byte stream (USART2) from stdin, prints every snapshot
+//
+//   g++ -std=c++11 -O2 -IUser -o telemetry Tools/telemetry.cpp User/hostlink_frame.cpp
+//   ./telemetry --request > /dev/ttyUSB0   # ask for a snapshot
+//   ./telemetry --threshold <source#> <us> > /dev/ttyUSB0   # set a worst-case trigger (0: off), ask for a snapshot
+//   ./telemetry < /dev/ttyUSB0
+//
+// between two snapshots, the cycles of the thread and of each interrupt
+// source are also shown as a share of the time in between (at the FULL
+// clock profile, as measured by the startup benchmark)
+//
+// stack free space: the least so far (0: overflowed, or not measured)
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cpuload.h"
+#include "hostlink.hpp"
+#include "keymat_bench.hpp"
+#include "synth.hpp"
+
+
+static const char* const COUNTERS[] = {
+    "tick ms", "event latency us", "event latency us max", "field cycles max",
+    "MIDI in overruns", "MPE steals", "flash store errors", "link preempts",
+    "link TX drops", "link RX overruns", "link RX errors", "scope lost",
+};
+static const size_t COUNTER_n = sizeof(COUNTERS) / sizeof(COUNTERS[0]);
+static const size_t BENCH_n = 2 + 2 * KEYMAT_BENCH_n;
+static const char* const SOURCES[CPULOAD_IRQ_n + 1] = {"thread", "keymat", "MIDI", "host link", "sched", "SysTick", "synth"};
+// NOTE: same order as `ram_budget` (User/ram.cpp)
+static const char* const BUDGET[] = {
+    "keymat DMA", "debouncers", "key events", "MIDI in DMA", "MIDI out DMA", "host link DMA",
+    "scope", "sched queue", "settings", "flash store", "coupler", "vector table",
+    "synth", "synth output DMA",
+};
+static const size_t BUDGET_n = sizeof(BUDGET) / sizeof(BUDGET[0]);
+
+static uint32_t rd32(const uint8_t* p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// previous snapshot: tick, thread + interrupt cycles
+static bool have_last = false;
+static uint32_t last_tick;
+static uint32_t last_cycles[CPULOAD_IRQ_n + 1];
+
+// handler run time: ns since version 9, cycles before (at `mhz`, which
+// assumes the clock of the startup benchmark)
+static void run_time(uint32_t v, uint8_t version, uint32_t mhz) {
+    if (version >= 9) printf("%.3f us", v / 1000.0);
+    else if (mhz) printf("%u cycles (%.1f us)", v, (double)v / mhz);
+    else printf("%u cycles", v);
+}
+
+static void wcet(const char* name, const uint8_t* p, uint8_t version, uint32_t mhz) {
+    uint32_t v = rd32(p + 8);
+    if (!v) return;
+    uint32_t ctx = rd32(p + 12);
+    uint8_t irq = ctx & 0xFF;
+    printf("  %-22s %s ", name, irq < CPULOAD_IRQ_n ? SOURCES[irq + 1] : "?");
+    run_time(v, version, mhz);
+    printf(" at %u ms, field %u, %u keys changed, %u events queued\n", rd32(p), rd32(p + 4), (ctx >> 8) & 0xFF, (ctx >> 16) & 0xFF);
+}
+
+static void snapshot(const uint8_t* t, size_t n) {
+    uint8_t version = t[0];
+    size_t words = (n - 1) / 4;
+    const uint8_t* p = t + 1;
+    printf("telemetry version %u\n", version);
+    for (size_t i = 0 ; i < COUNTER_n && i < words ; ++i) printf("  %-22s %u\n", COUNTERS[i], rd32(p + 4 * i));
+    if (version < 4 || words < COUNTER_n + BENCH_n + 3 + CPULOAD_IRQ_n) return;
+
+    uint32_t tick = rd32(p);
+    uint32_t mhz = rd32(p + 4 * COUNTER_n) / KEYMAT_FIELD_PERIOD_Tus;
+    const uint8_t* q = p + 4 * (COUNTER_n + BENCH_n);
+    printf("  CPU load               %.1f%% (max %.1f%%)\n", rd32(q) / 10.0, rd32(q + 4) / 10.0);
+    q += 8;
+    for (size_t i = 0 ; i <= CPULOAD_IRQ_n ; ++i) {
+        uint32_t cycles = rd32(q + 4 * i);
+        printf("  %-22s %10u cycles", SOURCES[i], cycles);
+        if (have_last && mhz && tick != last_tick) {
+            double elapsed = (double)(tick - last_tick) * 1000 * mhz;
+            printf("  %6.2f%%", 100 * (uint32_t)(cycles - last_cycles[i]) / elapsed);
+        }
+        printf("\n");
+        last_cycles[i] = cycles;
+    }
+    last_tick = tick;
+    have_last = true;
+    if (version < 5 || words < COUNTER_n + BENCH_n + 3 + 2 * CPULOAD_IRQ_n + 9) return;
+
+    q += 4 * (CPULOAD_IRQ_n + 1);
+    for (size_t i = 0 ; i < CPULOAD_IRQ_n ; ++i) {
+        printf("  %-22s longest ", SOURCES[i + 1]);
+        run_time(rd32(q + 4 * i), version, mhz);
+        printf("\n");
+    }
+    q += 4 * CPULOAD_IRQ_n;
+    printf("  %-22s %u\n", "triggers", rd32(q));
+    wcet("worst trigger", q + 4, version, mhz);
+    wcet("last trigger", q + 20, version, mhz);
+    q += 4 + 2 * 16;
+    if (version < 6 || (size_t)(t + n - q) < 4 * 5 + 1) return;
+
+    printf("  %-22s %u of %u bytes free\n", "main stack", rd32(q + 4), rd32(q));
+    printf("  %-22s %u bytes free\n", "main thread stack", rd32(q + 8));
+    printf("  %-22s %u bytes, %u spare\n", "static data", rd32(q + 12), rd32(q + 16));
+    q += 20;
+    uint8_t budget_n = *q++;
+    for (uint8_t i = 0 ; i < budget_n && (size_t)(t + n - q) >= 2 ; ++i, q += 2) {
+        printf("    %-20s %5u\n", i < BUDGET_n ? BUDGET[i] : "?", q[0] | (q[1] << 8));
+    }
+    if (version < 7 || (size_t)(t + n - q) < 4) return;
+
+    // one block per half of the output buffer: must take less than a block
+    uint32_t synth = rd32(q);
+    printf("  %-22s %u cycles", "synth block", synth);
+    if (synth && mhz) {
+        double period = (double)SYNTH_BLOCK_MAX * 1000000 / SYNTH_RATE;
+        printf(" (%.1f us, %.1f%% of %.0f us)", (double)synth / mhz, 100 * synth / (period * mhz), period);
+    }
+    printf("\n");
+    q += 4;
+    if (version < 8 || (size_t)(t + n - q) < 4) return;
+
+    printf("  %-22s %u\n", "keymat resyncs", rd32(q));
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1 && !strcmp(argv[1], "--request")) {
+        uint8_t frame[HOSTLINK_FRAME_n];
+        fwrite(frame, 1, hostlink_frame_encode(HOSTLINK_CH_TELEMETRY, nullptr, 0, frame), stdout);
+        return 0;
+    }
+    if (argc > 3 && !strcmp(argv[1], "--threshold")) {
+        uint32_t us = strtoul(argv[3], nullptr, 0);
+        uint8_t cmd[5] = {(uint8_t)atoi(argv[2]), (uint8_t)us, (uint8_t)(us >> 8), (uint8_t)(us >> 16), (uint8_t)(us >> 24)};
+        uint8_t frame[HOSTLINK_FRAME_n];
+        fwrite(frame, 1, hostlink_frame_encode(HOSTLINK_CH_TELEMETRY, cmd, sizeof(cmd), frame), stdout);
+        return 0;
+    }
+    static HostlinkDecoder link;
+    int c;
+    while ((c = getchar()) != EOF) {
+        if (!link.feed(c) || link.channel != HOSTLINK_CH_TELEMETRY || !link.payload_n) continue;
+        snapshot(link.payload, link.payload_n);
+        fflush(stdout);
+    }
+    return 0;
+}
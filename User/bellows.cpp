@@ -0,0 +1,89 @@
+#include "bellows.hpp"
+
+#include "stm32f1xx_hal.h"
+
+#include "cyccnt.h"
+#include "ramfunc.h"
+
+
+#define BELLOWS_GPIO GPIOB
+static const uint8_t BELLOWS_PIN = 0;
+static const uint8_t BELLOWS_ADC_CH = 8;
+
+// filter state: 12-bit sample << 4
+static uint32_t bellows_acc = 0;
+static uint16_t bellows_rest = 0x800;
+static volatile uint16_t bellows_out = 0;
+static uint8_t bellows_fields = 0;
+
+static void bellows_delay_us(uint32_t us) {
+    uint32_t t0 = cyccnt();
+    while (cyccnt() - t0 < SystemCoreClock / 1000000 * us);
+}
+
+static void bellows_adc_init() {
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    // ADCCLK <= 14MHz: PCLK2 / 6 (12MHz @ 72MHz)
+    RCC->CFGR = (RCC->CFGR & ~RCC_CFGR_ADCPRE) | RCC_CFGR_ADCPRE_DIV6;
+
+    // analog input
+    uint32_t shift = 4 * (BELLOWS_PIN & 7);
+    volatile uint32_t* cr = BELLOWS_PIN < 8 ? &BELLOWS_GPIO->CRL : &BELLOWS_GPIO->CRH;
+    *cr &= ~(0xFu << shift);
+
+    // single channel, longest sample time (sensor output impedance)
+    ADC1->CR1 = 0;
+    ADC1->SQR1 = 0; // 1 conversion
+    ADC1->SQR3 = BELLOWS_ADC_CH;
+    ADC1->SMPR2 = 7 << (3 * BELLOWS_ADC_CH); // 239.5 cycles
+
+    // power up, wait tSTAB (1us), calibrate
+    ADC1->CR2 = ADC_CR2_ADON;
+    bellows_delay_us(2);
+    ADC1->CR2 |= ADC_CR2_RSTCAL;
+    while (ADC1->CR2 & ADC_CR2_RSTCAL);
+    ADC1->CR2 |= ADC_CR2_CAL;
+    while (ADC1->CR2 & ADC_CR2_CAL);
+
+    // continuous conversion: DR always holds a recent sample
+    ADC1->CR2 |= ADC_CR2_CONT;
+    ADC1->CR2 |= ADC_CR2_ADON; // start
+}
+
+void bellows_init() {
+    bellows_adc_init();
+    // rest level: average over ~16ms (after the first conversions)
+    bellows_delay_us(100);
+    uint32_t sum = 0;
+    for (size_t i = 0 ; i < 64 ; ++i) {
+        bellows_delay_us(250);
+        sum += ADC1->DR & 0xFFF;
+    }
+    bellows_rest = sum / 64;
+    bellows_acc = bellows_rest << 4;
+}
+
+RAMFUNC bool bellows_field() {
+    // 1st-order low-pass: ~16 fields (3.2ms) time constant
+    uint32_t x = ADC1->DR & 0xFFF;
+    bellows_acc += x - (bellows_acc >> 4);
+    if (++bellows_fields < BELLOWS_REPORT_FIELDS) return false;
+    bellows_fields = 0;
+
+    // magnitude around the rest level, scaled to 14 bits
+    int32_t d = (int32_t)(bellows_acc >> 4) - bellows_rest;
+    if (d < 0) d = -d;
+    uint32_t v = (uint32_t)d << 3; // 11-bit magnitude => 14 bits
+    if (v > 0x3FFF) v = 0x3FFF;
+
+    int32_t dv = (int32_t)v - bellows_out;
+    if (-(int32_t)BELLOWS_HYST < dv && dv < (int32_t)BELLOWS_HYST && v != 0 && v != 0x3FFF) return false;
+    if (v == bellows_out) return false;
+    bellows_out = v;
+    return true;
+}
+
+uint16_t bellows_value() {
+    return bellows_out;
+}
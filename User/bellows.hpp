@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+// bellows pressure: analog sensor on PB0 (ADC1_IN8)
+// - differential pressure sensor, mid-scale at rest (push and pull both
+//   sound); the rest level is measured at startup
+// - sampled once per scan field (see `bellows_field`), low-pass filtered,
+//   reported as a 14-bit magnitude with a small hysteresis against ADC noise
+// - ADC1 converts continuously; no DMA, no interrupt
+
+// report at most every this many fields (i.e. 2ms)
+static const uint8_t BELLOWS_REPORT_FIELDS = 10;
+
+// hysteresis (14-bit units; 1 ADC LSB = 8 after scaling the magnitude)
+static const uint16_t BELLOWS_HYST = 8;
+
+// setup ADC; measure the rest level (bellows must be at rest)
+void bellows_init(void);
+
+// sample; call once per field (ISR)
+// return: whether a new value is due to be reported
+bool bellows_field(void);
+
+// latest reported value (0 .. 0x3FFF)
+uint16_t bellows_value(void);
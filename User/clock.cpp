@@ -0,0 +1,206 @@
+#include "clock.hpp"
+
+#include "usart.h"
+
+#include "cpuload.h"
+#include "hostlink.hpp"
+#include "keymat.hpp"
+#include "midi_out.hpp"
+#include "sched.hpp"
+#include "synth_pwm.hpp"
+
+
+////////////////////////////////////////
+// profile definitions
+
+struct ClockProfile {
+    uint32_t sysclk;
+    uint32_t pll_source;
+    uint32_t pll_mul;
+    uint32_t apb1_div;
+    uint32_t apb2_div;
+    uint32_t flash_latency;
+};
+
+// NOTE: APB1/APB2 prescalers are always 1 or 2 => all timer clocks equal SYSCLK
+static const ClockProfile clock_profile_boot = {
+    48000000, RCC_PLLSOURCE_HSI_DIV2, RCC_PLL_MUL12, RCC_HCLK_DIV2, RCC_HCLK_DIV2, FLASH_LATENCY_1,
+};
+static const ClockProfile clock_profile_full_hse = {
+    72000000, RCC_PLLSOURCE_HSE,      RCC_PLL_MUL9,  RCC_HCLK_DIV2, RCC_HCLK_DIV1, FLASH_LATENCY_2,
+};
+static const ClockProfile clock_profile_full_hsi = {
+    64000000, RCC_PLLSOURCE_HSI_DIV2, RCC_PLL_MUL16, RCC_HCLK_DIV2, RCC_HCLK_DIV1, FLASH_LATENCY_2,
+};
+static const ClockProfile clock_profile_idle = {
+    24000000, RCC_PLLSOURCE_HSI_DIV2, RCC_PLL_MUL6,  RCC_HCLK_DIV1, RCC_HCLK_DIV1, FLASH_LATENCY_0,
+};
+
+static const ClockProfile clock_profile_hsi = {
+    HSI_VALUE, 0,                     0,             RCC_HCLK_DIV1, RCC_HCLK_DIV1, FLASH_LATENCY_0,
+};
+
+static bool clock_hse_ok = false;
+static clock_profile_t clock_current = CLOCK_PROFILE_BOOT;
+
+static const ClockProfile& clock_profile_get(clock_profile_t profile) {
+    switch (profile) {
+    case CLOCK_PROFILE_FULL:
+        return clock_hse_ok ? clock_profile_full_hse : clock_profile_full_hsi;
+    case CLOCK_PROFILE_IDLE:
+        return clock_profile_idle;
+    case CLOCK_PROFILE_HSI:
+        return clock_profile_hsi;
+    case CLOCK_PROFILE_BOOT:
+    default:
+        return clock_profile_boot;
+    }
+}
+
+
+////////////////////////////////////////
+// RCC
+
+// run from HSI directly so that the PLL can be reconfigured
+static void clock_rcc_hsi() {
+    RCC_ClkInitTypeDef clk;
+    clk.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+                  |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource = RCC_SYSCLKSOURCE_HSI;
+    clk.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = RCC_HCLK_DIV1;
+    clk.APB2CLKDivider = RCC_HCLK_DIV1;
+    HAL_RCC_ClockConfig(&clk, FLASH_LATENCY_0);
+}
+
+static void clock_rcc_pll_off() {
+    RCC_OscInitTypeDef osc;
+    osc.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+    osc.PLL.PLLState = RCC_PLL_OFF;
+    HAL_RCC_OscConfig(&osc);
+}
+
+static bool clock_rcc_pll(const ClockProfile& p) {
+    RCC_OscInitTypeDef osc;
+    osc.OscillatorType = RCC_OSCILLATORTYPE_NONE;
+    osc.PLL.PLLState = RCC_PLL_ON;
+    osc.PLL.PLLSource = p.pll_source;
+    osc.PLL.PLLMUL = p.pll_mul;
+    if (HAL_RCC_OscConfig(&osc) != HAL_OK) return false;
+
+    RCC_ClkInitTypeDef clk;
+    clk.ClockType = RCC_CLOCKTYPE_HCLK|RCC_CLOCKTYPE_SYSCLK
+                  |RCC_CLOCKTYPE_PCLK1|RCC_CLOCKTYPE_PCLK2;
+    clk.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
+    clk.AHBCLKDivider = RCC_SYSCLK_DIV1;
+    clk.APB1CLKDivider = p.apb1_div;
+    clk.APB2CLKDivider = p.apb2_div;
+    return HAL_RCC_ClockConfig(&clk, p.flash_latency) == HAL_OK;
+}
+
+
+////////////////////////////////////////
+// peripheral retiming
+
+static void clock_retime_systick() {
+    // same as `SystemClock_Config()`
+    // NOTE: `HAL_RCC_ClockConfig` already reloads SysTick through the (weak)
+    // `HAL_InitTick`, but the RTOS port may have overridden it
+    HAL_SYSTICK_Config(HAL_RCC_GetHCLKFreq()/1000);
+    HAL_SYSTICK_CLKSourceConfig(SYSTICK_CLKSOURCE_HCLK);
+    HAL_NVIC_SetPriority(SysTick_IRQn, 7, 0);
+}
+
+static void clock_retime_uart() {
+    huart3.Instance->BRR = UART_BRR_SAMPLING16(HAL_RCC_GetPCLK1Freq(), huart3.Init.BaudRate);
+    hostlink_retime();
+}
+
+
+
+////////////////////////////////////////
+// public interface
+
+void clock_init() {
+    // OSC_IN/OSC_OUT are remapped to PD0/PD1 by `MX_GPIO_Init()`; undo that
+    // while probing for a crystal
+    __HAL_AFIO_REMAP_PD01_DISABLE();
+    RCC_OscInitTypeDef osc;
+    osc.OscillatorType = RCC_OSCILLATORTYPE_HSE;
+    osc.HSEState = RCC_HSE_ON;
+    osc.HSEPredivValue = RCC_HSE_PREDIV_DIV1;
+    osc.PLL.PLLState = RCC_PLL_NONE;
+    clock_hse_ok = HAL_RCC_OscConfig(&osc) == HAL_OK;
+    if (!clock_hse_ok) {
+        osc.HSEState = RCC_HSE_OFF;
+        HAL_RCC_OscConfig(&osc);
+        __HAL_AFIO_REMAP_PD01_ENABLE();
+    }
+}
+
+void clock_set_profile(clock_profile_t profile) {
+    if (profile == clock_current) return;
+    const ClockProfile& p = clock_profile_get(profile);
+
+    // last byte of the current transmission has left the shift register
+    midi_out_flush();
+
+    // the scan timer prescaler is buffered and only takes effect on the next
+    // update event (row boundary): load the final value up front
+    // NOTE: rows scanned while the PLL relocks (< 200us) run slow, but each
+    // is still sampled at the same relative point => debouncing merely sees a
+    // longer timestep
+    keymat_retime(p.sysclk);
+
+    clock_rcc_hsi();
+    // the output timebase is reloaded immediately: follow each step
+    sched_retime(clock_tim_freq(TIM2));
+    if (profile == CLOCK_PROFILE_HSI) {
+        clock_rcc_pll_off();
+    } else if (!clock_rcc_pll(p)) {
+        // cannot happen with a fixed set of profiles; stay on HSI but keep
+        // everything consistent with it
+        keymat_retime(clock_tim_freq(KEYMAT_TIM));
+    }
+    sched_retime(clock_tim_freq(TIM2));
+    synth_pwm_retime(clock_tim_freq(TIM4));
+    clock_retime_systick();
+    clock_retime_uart();
+    cpuload_retime(HAL_RCC_GetHCLKFreq());
+
+    clock_current = profile;
+}
+
+void clock_stop_exit() {
+    // SYSCLK is HSI already; only the bus prescalers and everything derived
+    // from the clock need to catch up
+    keymat_retime(clock_profile_hsi.sysclk);
+    clock_rcc_hsi();
+    sched_retime(clock_tim_freq(TIM2));
+    synth_pwm_retime(clock_tim_freq(TIM4));
+    clock_retime_systick();
+    clock_retime_uart();
+    cpuload_retime(HAL_RCC_GetHCLKFreq());
+    clock_current = CLOCK_PROFILE_HSI;
+}
+
+clock_profile_t clock_profile() { return clock_current; }
+
+bool clock_has_hse() { return clock_hse_ok; }
+
+uint32_t clock_tim_freq(TIM_TypeDef* tim) {
+    bool apb2 = tim == TIM1;
+#ifdef TIM8
+    apb2 = apb2 || tim == TIM8;
+#endif
+    uint32_t pclk, ppre;
+    if (apb2) {
+        pclk = HAL_RCC_GetPCLK2Freq();
+        ppre = RCC->CFGR & RCC_CFGR_PPRE2;
+    } else {
+        pclk = HAL_RCC_GetPCLK1Freq();
+        ppre = RCC->CFGR & RCC_CFGR_PPRE1;
+    }
+    // PPREx == 0xx: HCLK not divided
+    return ppre == 0 ? pclk : pclk * 2;
+}
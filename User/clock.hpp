@@ -0,0 +1,45 @@
+#pragma once
+
+#include "stm32f1xx_hal.h"
+
+// selectable system clock profiles
+// | profile | source                 | SYSCLK | APB1 | APB2 | FLASH |
+// |---------|------------------------|--------|------|------|-------|
+// | BOOT    | HSI/2 x 12             | 48MHz  | 24   | 24   | 1 WS  |
+// | FULL    | HSE x 9                | 72MHz  | 36   | 72   | 2 WS  |
+// |         | (no HSE: HSI/2 x 16)   | 64MHz  | 32   | 64   | 2 WS  |
+// | IDLE    | HSI/2 x 6              | 24MHz  | 24   | 24   | 0 WS  |
+// | HSI     | HSI (PLL off)          | 8MHz   | 8    | 8    | 0 WS  |
+// BOOT is what `SystemClock_Config()` sets up before `user_main()`.
+// HSI is what the chip runs on after waking up from STOP mode.
+enum clock_profile_t {
+    CLOCK_PROFILE_BOOT,
+    CLOCK_PROFILE_FULL,
+    CLOCK_PROFILE_IDLE,
+    CLOCK_PROFILE_HSI,
+};
+
+// probe HSE once (so that later switches never wait for it to start up)
+void clock_init(void);
+
+// switch to another clock profile; retimes SysTick, USART3 (and the host link
+// on USART2) and the scan timer
+// - waits for the UART to finish shifting out the current byte; caller must
+//   make sure no new transmission is started meanwhile (i.e. call from the
+//   thread that transmits)
+// - the scan keeps running: at most one row is stretched/shrunk, the
+//   sampling point within that row scales along with it
+// - a MIDI input byte being received during the switch may be corrupted
+//   (the parser resynchronizes on the next status byte)
+void clock_set_profile(clock_profile_t profile);
+clock_profile_t clock_profile(void);
+
+// resynchronize after waking up from STOP mode (hardware has fallen back to
+// the HSI profile); fast -- does not wait for any oscillator
+void clock_stop_exit(void);
+
+// whether the FULL profile could use HSE (otherwise it falls back to HSI)
+bool clock_has_hse(void);
+
+// input clock frequency of a timer (x2 when its APB prescaler is not 1)
+uint32_t clock_tim_freq(TIM_TypeDef* tim);
@@ -0,0 +1,51 @@
+#include "coro.hpp"
+
+
+static uint32_t coro_no_tick() { return 0; }
+coro_tick_t coro_tick = coro_no_tick;
+
+// tasks, in order of `coro_start`
+static Coro* coro_head = nullptr;
+static Coro* coro_tail = nullptr;
+
+void coro_start(Coro& c) {
+    c.resume = 0;
+    c.blocked = false;
+    c.next = nullptr;
+    if (coro_tail) {
+        coro_tail->next = &c;
+    } else {
+        coro_head = &c;
+    }
+    coro_tail = &c;
+}
+
+bool coro_run() {
+    bool ready = false;
+    Coro* prev = nullptr;
+    for (Coro* c = coro_head ; c ; ) {
+        Coro* next = c->next;
+        c->blocked = false;
+        if (!c->body(*c)) {
+            // finished: unlink
+            if (prev) {
+                prev->next = next;
+            } else {
+                coro_head = next;
+            }
+            if (coro_tail == c) coro_tail = prev;
+            c->next = nullptr;
+        } else {
+            if (!c->blocked) ready = true;
+            prev = c;
+        }
+        c = next;
+    }
+    return ready;
+}
+
+size_t coro_count() {
+    size_t n = 0;
+    for (Coro* c = coro_head ; c ; c = c->next) ++n;
+    return n;
+}
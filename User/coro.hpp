@@ -0,0 +1,100 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// stackless coroutines: cooperative tasks on a single stack
+// - a task derives from `Coro`: its members are its frame (allocated
+//   statically by the owner, like any other object), its body is a plain
+//   function written as sequential code between CORO_BEGIN and CORO_END
+// - suspension points (CORO_YIELD / CORO_AWAIT*) return from the body; it
+//   resumes right after them on the next call (switch on the line number)
+// - switching costs a function call and a jump; 16 bytes per task on top of
+//   its own members (compare with a thread's stack and control block)
+// - the executor (`coro_run`) calls every task in turn; a task waiting for
+//   something re-checks it on each call (ring, signal, tick -- see below)
+// NOTE: locals of the body do not survive a suspension: keep state in the
+// frame; at most one suspension point per source line; no suspension inside
+// a `switch` of the body
+// NOTE: C++11 stand-in for C++20 coroutines (not supported by the toolchain)
+// NOTE: hardware-independent (host-buildable)
+
+struct Coro;
+
+// body: run until the next suspension point
+// return: false once finished (removed from the executor)
+typedef bool (*coro_body_t)(Coro& c);
+
+struct Coro {
+    coro_body_t body;
+    Coro* next;         // executor list
+    uint32_t wake;      // CORO_SLEEP: tick to wait for
+    uint16_t resume;    // line to resume at (0: start)
+    bool blocked;       // last call ended waiting (nothing to do)
+
+    explicit Coro(coro_body_t b) : body(b), next(nullptr), wake(0), resume(0), blocked(false) {}
+};
+
+// time base of CORO_SLEEP (e.g. `HAL_GetTick`; a simulated tick on the host)
+typedef uint32_t (*coro_tick_t)(void);
+extern coro_tick_t coro_tick;
+
+// add a task to the executor (runs from the start on the next `coro_run`)
+// NOTE: thread context
+void coro_start(Coro& c);
+
+// call every task once
+// return: whether any task is ready to go on (otherwise all are waiting:
+// sleep until the next interrupt)
+bool coro_run(void);
+
+// number of tasks in the executor
+size_t coro_count(void);
+
+
+////////////////////////////////////////
+// body
+
+#define CORO_BEGIN(c) switch ((c).resume) { case 0:
+
+#define CORO_END(c) } (c).resume = 0; return false
+
+// let the other tasks run
+#define CORO_YIELD(c) \
+    do { (c).resume = __LINE__; return true; case __LINE__:; } while (0)
+
+// wait until `cond` holds (re-evaluated on every call)
+// NOTE: the case label sits in a block of its own, skipped on the way in --
+// no implicit fallthrough into it (-Wimplicit-fallthrough)
+#define CORO_AWAIT(c, cond) \
+    do { (c).resume = __LINE__; if (0) { case __LINE__:; } \
+        if (!(cond)) { (c).blocked = true; return true; } } while (0)
+
+// wait for `ms` ticks
+#define CORO_SLEEP(c, ms) \
+    do { (c).wake = coro_tick() + (ms); \
+        CORO_AWAIT(c, (int32_t)(coro_tick() - (c).wake) >= 0); } while (0)
+
+// ring buffers (see ring.hpp): wait for an element / for room
+#define CORO_AWAIT_POP(c, ring, x) CORO_AWAIT(c, (ring).pop(x))
+#define CORO_AWAIT_PUSH(c, ring, x) CORO_AWAIT(c, (ring).push(x))
+
+// wait for a signal, and clear it
+#define CORO_AWAIT_SIGNAL(c, s) CORO_AWAIT(c, (s).take())
+
+
+////////////////////////////////////////
+// signal: set from ISR (e.g. DMA transfer complete), awaited by one task
+
+struct CoroSignal {
+    volatile bool set;
+
+    CoroSignal() : set(false) {}
+
+    void raise() { set = true; }
+    bool take() {
+        if (!set) return false;
+        set = false;
+        return true;
+    }
+};
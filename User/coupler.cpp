@@ -0,0 +1,172 @@
+#include "coupler.hpp"
+
+#include <string.h>
+
+
+static const size_t KEY_n = KEYMAT_ROW_n * KEYMAT_COL_n;
+static const uint8_t NONE = 0xFF;
+
+coupler_output_t coupler_output = nullptr;
+
+
+////////////////////////////////////////
+// compiled register
+
+struct CouplerVoice {
+    int8_t offset;
+    uint8_t channel;
+};
+
+static bool coupler_voice_eq(const CouplerVoice& a, const CouplerVoice& b) {
+    return a.offset == b.offset && a.channel == b.channel;
+}
+
+static bool coupler_voice_in(const CouplerVoice& v, const CouplerVoice* voices, uint8_t n) {
+    for (size_t i = 0 ; i < n ; ++i) {
+        if (coupler_voice_eq(v, voices[i])) return true;
+    }
+    return false;
+}
+
+static CouplerConfig coupler_config;
+static CouplerVoice coupler_voices[COUPLER_RANK_n];
+static uint8_t coupler_voice_n = 0;
+
+// NOTE: identical ranks collapse into one voice
+static void coupler_compile() {
+    coupler_voice_n = 0;
+    for (size_t i = 0 ; i < COUPLER_RANK_n ; ++i) {
+        if (!(coupler_config.mask & (1 << i))) continue;
+        CouplerVoice v = {coupler_config.ranks[i].offset, (uint8_t)(coupler_config.ranks[i].channel & 0xF)};
+        if (coupler_voice_in(v, coupler_voices, coupler_voice_n)) continue;
+        coupler_voices[coupler_voice_n++] = v;
+    }
+}
+
+
+////////////////////////////////////////
+// sounding notes
+
+// reference counts: 4 bits per (channel, note)
+// NOTE: saturates at 15 -- more than any real chord with duplicate buttons
+// and overlapping ranks can reach
+static const uint8_t REF_MAX = 15;
+static uint8_t coupler_refs[16][128 / 2];
+
+static uint8_t coupler_ref_get(uint8_t ch, uint8_t note) {
+    return (coupler_refs[ch][note >> 1] >> ((note & 1) * 4)) & 0xF;
+}
+
+static void coupler_ref_set(uint8_t ch, uint8_t note, uint8_t ref) {
+    uint8_t shift = (note & 1) * 4;
+    uint8_t& b = coupler_refs[ch][note >> 1];
+    b = (b & ~(0xF << shift)) | (ref << shift);
+}
+
+// keys being held: base note and channel (NONE: not held)
+static uint8_t coupler_held_note[KEY_n];
+static uint8_t coupler_held_channel[KEY_n];
+const uint16_t coupler_ram_n = sizeof(coupler_refs) + sizeof(coupler_held_note) + sizeof(coupler_held_channel);
+
+static void coupler_send(midi_event_type_t type, uint8_t ch, uint8_t note, uint16_t velocity) {
+    MidiEvent e = midi_event(type, ch);
+    e.note = note;
+    e.velocity = velocity;
+    if (coupler_output) coupler_output(e);
+}
+
+static void coupler_voice_on(const CouplerVoice& v, uint8_t note, uint8_t channel, uint16_t velocity) {
+    int16_t n = note + v.offset;
+    if (n < 0 || n > 127) return;
+    uint8_t ch = (channel + v.channel) & 0xF;
+    uint8_t ref = coupler_ref_get(ch, n);
+    if (ref == 0) coupler_send(MIDI_EV_NOTE_ON, ch, n, velocity);
+    if (ref < REF_MAX) coupler_ref_set(ch, n, ref + 1);
+}
+
+static void coupler_voice_off(const CouplerVoice& v, uint8_t note, uint8_t channel) {
+    int16_t n = note + v.offset;
+    if (n < 0 || n > 127) return;
+    uint8_t ch = (channel + v.channel) & 0xF;
+    uint8_t ref = coupler_ref_get(ch, n);
+    if (ref == 0) return;
+    coupler_ref_set(ch, n, ref - 1);
+    if (ref == 1) coupler_send(MIDI_EV_NOTE_OFF, ch, n, 0);
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void coupler_init() {
+    memset(&coupler_config, 0, sizeof(coupler_config));
+    coupler_config.mask = 1; // single rank, no offset
+    coupler_compile();
+    memset(coupler_refs, 0, sizeof(coupler_refs));
+    memset(coupler_held_note, NONE, sizeof(coupler_held_note));
+    memset(coupler_held_channel, 0, sizeof(coupler_held_channel));
+}
+
+void coupler_set(const CouplerConfig& config, uint16_t velocity) {
+    if (memcmp(&config, &coupler_config, sizeof(CouplerConfig)) == 0) return;
+
+    CouplerVoice old_voices[COUPLER_RANK_n];
+    uint8_t old_n = coupler_voice_n;
+    memcpy(old_voices, coupler_voices, sizeof(old_voices));
+
+    coupler_config = config;
+    coupler_compile();
+
+    // re-voice held keys: only ranks that differ
+    for (size_t k = 0 ; k < KEY_n ; ++k) {
+        uint8_t note = coupler_held_note[k];
+        if (note == NONE) continue;
+        uint8_t channel = coupler_held_channel[k];
+        for (size_t i = 0 ; i < old_n ; ++i) {
+            if (coupler_voice_in(old_voices[i], coupler_voices, coupler_voice_n)) continue;
+            coupler_voice_off(old_voices[i], note, channel);
+        }
+        for (size_t i = 0 ; i < coupler_voice_n ; ++i) {
+            if (coupler_voice_in(coupler_voices[i], old_voices, old_n)) continue;
+            coupler_voice_on(coupler_voices[i], note, channel, velocity);
+        }
+    }
+}
+
+void coupler_stop_all() {
+    for (size_t k = 0 ; k < KEY_n ; ++k) {
+        if (coupler_held_note[k] == NONE) continue;
+        for (size_t i = 0 ; i < coupler_voice_n ; ++i) {
+            coupler_voice_off(coupler_voices[i], coupler_held_note[k], coupler_held_channel[k]);
+        }
+    }
+}
+
+void coupler_start_all(uint16_t velocity) {
+    for (size_t k = 0 ; k < KEY_n ; ++k) {
+        if (coupler_held_note[k] == NONE) continue;
+        for (size_t i = 0 ; i < coupler_voice_n ; ++i) {
+            coupler_voice_on(coupler_voices[i], coupler_held_note[k], coupler_held_channel[k], velocity);
+        }
+    }
+}
+
+void coupler_press(uint8_t key, uint8_t note, uint8_t channel, uint16_t velocity) {
+    if (key >= KEY_n) return;
+    if (coupler_held_note[key] != NONE) coupler_release(key);
+    coupler_held_note[key] = note;
+    coupler_held_channel[key] = channel;
+    for (size_t i = 0 ; i < coupler_voice_n ; ++i) {
+        coupler_voice_on(coupler_voices[i], note, channel, velocity);
+    }
+}
+
+void coupler_release(uint8_t key) {
+    if (key >= KEY_n) return;
+    uint8_t note = coupler_held_note[key];
+    if (note == NONE) return;
+    for (size_t i = 0 ; i < coupler_voice_n ; ++i) {
+        coupler_voice_off(coupler_voices[i], note, coupler_held_channel[key]);
+    }
+    coupler_held_note[key] = NONE;
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "keymat_conf.hpp"
+#include "midi_event.hpp"
+
+// accordion registers: each key press sounds a set of reed ranks
+// - a rank is a fixed offset (semitones) on a channel (relative to the key's
+//   base channel), e.g. 16' = -12, 8' = 0, 4' = +12
+// - a register selects any subset of the ranks; the selection is compiled
+//   into a flat voice list, so each event only walks the ranks that sound
+// - notes are reference-counted per (channel, note): overlapping ranks and
+//   duplicate buttons only start a note once and stop it with the last one
+// - changing the register while keys are held re-voices them: ranks that
+//   are no longer selected stop, newly selected ones start, others sustain
+// NOTE: thread context only
+
+static const size_t COUPLER_RANK_n = 4;
+
+struct CouplerRank {
+    int8_t offset;      // semitones
+    uint8_t channel;    // added to the key's base channel (mod 16)
+};
+
+struct CouplerConfig {
+    CouplerRank ranks[COUPLER_RANK_n];
+    uint8_t mask; // selected ranks (bit i: ranks[i])
+};
+
+// output: note on/off (velocity: 16-bit)
+typedef void (*coupler_output_t)(const MidiEvent& e);
+extern coupler_output_t coupler_output;
+
+void coupler_init(void);
+
+// switch to a new register/rank configuration (re-voices held keys)
+// NOTE: no-op if unchanged
+void coupler_set(const CouplerConfig& config, uint16_t velocity);
+
+// stop all sounding notes / start them again for the keys still held
+// (e.g. around a change of the output path)
+void coupler_stop_all(void);
+void coupler_start_all(uint16_t velocity);
+
+// key `key` (row * KEYMAT_COL_n + col) pressed/released
+void coupler_press(uint8_t key, uint8_t note, uint8_t channel, uint16_t velocity);
+void coupler_release(uint8_t key);
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t coupler_ram_n;
@@ -0,0 +1,150 @@
+#include "cpuload.h"
+
+#include "stm32f1xx_hal.h"
+
+#include "cyccnt.h"
+#include "ramfunc.h"
+
+
+volatile uint32_t cpuload_irq_cycles[CPULOAD_IRQ_n];
+volatile uint32_t cpuload_irq_total = 0;
+volatile uint32_t cpuload_thread_cycles = 0;
+
+volatile uint32_t cpuload_irq_max[CPULOAD_IRQ_n];
+cpuload_trigger_t cpuload_trigger = nullptr;
+volatile uint32_t cpuload_triggers = 0;
+
+// trigger thresholds: as set (us), and in cycles at the current clock
+static uint32_t cpuload_irq_thres_us[CPULOAD_IRQ_n];
+static uint32_t cpuload_irq_thres[CPULOAD_IRQ_n];
+
+// current core clock (MHz; the reset clock until the first retime)
+static uint32_t cpuload_mhz = HSI_VALUE / 1000000;
+
+volatile uint16_t cpuload_permille_last = 0;
+volatile uint16_t cpuload_permille_max = 0;
+
+
+////////////////////////////////////////
+// interrupt handlers
+
+// cycles at the current clock to ns (up to ~4.3s)
+RAMFUNC static uint32_t cycles_ns(uint32_t cycles) {
+    uint32_t mhz = cpuload_mhz;
+    return cycles / mhz * 1000 + cycles % mhz * 1000 / mhz;
+}
+
+// entry state of the handlers being run (innermost last)
+// NOTE: deeper nesting than this is not counted
+static const uint8_t NEST_MAX = 8;
+static uint32_t nest_t0[NEST_MAX];
+static uint32_t nest_total0[NEST_MAX]; // `cpuload_irq_total` at entry
+static uint8_t nest_n = 0;
+
+// NOTE: may be preempted themselves -- the updates must not be
+RAMFUNC void cpuload_irq_enter() {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (nest_n < NEST_MAX) {
+        nest_t0[nest_n] = cyccnt();
+        nest_total0[nest_n] = cpuload_irq_total;
+    }
+    ++nest_n;
+    __set_PRIMASK(primask);
+}
+
+RAMFUNC void cpuload_irq_exit(cpuload_irq_t irq) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    --nest_n;
+    if (nest_n >= NEST_MAX) {
+        __set_PRIMASK(primask);
+        return;
+    }
+    // own time: elapsed minus whatever preempted this handler
+    uint32_t own = (cyccnt() - nest_t0[nest_n]) - (cpuload_irq_total - nest_total0[nest_n]);
+    cpuload_irq_cycles[irq] += own;
+    cpuload_irq_total += own;
+    uint32_t ns = cycles_ns(own);
+    if (ns > cpuload_irq_max[irq]) cpuload_irq_max[irq] = ns;
+    uint32_t thres = cpuload_irq_thres[irq];
+    bool trigger = thres && own > thres;
+    if (trigger) ++cpuload_triggers;
+    __set_PRIMASK(primask);
+
+    if (trigger && cpuload_trigger) cpuload_trigger(irq, ns);
+}
+
+
+void cpuload_set_thres(cpuload_irq_t irq, uint32_t us) {
+    if (irq >= CPULOAD_IRQ_n) return;
+    cpuload_irq_thres_us[irq] = us;
+    cpuload_irq_thres[irq] = us * (SystemCoreClock / 1000000);
+}
+
+void cpuload_retime(uint32_t hclk) {
+    cpuload_mhz = hclk / 1000000;
+    for (uint8_t i = 0 ; i < CPULOAD_IRQ_n ; ++i) {
+        cpuload_irq_thres[i] = cpuload_irq_thres_us[i] * (hclk / 1000000);
+    }
+}
+
+
+////////////////////////////////////////
+// main thread
+
+static bool thread_busy = false;
+static uint32_t thread_t0;
+static uint32_t thread_irq0;
+
+void cpuload_busy() {
+    if (thread_busy) return;
+    thread_t0 = cyccnt();
+    thread_irq0 = cpuload_irq_total;
+    thread_busy = true;
+}
+
+void cpuload_idle() {
+    if (!thread_busy) return;
+    cpuload_thread_cycles += (cyccnt() - thread_t0) - (cpuload_irq_total - thread_irq0);
+    thread_busy = false;
+}
+
+
+////////////////////////////////////////
+// load
+
+static uint32_t window_ms;
+static uint32_t window_hz = 0; // 0: no window open
+static uint32_t window_busy0;
+
+static uint32_t cpuload_busy_cycles() {
+    return cpuload_irq_total + cpuload_thread_cycles;
+}
+
+void cpuload_update() {
+    // count the thread up to now
+    cpuload_idle();
+    cpuload_busy();
+
+    uint32_t now = HAL_GetTick();
+    uint32_t busy = cpuload_busy_cycles();
+    if (window_hz != SystemCoreClock) {
+        // clock changed (or first call): start over
+        window_hz = SystemCoreClock;
+        window_ms = now;
+        window_busy0 = busy;
+        return;
+    }
+    uint32_t dt_ms = now - window_ms;
+    if (dt_ms < CPULOAD_WINDOW_ms) return;
+    window_ms = now;
+    uint32_t cycles = busy - window_busy0;
+    window_busy0 = busy;
+
+    uint64_t elapsed = (uint64_t)dt_ms * (window_hz / 1000);
+    uint32_t permille = (uint64_t)cycles * 1000 / elapsed;
+    if (permille > 1000) permille = 1000;
+    cpuload_permille_last = permille;
+    if (permille > cpuload_permille_max) cpuload_permille_max = permille;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdint.h>
+
+// CPU load accounting (DWT cycle counter, see cyccnt.h)
+// - interrupt handlers: exclusive cycles per source (an interrupt preempting
+//   another is counted for itself only) and the longest run (in time, so
+//   that runs at different clock profiles compare), ~70 cycles of overhead
+//   each
+// - main thread: cycles between waking up and going back to wait (RTOS) or
+//   sleep (superloop), minus the interrupts in between
+// - load: (handlers + thread) / elapsed cycles, over windows of at least
+//   CPULOAD_WINDOW_ms (longer when the thread sleeps through); the rest is
+//   idle (RTOS idle thread / WFI)
+// NOTE: with the RTOS, its SysTick and context switches are not covered
+// (counted as idle; a few us per ms tick)
+// NOTE: C interface -- also used by the interrupt handlers (stm32f1xx_it.c)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    CPULOAD_KEYMAT,     // DMA1 channel 4/5 (scan, debouncing, key events)
+    CPULOAD_MIDI,       // USART3, DMA1 channel 2/3 (MIDI output / input)
+    CPULOAD_HOSTLINK,   // USART2, DMA1 channel 6/7
+    CPULOAD_SCHED,      // TIM2 (output scheduling)
+    CPULOAD_SYSTICK,    // SysTick (superloop only: the RTOS owns it otherwise)
+    CPULOAD_SYNTH,      // DMA1 channel 1 (synthesizer output)
+    // NOTE: add new interrupt sources (e.g. ADC) here
+    CPULOAD_IRQ_n
+} cpuload_irq_t;
+
+#define CPULOAD_WINDOW_ms 1000
+
+// accumulated cycles (wrap around -- use differences)
+extern volatile uint32_t cpuload_irq_cycles[CPULOAD_IRQ_n];
+extern volatile uint32_t cpuload_irq_total;
+extern volatile uint32_t cpuload_thread_cycles;
+
+// worst case: longest run of each source (exclusive, ns)
+extern volatile uint32_t cpuload_irq_max[CPULOAD_IRQ_n];
+
+// trigger: called at the end of a handler that ran longer than the
+// threshold of its source, e.g. to capture what it was working on; gets the
+// run time (ns)
+// NOTE: called from ISR (its own time is not counted)
+typedef void (*cpuload_trigger_t)(cpuload_irq_t irq, uint32_t ns);
+extern cpuload_trigger_t cpuload_trigger;
+extern volatile uint32_t cpuload_triggers;
+
+// trigger threshold of a source (us; 0: off)
+// NOTE: compared in cycles at the current clock -- see `cpuload_retime`
+void cpuload_set_thres(cpuload_irq_t irq, uint32_t us);
+
+// follow a change of the core clock (Hz; see clock.cpp)
+void cpuload_retime(uint32_t hclk);
+
+// load over the last complete window, and the highest so far (0.1%)
+extern volatile uint16_t cpuload_permille_last;
+extern volatile uint16_t cpuload_permille_max;
+
+// interrupt handler: first and last thing
+void cpuload_irq_enter(void);
+void cpuload_irq_exit(cpuload_irq_t irq);
+
+// main thread: about to wait / sleep, and woken up again
+void cpuload_idle(void);
+void cpuload_busy(void);
+
+// close the window once it is complete
+// NOTE: thread context; a window spanning a change of clock profile is
+// discarded
+void cpuload_update(void);
+
+#ifdef __cplusplus
+}
+#endif
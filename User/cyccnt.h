@@ -0,0 +1,28 @@
+#pragma once
+
+#if defined(__CC_ARM) || defined(__arm__)
+
+#include "stm32f1xx.h"
+
+// DWT cycle counter: free-running, counts CPU (HCLK) cycles, wraps every
+// 2^32 cycles (~89s @ 48MHz) -- unsigned differences are always valid
+
+static inline void cyccnt_init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+static inline uint32_t cyccnt(void) {
+    return DWT->CYCCNT;
+}
+
+#else
+
+#include <stdint.h>
+
+// host build (see Tools/): no cycle counter -- always 0
+static inline void cyccnt_init(void) {}
+static inline uint32_t cyccnt(void) { return 0; }
+
+#endif
@@ -6,6 +6,11 @@
 #   include <type_traits>
 #endif // DEBOUNCER_CHECK_TYPE
 
+// optional function specifier for `update` (e.g. to force inlining into a hot caller)
+#ifndef DEBOUNCER_INLINE
+#   define DEBOUNCER_INLINE
+#endif
+
 template <typename T, T thres_transient, T thres_steady>
 struct Debouncer {
 
@@ -51,7 +56,7 @@ struct Debouncer {
 
     // run debouncing algorithm for one timestep
     // return: whether output has changed
-    bool update(bool input) {
+    DEBOUNCER_INLINE bool update(bool input) {
         if (input) {
             if (counter < +thres_steady) ++counter;
         } else {
@@ -108,3 +113,113 @@ struct Debouncer {
         }
     }
 };
+
+// same algorithm with thresholds chosen at run time (shared by all instances)
+// NOTE: thresholds are passed to every call instead of being stored per
+// instance -- one copy for a whole matrix
+template <typename T>
+struct DebouncerVar {
+
+#ifdef DEBOUNCER_CHECK_TYPE
+    static_assert(std::is_signed<T>::value, "");
+#endif // DEBOUNCER_CHECK_TYPE
+
+    struct Thres {
+        T transient_abs; // thres_steady - thres_transient
+        T steady;
+
+        // return: false if out of range (0 < transient < steady)
+        bool set(T thres_transient, T thres_steady) {
+            if (!(0 < thres_transient && thres_transient < thres_steady)) return false;
+            transient_abs = thres_steady - thres_transient;
+            steady = thres_steady;
+            return true;
+        }
+    };
+
+    static const bool LO = false, HI = true;
+
+    // see `Debouncer`
+    T counter;
+    std::uint8_t state;
+
+    void init(bool value, const Thres& th) {
+        if (value) {
+            counter = +th.steady;
+            state = 2;
+        } else {
+            counter = -th.steady;
+            state = 0;
+        }
+    }
+
+    // keep the current output after the thresholds have changed
+    // NOTE: steady states restart from the (new) steady threshold -- otherwise
+    // a raised threshold would immediately look like a transient
+    void retune(const Thres& th) {
+        switch (state) {
+        case 0: counter = -th.steady; break;
+        case 2: counter = +th.steady; break;
+        default:
+            if (counter > +th.steady) counter = +th.steady;
+            if (counter < -th.steady) counter = -th.steady;
+            break;
+        }
+    }
+
+    bool output() { return state == 1 || state == 2; }
+
+    // run debouncing algorithm for one timestep
+    // return: whether output has changed
+    DEBOUNCER_INLINE bool update(bool input, const Thres& th) {
+        if (input) {
+            if (counter < +th.steady) ++counter;
+        } else {
+            if (counter > -th.steady) --counter;
+        }
+        switch (state) {
+        case 0: // steady-state lo
+            if (counter >= -th.transient_abs) {
+                // => transient lo-hi
+                counter = 0;
+                state = 1;
+                return true;
+            }
+            return false;
+        case 1: // transient lo-hi
+            if (counter >= +th.steady) {
+                // => steady-state hi
+                state = 2;
+                return false;
+            }
+            if (counter <= -th.steady) {
+                // => steady-state lo
+                state = 0;
+                return true;
+            }
+            return false;
+        case 2: // steady-state hi
+            if (counter <= +th.transient_abs) {
+                // => transient hi-lo
+                counter = 0;
+                state = 3;
+                return true;
+            }
+            return false;
+        case 3: // transient hi-lo
+            if (counter >= +th.steady) {
+                // => steady-state hi
+                state = 2;
+                return true;
+            }
+            if (counter <= -th.steady) {
+                // => steady-state lo
+                state = 0;
+                return false;
+            }
+            return false;
+        default:
+            return false;
+        }
+    }
+};
@@ -0,0 +1,74 @@
+#include "expr.hpp"
+
+
+static const uint16_t NONE = 0xFFFF;
+
+static void send_cc(const ExprDest& d, uint8_t channel, uint8_t cc, uint8_t v) {
+    uint8_t msg[3] = {(uint8_t)(0xB0 | channel), cc, v};
+    d.output(msg, 3);
+}
+
+void expr_dest_init(ExprDest& d, void (*output)(const uint8_t*, size_t), uint32_t baud, expr_res_t res) {
+    d.output = output;
+    d.baud = baud;
+    expr_dest_set_res(d, res);
+}
+
+void expr_dest_set_res(ExprDest& d, expr_res_t res) {
+    d.res = res;
+    for (size_t i = 0 ; i < EXPR_CTL_n ; ++i) d.last[i] = NONE;
+    d.nrpn_sel = ~0u;
+}
+
+expr_res_t expr_dest_res(const ExprDest& d) {
+    if (d.res != EXPR_RES_AUTO) return d.res;
+    return d.baud >= EXPR_AUTO_14BIT_BAUD ? EXPR_RES_14BIT : EXPR_RES_7BIT;
+}
+
+// MSB/LSB pair: only the parts that changed
+static void send_pair(const ExprDest& d, uint8_t channel, uint8_t cc_msb, uint8_t cc_lsb, uint16_t last, uint16_t value) {
+    uint8_t msb = value >> 7, lsb = value & 0x7F;
+    if (last == NONE || msb != (last >> 7)) {
+        send_cc(d, channel, cc_msb, msb);
+        if (lsb) send_cc(d, channel, cc_lsb, lsb);
+    } else if (lsb != (last & 0x7F)) {
+        send_cc(d, channel, cc_lsb, lsb);
+    }
+}
+
+void expr_send(ExprDest& d, uint8_t ctl, const ExprCtl& c, uint8_t channel, uint32_t value32) {
+    if (ctl >= EXPR_CTL_n || !d.output) return;
+    uint16_t value = midi_scale_down(value32, 32, 14);
+    channel &= 0xF;
+    uint16_t last = d.last[ctl];
+
+    switch (expr_dest_res(d)) {
+    case EXPR_RES_7BIT:
+        // change detection on what can actually be sent
+        value &= ~0x7F;
+        if (value == last) return;
+        send_cc(d, channel, c.cc, value >> 7);
+        break;
+    case EXPR_RES_14BIT:
+        if (value == last) return;
+        send_pair(d, channel, c.cc, c.cc + 32, last, value);
+        break;
+    case EXPR_RES_NRPN: {
+        if (value == last) return;
+        uint32_t sel = (c.nrpn & 0x3FFF) | ((uint32_t)channel << 14);
+        if (sel != d.nrpn_sel) {
+            send_cc(d, channel, 99, (c.nrpn >> 7) & 0x7F);
+            send_cc(d, channel, 98, c.nrpn & 0x7F);
+            // the other controllers' data entry state is gone
+            for (size_t i = 0 ; i < EXPR_CTL_n ; ++i) d.last[i] = NONE;
+            d.nrpn_sel = sel;
+            last = NONE;
+        }
+        send_pair(d, channel, 6, 38, last, value);
+        break;
+    }
+    default:
+        return;
+    }
+    d.last[ctl] = value;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "midi_event.hpp"
+
+// continuous controllers (bellows etc.): 32-bit values => MIDI 1.0 messages
+// - resolution per destination: 7-bit CC, 14-bit CC pair (MSB n, LSB n+32)
+//   or NRPN (data entry MSB/LSB); AUTO picks 14-bit CC on fast links and
+//   7-bit CC on DIN speed (31250 baud)
+// - values are scaled down to 14 bits (see midi_event.hpp)
+// - change detection on the full 14-bit value, per destination and
+//   controller; only what changed is sent:
+//   - MSB only when it changed (receivers then reset the LSB to 0, so the
+//     LSB follows only if it is not 0)
+//   - LSB alone when only the LSB changed
+//   - NRPN parameter number only when a different one was selected last
+// NOTE: hardware-independent (host-buildable)
+
+enum expr_res_t : uint8_t {
+    EXPR_RES_AUTO,
+    EXPR_RES_7BIT,
+    EXPR_RES_14BIT,
+    EXPR_RES_NRPN,
+    EXPR_RES_n,
+};
+
+// links slower than this fall back to 7-bit (AUTO)
+static const uint32_t EXPR_AUTO_14BIT_BAUD = 100000;
+
+// number of controllers per destination
+static const size_t EXPR_CTL_n = 2;
+
+struct ExprCtl {
+    uint8_t cc;     // MSB controller number (0..31; LSB: cc + 32)
+    uint16_t nrpn;  // 14-bit parameter number
+};
+
+struct ExprDest {
+    void (*output)(const uint8_t* msg, size_t n);
+    uint32_t baud;
+    expr_res_t res;
+    // last sent (0xFFFF: nothing yet)
+    uint16_t last[EXPR_CTL_n];
+    uint32_t nrpn_sel; // selected parameter (| channel << 14; ~0: none)
+};
+
+void expr_dest_init(ExprDest& d, void (*output)(const uint8_t*, size_t), uint32_t baud, expr_res_t res);
+
+// change resolution (forces a full resend)
+void expr_dest_set_res(ExprDest& d, expr_res_t res);
+
+// effective resolution (AUTO resolved)
+expr_res_t expr_dest_res(const ExprDest& d);
+
+// send controller `ctl` (index into the destination state) if changed
+void expr_send(ExprDest& d, uint8_t ctl, const ExprCtl& c, uint8_t channel, uint32_t value);
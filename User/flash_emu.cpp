@@ -0,0 +1,63 @@
+#include "flash_emu.hpp"
+
+#include <string.h>
+
+
+uint8_t flash_emu_mem[2 * FLASH_STORE_PAGE_n];
+uint32_t flash_emu_erases[2];
+uint32_t flash_emu_programs;
+
+static int32_t flash_emu_ops_left = -1;
+
+// return: false once the power is gone
+static bool flash_emu_op() {
+    if (flash_emu_ops_left < 0) return true;
+    if (flash_emu_ops_left == 0) return false;
+    --flash_emu_ops_left;
+    return true;
+}
+
+static bool flash_emu_erase(uint8_t page) {
+    if (page > 1) return false;
+    uint8_t* p = flash_emu_mem + page * FLASH_STORE_PAGE_n;
+    if (!flash_emu_op()) {
+        // interrupted: partially erased
+        memset(p, 0xFF, FLASH_STORE_PAGE_n / 2);
+        return false;
+    }
+    memset(p, 0xFF, FLASH_STORE_PAGE_n);
+    ++flash_emu_erases[page];
+    return true;
+}
+
+static bool flash_emu_program(uint32_t offset, uint16_t value) {
+    if ((offset & 1) || offset >= sizeof(flash_emu_mem)) return false;
+    uint8_t* p = flash_emu_mem + offset;
+    if (p[0] != 0xFF || p[1] != 0xFF) return false;
+    if (!flash_emu_op()) {
+        // interrupted: some bits made it
+        p[0] &= value;
+        return false;
+    }
+    p[0] = value;
+    p[1] = value >> 8;
+    ++flash_emu_programs;
+    return true;
+}
+
+const FlashStoreDev flash_emu = {
+    flash_emu_mem,
+    flash_emu_erase,
+    flash_emu_program,
+};
+
+void flash_emu_reset() {
+    memset(flash_emu_mem, 0xFF, sizeof(flash_emu_mem));
+    memset(flash_emu_erases, 0, sizeof(flash_emu_erases));
+    flash_emu_programs = 0;
+    flash_emu_ops_left = -1;
+}
+
+void flash_emu_power_cut(int32_t ops) {
+    flash_emu_ops_left = ops;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "flash_store.hpp"
+
+// RAM-backed flash emulator for `flash_store` (host builds)
+// - NOR semantics: erase sets a page to 0xFF; programming a halfword that is
+//   not erased fails (like STM32F1, which refuses it)
+// - power loss: programming/erasing stops working after a given number of
+//   operations (the interrupted operation leaves partial data)
+
+extern uint8_t flash_emu_mem[2 * FLASH_STORE_PAGE_n];
+extern const FlashStoreDev flash_emu;
+
+// erase all; no power loss
+void flash_emu_reset(void);
+
+// fail every operation after `ops` more programs/erases (-1: never)
+void flash_emu_power_cut(int32_t ops);
+
+// statistics
+extern uint32_t flash_emu_erases[2];
+extern uint32_t flash_emu_programs;
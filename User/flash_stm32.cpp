@@ -0,0 +1,34 @@
+#include "flash_stm32.hpp"
+
+#include "stm32f1xx_hal.h"
+
+
+static_assert(FLASH_STORE_PAGE_n == FLASH_PAGE_SIZE, "");
+
+static bool flash_stm32_erase(uint8_t page) {
+    FLASH_EraseInitTypeDef erase;
+    erase.TypeErase = FLASH_TYPEERASE_PAGES;
+    erase.Banks = FLASH_BANK_1;
+    erase.PageAddress = FLASH_STM32_STORE_BASE + page * FLASH_STORE_PAGE_n;
+    erase.NbPages = 1;
+    uint32_t error;
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef ret = HAL_FLASHEx_Erase(&erase, &error);
+    HAL_FLASH_Lock();
+    return ret == HAL_OK;
+}
+
+static bool flash_stm32_program(uint32_t offset, uint16_t value) {
+    uint32_t addr = FLASH_STM32_STORE_BASE + offset;
+    HAL_FLASH_Unlock();
+    HAL_StatusTypeDef ret = HAL_FLASH_Program(FLASH_TYPEPROGRAM_HALFWORD, addr, value);
+    HAL_FLASH_Lock();
+    // verify
+    return ret == HAL_OK && *(volatile uint16_t*)addr == value;
+}
+
+const FlashStoreDev flash_stm32 = {
+    (const uint8_t*)FLASH_STM32_STORE_BASE,
+    flash_stm32_erase,
+    flash_stm32_program,
+};
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "flash_store.hpp"
+
+// `flash_store` backend: last 2 pages of the on-chip flash
+// NOTE: reserved in firmware.sct -- keep FLASH_STM32_STORE_BASE in sync
+
+static const uint32_t FLASH_STM32_STORE_BASE = 0x0801F800;
+
+extern const FlashStoreDev flash_stm32;
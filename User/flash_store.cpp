@@ -0,0 +1,263 @@
+#include "flash_store.hpp"
+
+#include <string.h>
+
+
+////////////////////////////////////////
+// layout
+//
+// page:   | magic (2) | ~magic (2) | seq (4) | record | record | ... | FF..
+// record: | len (2) | ~len (2) | payload (len, padded to even) | crc32 (4) |
+// crc32 covers `len` and the payload
+
+static const uint16_t PAGE_MAGIC = 0x5354; // "ST"
+static const uint32_t PAGE_HEADER_n = 8;
+static const uint32_t RECORD_HEADER_n = 4;
+static const uint32_t RECORD_CRC_n = 4;
+static const uint8_t PAGE_NONE = 0xFF;
+
+static uint32_t record_n(uint16_t len) {
+    return RECORD_HEADER_n + ((len + 1u) & ~1u) + RECORD_CRC_n;
+}
+
+// CRC-32 (IEEE 802.3), 4 bits at a time
+static uint32_t crc32_update(uint32_t crc, const uint8_t* p, size_t n) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+    };
+    crc = ~crc;
+    for (size_t i = 0 ; i < n ; ++i) {
+        crc = table[(crc ^ p[i]) & 0xF] ^ (crc >> 4);
+        crc = table[(crc ^ (p[i] >> 4)) & 0xF] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+static uint32_t record_crc(uint16_t len, const uint8_t* payload) {
+    uint8_t l[2] = {(uint8_t)len, (uint8_t)(len >> 8)};
+    return crc32_update(crc32_update(0, l, 2), payload, len);
+}
+
+// little-endian accessors (flash may be read byte-wise on any host)
+static uint16_t rd16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t rd32(const uint8_t* p) { return rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+static void wr16(uint8_t* p, uint16_t v) { p[0] = v; p[1] = v >> 8; }
+static void wr32(uint8_t* p, uint32_t v) { wr16(p, v); wr16(p + 2, v >> 16); }
+
+
+////////////////////////////////////////
+// state
+
+static const FlashStoreDev* store_dev = nullptr;
+
+static uint8_t store_active = PAGE_NONE;
+static uint32_t store_seq = 0;          // of the active page
+static uint32_t store_wpos = 0;         // next record offset within the active page
+static uint32_t store_latest = 0;       // offset of the latest record (0: none)
+static bool store_spare_blank = false;  // the other page is erased
+
+// record being written
+static uint8_t store_wbuf[RECORD_HEADER_n + FLASH_STORE_DATA_n + RECORD_CRC_n];
+static uint32_t store_wbuf_n = 0;       // 0: nothing to write
+static uint32_t store_wbuf_done = 0;    // bytes programmed so far
+const uint16_t flash_store_ram_n = sizeof(store_wbuf);
+static uint8_t store_wpage = PAGE_NONE; // target page (PAGE_NONE: not placed yet)
+static uint32_t store_woff = 0;         // target offset within the page
+
+volatile uint32_t flash_store_erases = 0;
+volatile uint32_t flash_store_errors = 0;
+
+static const uint8_t* page_ptr(uint8_t page) {
+    return store_dev->mem + page * FLASH_STORE_PAGE_n;
+}
+
+static uint8_t spare_page() {
+    return store_active == PAGE_NONE ? 0 : 1 - store_active;
+}
+
+static bool page_header_valid(uint8_t page, uint32_t& seq) {
+    const uint8_t* p = page_ptr(page);
+    if (rd16(p) != PAGE_MAGIC || rd16(p + 2) != (uint16_t)~PAGE_MAGIC) return false;
+    seq = rd32(p + 4);
+    return true;
+}
+
+static bool page_blank(uint8_t page) {
+    const uint8_t* p = page_ptr(page);
+    for (uint32_t i = 0 ; i < FLASH_STORE_PAGE_n ; ++i) {
+        if (p[i] != 0xFF) return false;
+    }
+    return true;
+}
+
+// walk the records of the active page: find the latest valid one and the end
+static void page_scan() {
+    const uint8_t* p = page_ptr(store_active);
+    uint32_t off = PAGE_HEADER_n;
+    store_latest = 0;
+    while (off + RECORD_HEADER_n <= FLASH_STORE_PAGE_n) {
+        uint16_t len = rd16(p + off);
+        uint16_t len_inv = rd16(p + off + 2);
+        if (len == 0xFFFF && len_inv == 0xFFFF) break; // end of log
+        if (len_inv != (uint16_t)~len || len > FLASH_STORE_DATA_n ||
+                off + record_n(len) > FLASH_STORE_PAGE_n) {
+            // torn header: cannot skip it -- treat the page as full
+            off = FLASH_STORE_PAGE_n;
+            break;
+        }
+        const uint8_t* payload = p + off + RECORD_HEADER_n;
+        uint32_t crc = rd32(payload + ((len + 1u) & ~1u));
+        if (crc == record_crc(len, payload)) store_latest = off;
+        off += record_n(len);
+    }
+    store_wpos = off;
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void flash_store_init(const FlashStoreDev* dev) {
+    store_dev = dev;
+    store_active = PAGE_NONE;
+    store_latest = 0;
+    store_wbuf_n = 0;
+
+    uint32_t seq[2];
+    bool valid[2] = {page_header_valid(0, seq[0]), page_header_valid(1, seq[1])};
+    if (valid[0] && valid[1]) {
+        // NOTE: wrap-around safe
+        store_active = (int32_t)(seq[1] - seq[0]) > 0 ? 1 : 0;
+    } else if (valid[0]) {
+        store_active = 0;
+    } else if (valid[1]) {
+        store_active = 1;
+    }
+
+    if (store_active != PAGE_NONE) {
+        store_seq = seq[store_active];
+        page_scan();
+    } else {
+        store_seq = 0;
+        store_wpos = FLASH_STORE_PAGE_n;
+    }
+    store_spare_blank = page_blank(spare_page());
+}
+
+bool flash_store_read(const uint8_t*& data, size_t& n) {
+    if (store_active == PAGE_NONE || !store_latest) return false;
+    const uint8_t* p = page_ptr(store_active) + store_latest;
+    n = rd16(p);
+    data = p + RECORD_HEADER_n;
+    return true;
+}
+
+bool flash_store_write(const void* data, size_t n) {
+    if (store_wbuf_n || n > FLASH_STORE_DATA_n) return false;
+    uint8_t* w = store_wbuf;
+    wr16(w, n);
+    wr16(w + 2, ~n);
+    memcpy(w + RECORD_HEADER_n, data, n);
+    if (n & 1) w[RECORD_HEADER_n + n] = 0xFF;
+    wr32(w + RECORD_HEADER_n + ((n + 1) & ~1u), record_crc(n, w + RECORD_HEADER_n));
+    store_wbuf_done = 0;
+    store_wpage = PAGE_NONE;
+    store_wbuf_n = record_n(n);
+    return true;
+}
+
+bool flash_store_busy() {
+    return store_wbuf_n != 0;
+}
+
+// pick where the pending record goes
+// return: false if the spare page has to be erased first
+static bool write_place() {
+    if (store_active != PAGE_NONE && store_wpos + store_wbuf_n <= FLASH_STORE_PAGE_n) {
+        store_wpage = store_active;
+        store_woff = store_wpos;
+        return true;
+    }
+    if (!store_spare_blank) return false;
+    store_wpage = spare_page();
+    store_woff = PAGE_HEADER_n;
+    return true;
+}
+
+// programming failed: give up on the target page and start over
+static void write_fail() {
+    ++flash_store_errors;
+    if (store_wpage == store_active) {
+        store_wpos = FLASH_STORE_PAGE_n;
+    } else {
+        store_spare_blank = false;
+    }
+    store_wpage = PAGE_NONE;
+    store_wbuf_done = 0;
+}
+
+// record written to the spare page: make it the active page
+// return: false on failure
+static bool write_commit_page() {
+    uint8_t page = store_wpage;
+    uint32_t base = page * FLASH_STORE_PAGE_n;
+    uint32_t seq = store_seq + 1;
+    // NOTE: magic last -- the header only becomes valid once complete
+    if (!store_dev->program(base + 4, seq) || !store_dev->program(base + 6, seq >> 16) ||
+            !store_dev->program(base + 2, ~PAGE_MAGIC) || !store_dev->program(base, PAGE_MAGIC)) {
+        return false;
+    }
+    store_active = page;
+    store_seq = seq;
+    store_spare_blank = false; // the old page, until erased
+    return true;
+}
+
+void flash_store_poll(bool allow_erase) {
+    if (!store_dev) return;
+
+    if (store_wbuf_n) {
+        if (store_wpage == PAGE_NONE && !write_place()) {
+            // background erase has not happened yet
+            if (!allow_erase) return;
+            ++flash_store_erases;
+            if (!store_dev->erase(spare_page())) {
+                ++flash_store_errors;
+                return;
+            }
+            store_spare_blank = true;
+            return;
+        }
+        uint32_t base = store_wpage * FLASH_STORE_PAGE_n + store_woff;
+        for (uint16_t i = 0 ; i < FLASH_STORE_STEP_n && store_wbuf_done < store_wbuf_n ; ++i) {
+            if (!store_dev->program(base + store_wbuf_done, rd16(store_wbuf + store_wbuf_done))) {
+                write_fail();
+                return;
+            }
+            store_wbuf_done += 2;
+        }
+        if (store_wbuf_done < store_wbuf_n) return;
+
+        if (store_wpage != store_active && !write_commit_page()) {
+            write_fail();
+            return;
+        }
+        store_latest = store_woff;
+        store_wpos = store_woff + store_wbuf_n;
+        store_wbuf_n = 0;
+        return;
+    }
+
+    // background: erase the old page so that the next page switch is quick
+    if (!store_spare_blank && allow_erase) {
+        ++flash_store_erases;
+        if (!store_dev->erase(spare_page())) {
+            ++flash_store_errors;
+            return;
+        }
+        store_spare_blank = true;
+    }
+}
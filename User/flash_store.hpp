@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// log-structured settings store on two flash pages
+// - append-only: every write adds a record (length, payload, CRC-32) to the
+//   active page; the latest record with a valid CRC wins
+// - when the active page is full, the next record starts a fresh page (with a
+//   higher sequence number in its header); the old page is then erased in the
+//   background -- wear is spread over both pages, one erase per page-full
+// - boot: one linear scan of the active page
+// - power loss at any point keeps the previous record (torn records fail
+//   their CRC; a page only becomes active once its header is written)
+// NOTE: hardware-independent -- see flash_stm32.hpp / flash_emu.hpp
+
+static const uint32_t FLASH_STORE_PAGE_n = 1024; // bytes per page
+static const size_t FLASH_STORE_DATA_n = 256;    // max payload per record
+
+// max halfwords programmed per `flash_store_poll`
+// NOTE: ~50us each on STM32F1; any code running from flash stalls meanwhile
+static const uint16_t FLASH_STORE_STEP_n = 8;
+
+// flash device: 2 pages, halfword programming, erased state 0xFF
+struct FlashStoreDev {
+    const uint8_t* mem; // both pages, memory-mapped (page 0 then page 1)
+    // return: false on failure (incl. verify)
+    bool (*erase)(uint8_t page);
+    bool (*program)(uint32_t offset, uint16_t value); // offset from `mem`
+};
+
+// scan the pages and find the latest record
+void flash_store_init(const FlashStoreDev* dev);
+
+// latest record (points into flash)
+// return: false if there is none
+bool flash_store_read(const uint8_t*& data, size_t& n);
+
+// queue a record; written by `flash_store_poll`
+// return: false if too long or a previous write is still in progress
+bool flash_store_write(const void* data, size_t n);
+
+// whether a write is still in progress (see `flash_store_poll`)
+// NOTE: it may have to wait for an erase to be allowed
+bool flash_store_busy(void);
+
+// do a bounded amount of work: program a few halfwords, or erase one page
+// allow_erase: erasing stalls the CPU (for flash code) for ~20-40ms -- only
+// allow it when nothing time-critical is going on
+void flash_store_poll(bool allow_erase);
+
+// statistics
+extern volatile uint32_t flash_store_erases;
+extern volatile uint32_t flash_store_errors;
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t flash_store_ram_n;
@@ -0,0 +1,318 @@
+#include "hostlink.hpp"
+
+#include "stm32f1xx_hal.h"
+
+#include "ramfunc.h"
+
+
+static_assert(HOSTLINK_CH_MIDI == HOSTLINK_INSERT_CHANNEL, "MIDI is inserted into other frames");
+
+hostlink_rx_callback_t hostlink_rx_callback = nullptr;
+hostlink_notify_t hostlink_notify = nullptr;
+
+volatile uint32_t hostlink_preempts = 0;
+volatile uint32_t hostlink_tx_drops = 0;
+volatile uint32_t hostlink_rx_overruns = 0;
+HostlinkDecoder hostlink_rx;
+
+static UART_HandleTypeDef hostlink_uart;
+
+
+////////////////////////////////////////
+// TX queues
+// frames are COBS-encoded straight into a ring buffer per priority; the DMA
+// sends contiguous chunks, MIDI first
+// NOTE: MIDI frames are inserted into a low priority frame cut short (see
+// hostlink_frame.hpp), which then resumes where it stopped => nothing is
+// sent twice, and every frame gets through while MIDI keeps coming
+
+enum tx_prio_t : uint8_t {
+    TX_HI, // MIDI
+    TX_LO, // everything else
+    TX_PRIO_n,
+};
+
+static const uint16_t TX_HI_n = 256;
+static const uint16_t TX_LO_n = 512;
+static_assert((TX_HI_n & (TX_HI_n - 1)) == 0, "");
+static_assert((TX_LO_n & (TX_LO_n - 1)) == 0, "");
+
+static uint8_t tx_hi_buf[TX_HI_n];
+static uint8_t tx_lo_buf[TX_LO_n];
+
+struct TxQueue {
+    uint8_t* buf;
+    uint16_t size;
+    // free-running indices
+    volatile uint16_t head; // next byte to queue (thread)
+    volatile uint16_t tail; // next byte to send (DMA)
+};
+
+static TxQueue tx_q[TX_PRIO_n] = {
+    {tx_hi_buf, TX_HI_n, 0, 0},
+    {tx_lo_buf, TX_LO_n, 0, 0},
+};
+
+static volatile uint8_t tx_active = TX_HI;  // queue of the ongoing transfer
+static volatile uint16_t tx_busy = 0;       // its length (0: idle)
+
+// not generated by CubeMX (USART2 is set up here)
+// NOTE: referenced by DMA1_Channel6/7_IRQHandler
+extern "C" DMA_HandleTypeDef hdma_usart2_tx;
+extern "C" DMA_HandleTypeDef hdma_usart2_rx;
+DMA_HandleTypeDef hdma_usart2_tx;
+DMA_HandleTypeDef hdma_usart2_rx;
+
+// `n` bytes of queue `p` have been sent
+RAMFUNC static void hostlink_sent(uint8_t p, uint16_t n) {
+    tx_q[p].tail = tx_q[p].tail + n;
+}
+
+// low priority frame cut short right before its trailing 01 codes (trailing
+// zero bytes, e.g. a CRC byte 00) and delimiter: the part sent decodes as a
+// valid frame (shorter by these zeros) -- it has to be finished first
+// return: bytes left to send in that case (at most 3), 0 otherwise
+RAMFUNC static uint16_t hostlink_lo_rest() {
+    TxQueue& q = tx_q[TX_LO];
+    uint16_t mask = q.size - 1;
+    if (q.buf[(uint16_t)(q.tail - 1) & mask] == 0) return 0; // not cut short
+    for (uint16_t t = q.tail ; t != q.head ; ++t) {
+        uint8_t b = q.buf[t & mask];
+        if (b == 0) return t + 1 - q.tail;
+        if (b != 1) return 0;
+    }
+    return 0;
+}
+
+// start sending the next contiguous chunk if idle
+// NOTE: must not be interrupted by itself -- call from ISR or with IRQs masked
+RAMFUNC static void hostlink_kick() {
+    if (tx_busy) return;
+    uint16_t rest = tx_q[TX_HI].head != tx_q[TX_HI].tail ? hostlink_lo_rest() : 0;
+    for (uint8_t p = rest ? TX_LO : TX_HI ; p < TX_PRIO_n ; ++p) {
+        TxQueue& q = tx_q[p];
+        uint16_t n = q.head - q.tail;
+        if (!n) continue;
+        if (rest && n > rest) n = rest;
+        uint16_t i = q.tail & (q.size - 1);
+        if (n > q.size - i) n = q.size - i;
+        tx_active = p;
+        tx_busy = n;
+        HAL_DMA_Start_IT(&hdma_usart2_tx, (uint32_t)(q.buf + i), (uint32_t)&hostlink_uart.Instance->DR, n);
+        return;
+    }
+}
+
+// MIDI is waiting: stop a low priority transfer right away
+// - bytes already handed to the UART go out; `hostlink_kick` then sends
+//   MIDI (its leading delimiter cuts the frame short), and the rest of the
+//   frame after it
+// NOTE: IRQs masked
+static void hostlink_preempt() {
+    if (!tx_busy || tx_active != TX_LO) return;
+    ++hostlink_preempts;
+    HAL_DMA_Abort(&hdma_usart2_tx);
+    // a completion that happened meanwhile is accounted for below
+    DMA1->IFCR = DMA_IFCR_CGIF7;
+    HAL_NVIC_ClearPendingIRQ(DMA1_Channel7_IRQn);
+    hostlink_sent(TX_LO, tx_busy - hdma_usart2_tx.Instance->CNDTR);
+    tx_busy = 0;
+}
+
+RAMFUNC static void hostlink_tx_cplt_cb(DMA_HandleTypeDef* hdma) {
+    hostlink_sent(tx_active, tx_busy);
+    tx_busy = 0;
+    hostlink_kick();
+}
+
+
+////////////////////////////////////////
+// RX buffer
+
+// 256 bytes @ 1Mbaud ~ 2.5ms of continuous input
+static const uint16_t RX_n = 256;
+static_assert((RX_n & (RX_n - 1)) == 0, "");
+
+static volatile uint8_t rx_buf[RX_n];
+const uint16_t hostlink_ram_n = sizeof(tx_hi_buf) + sizeof(tx_lo_buf) + sizeof(rx_buf);
+static uint16_t rx_rpos = 0; // next byte to read
+
+// total number of bytes written by DMA, in units of half buffers
+// NOTE: only used to detect overruns
+static volatile uint32_t rx_halves = 0;
+static uint32_t rx_rhalves = 0;
+
+// DMA write position
+static uint16_t hostlink_rx_wpos() {
+    return (RX_n - hdma_usart2_rx.Instance->CNDTR) & (RX_n - 1);
+}
+
+RAMFUNC static void hostlink_rx_notify() {
+    if (hostlink_notify) hostlink_notify();
+}
+
+RAMFUNC static void hostlink_rx_half_cb(DMA_HandleTypeDef* hdma) {
+    rx_halves = rx_halves + 1;
+    hostlink_rx_notify();
+}
+
+RAMFUNC void hostlink_uart_irq() {
+    USART_TypeDef* uart = hostlink_uart.Instance;
+    if ((uart->CR1 & USART_CR1_IDLEIE) && (uart->SR & USART_SR_IDLE)) {
+        // clear IDLE: read SR (above) then DR
+        (void)uart->DR;
+        hostlink_rx_notify();
+    }
+}
+
+
+////////////////////////////////////////
+// setup
+
+static void hostlink_dma_init() {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    hdma_usart2_tx.Instance = DMA1_Channel7;
+    hdma_usart2_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart2_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart2_tx.Init.Priority = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&hdma_usart2_tx);
+    hdma_usart2_tx.XferCpltCallback = hostlink_tx_cplt_cb;
+
+    hdma_usart2_rx.Instance = DMA1_Channel6;
+    hdma_usart2_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart2_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart2_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart2_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart2_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart2_rx.Init.Priority = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&hdma_usart2_rx);
+    hdma_usart2_rx.XferHalfCpltCallback = hostlink_rx_half_cb;
+    hdma_usart2_rx.XferCpltCallback = hostlink_rx_half_cb;
+
+    // same as MIDI (USART3)
+    HAL_NVIC_SetPriority(DMA1_Channel7_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel7_IRQn);
+    HAL_NVIC_SetPriority(DMA1_Channel6_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel6_IRQn);
+}
+
+static void hostlink_uart_init(uint32_t baud) {
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_USART2_CLK_ENABLE();
+
+    GPIO_InitTypeDef gpio;
+    gpio.Pin = GPIO_PIN_2; // TX
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_HIGH;
+    HAL_GPIO_Init(GPIOA, &gpio);
+    gpio.Pin = GPIO_PIN_3; // RX (idle high while nothing is connected)
+    gpio.Mode = GPIO_MODE_INPUT;
+    gpio.Pull = GPIO_PULLUP;
+    HAL_GPIO_Init(GPIOA, &gpio);
+
+    hostlink_uart.Instance = USART2;
+    hostlink_uart.Init.BaudRate = baud;
+    hostlink_uart.Init.WordLength = UART_WORDLENGTH_8B;
+    hostlink_uart.Init.StopBits = UART_STOPBITS_1;
+    hostlink_uart.Init.Parity = UART_PARITY_NONE;
+    hostlink_uart.Init.Mode = UART_MODE_TX_RX;
+    hostlink_uart.Init.HwFlowCtl = UART_HWCONTROL_NONE;
+    hostlink_uart.Init.OverSampling = UART_OVERSAMPLING_16;
+    HAL_UART_Init(&hostlink_uart);
+
+    HAL_NVIC_SetPriority(USART2_IRQn, 6, 0);
+    HAL_NVIC_EnableIRQ(USART2_IRQn);
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void hostlink_init(uint32_t baud) {
+    hostlink_dma_init();
+    hostlink_uart_init(baud);
+    hostlink_retime();
+
+    HAL_DMA_Start_IT(&hdma_usart2_rx, (uint32_t)&hostlink_uart.Instance->DR, (uint32_t)rx_buf, RX_n);
+    // UART issues DMA requests whenever RDR is full / TDR is empty
+    hostlink_uart.Instance->CR3 |= USART_CR3_DMAR | USART_CR3_DMAT;
+    // line idle: one interrupt per burst, not per byte
+    __HAL_UART_CLEAR_IDLEFLAG(&hostlink_uart);
+    hostlink_uart.Instance->CR1 |= USART_CR1_IDLEIE;
+}
+
+void hostlink_retime() {
+    USART_TypeDef* uart = hostlink_uart.Instance;
+    uint32_t baud = hostlink_uart.Init.BaudRate;
+    if (!uart) return; // not initialized
+    uint32_t pclk = HAL_RCC_GetPCLK1Freq();
+    if (pclk < 16 * baud) {
+        // cannot be reached: pause (the DMA resumes with the UART)
+        uart->CR1 &= ~USART_CR1_UE;
+        return;
+    }
+    uart->BRR = UART_BRR_SAMPLING16(pclk, baud);
+    uart->CR1 |= USART_CR1_UE;
+}
+
+bool hostlink_send(hostlink_channel_t ch, const uint8_t* data, size_t n) {
+    if (ch >= HOSTLINK_CH_n || n > HOSTLINK_PAYLOAD_n) return false;
+    uint8_t p = ch == HOSTLINK_CH_MIDI ? TX_HI : TX_LO;
+    // inserted into other frames: short ones only
+    if (p == TX_HI && n > HOSTLINK_INSERT_PAYLOAD_n) return false;
+    TxQueue& q = tx_q[p];
+
+    // leading delimiter (MIDI) + channel/payload/CRC + COBS overhead + delimiter
+    uint16_t lead = p == TX_HI ? 1 : 0;
+    uint16_t need = lead + n + 5;
+    uint16_t head = q.head;
+    if (need > q.size - (uint16_t)(head - q.tail)) {
+        ++hostlink_tx_drops;
+        return false;
+    }
+    // NOTE: the DMA never reads beyond `head` -- no need to keep it out
+    if (lead) q.buf[head & (q.size - 1)] = 0;
+    uint16_t len = lead + hostlink_frame_encode(ch, data, n, q.buf, head + lead, q.size - 1);
+
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    q.head = head + len;
+    if (p == TX_HI) hostlink_preempt();
+    hostlink_kick();
+    __set_PRIMASK(primask);
+    return true;
+}
+
+size_t hostlink_pending() {
+    return (uint16_t)(tx_q[TX_HI].head - tx_q[TX_HI].tail)
+         + (uint16_t)(tx_q[TX_LO].head - tx_q[TX_LO].tail);
+}
+
+void hostlink_poll() {
+    while (1) {
+        // overrun: DMA has lapped the reader -- skip to the oldest valid data
+        uint32_t halves = rx_halves;
+        if (halves - rx_rhalves >= 2) {
+            ++hostlink_rx_overruns;
+            rx_rpos = hostlink_rx_wpos();
+            rx_rhalves = halves;
+            // the frame in progress has lost bytes: wait for the next one
+            hostlink_rx.overflow = true;
+            continue;
+        }
+        if (rx_rpos == hostlink_rx_wpos()) return;
+        uint8_t b = rx_buf[rx_rpos];
+        rx_rpos = (rx_rpos + 1) & (RX_n - 1);
+        if ((rx_rpos & (RX_n / 2 - 1)) == 0) ++rx_rhalves;
+        if (hostlink_rx.feed(b) && hostlink_rx_callback) {
+            hostlink_rx_callback(hostlink_rx.channel, hostlink_rx.payload, hostlink_rx.payload_n);
+        }
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hostlink_frame.hpp"
+
+// host link: binary packet protocol on USART2 (PA2 TX, PA3 RX)
+// - fast (default 1Mbaud, see user_conf.h), 8N1, DMA in both directions: TX on DMA1 channel 7,
+//   RX into a circular buffer on DMA1 channel 6
+// - COBS-framed, CRC-checked frames (see hostlink_frame.hpp), each on one of
+//   a few channels
+// - MIDI frames never wait behind other traffic: they have a queue of their
+//   own, and are inserted into a frame of another channel being sent, which
+//   then resumes where it was cut (see hostlink_frame.hpp) => at most 2 byte
+//   times of added latency, and telemetry, scan and bulk frames still get
+//   through under dense MIDI (nothing is sent twice)
+// - the baud rate needs PCLK1 >= 16x baud: the link pauses (frames stay
+//   queued) while the clock is too slow for it (HSI profile)
+// NOTE: a clock profile switch may corrupt the frame in flight (dropped by
+// the receiver)
+
+enum hostlink_channel_t : uint8_t {
+    HOSTLINK_CH_MIDI,       // MIDI 2.0 Universal MIDI Packets (see ump.hpp)
+    HOSTLINK_CH_TELEMETRY,  // statistics, timestamps
+    HOSTLINK_CH_BULK,       // larger transfers (configuration etc.)
+    HOSTLINK_CH_SCAN,       // raw scan stream (see scope.hpp)
+    HOSTLINK_CH_n,
+};
+
+void hostlink_init(uint32_t baud);
+
+// follow a change of PCLK1 (see clock.cpp)
+void hostlink_retime(void);
+
+// queue a frame
+// return: false if there is not enough room (nothing queued)
+// NOTE: thread context only (single producer)
+bool hostlink_send(hostlink_channel_t ch, const uint8_t* data, size_t n);
+
+// bytes queued but not yet handed to the UART
+size_t hostlink_pending(void);
+
+// received frames: decode and hand to `hostlink_rx_callback`
+// NOTE: thread context
+void hostlink_poll(void);
+
+// complete frame received (called from `hostlink_poll`)
+typedef void (*hostlink_rx_callback_t)(uint8_t ch, const uint8_t* data, size_t n);
+extern hostlink_rx_callback_t hostlink_rx_callback;
+
+// notification: new input is available
+// NOTE: called from ISR
+typedef void (*hostlink_notify_t)(void);
+extern hostlink_notify_t hostlink_notify;
+
+// interrupt handlers
+extern "C" void hostlink_uart_irq(void);
+
+// statistics
+extern volatile uint32_t hostlink_preempts;     // frames MIDI was inserted into
+extern volatile uint32_t hostlink_tx_drops;     // frames not queued (full)
+extern volatile uint32_t hostlink_rx_overruns;  // consumer fell behind
+extern HostlinkDecoder hostlink_rx;             // frames / errors
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t hostlink_ram_n;
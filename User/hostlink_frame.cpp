@@ -0,0 +1,166 @@
+#include "hostlink_frame.hpp"
+
+#include <string.h>
+
+
+// CRC-16/CCITT-FALSE (poly 0x1021, MSB first), 4 bits at a time
+uint16_t hostlink_crc16(const uint8_t* data, size_t n, uint16_t crc) {
+    static const uint16_t table[16] = {
+        0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50A5, 0x60C6, 0x70E7,
+        0x8108, 0x9129, 0xA14A, 0xB16B, 0xC18C, 0xD1AD, 0xE1CE, 0xF1EF,
+    };
+    for (size_t i = 0 ; i < n ; ++i) {
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] >> 4)];
+        crc = (crc << 4) ^ table[(crc >> 12) ^ (data[i] & 0xF)];
+    }
+    return crc;
+}
+
+
+////////////////////////////////////////
+// COBS
+
+// encoder writing into a ring buffer: out[(at + i) & mask]
+struct CobsWriter {
+    uint8_t* out;
+    size_t at, mask;
+    size_t code_i, o;
+    uint8_t code;
+
+    CobsWriter(uint8_t* out, size_t at, size_t mask)
+        : out(out), at(at), mask(mask), code_i(0), o(1), code(1) {}
+
+    void put(uint8_t b) {
+        if (b) {
+            out[(at + o++) & mask] = b;
+            ++code;
+        }
+        if (!b || code == 0xFF) {
+            out[(at + code_i) & mask] = code;
+            code_i = o++;
+            code = 1;
+        }
+    }
+
+    // return: encoded length incl. delimiter
+    size_t finish() {
+        out[(at + code_i) & mask] = code;
+        out[(at + o++) & mask] = 0;
+        return o;
+    }
+};
+
+// output shorter than input (may be the same buffer)
+// return: decoded length, or -1 if malformed
+static int cobs_decode(const uint8_t* in, size_t n, uint8_t* out) {
+    size_t i = 0, o = 0;
+    while (i < n) {
+        uint8_t code = in[i++];
+        if (!code || i + code - 1 > n) return -1;
+        for (uint8_t k = 1 ; k < code ; ++k) out[o++] = in[i++];
+        // a zero follows every block except a full one and the last
+        if (code != 0xFF && i < n) out[o++] = 0;
+    }
+    return o;
+}
+
+
+////////////////////////////////////////
+// frames
+
+size_t hostlink_frame_encode(uint8_t channel, const uint8_t* payload, size_t n, uint8_t* out, size_t at, size_t mask) {
+    if (n > HOSTLINK_PAYLOAD_n) return 0;
+    uint16_t crc = hostlink_crc16(payload, n, hostlink_crc16(&channel, 1));
+    CobsWriter w(out, at, mask);
+    w.put(channel);
+    for (size_t i = 0 ; i < n ; ++i) w.put(payload[i]);
+    w.put(crc >> 8);
+    w.put(crc);
+    return w.finish();
+}
+
+void HostlinkDecoder::reset() {
+    n = 0;
+    held_n = 0;
+    inserted = false;
+    overflow = false;
+    channel = 0;
+    payload = frame + 1;
+    payload_n = 0;
+    frames = 0;
+    errors = 0;
+}
+
+// return: whether `in[0..len)` is a valid frame (see `channel`, `payload`)
+bool HostlinkDecoder::decode(const uint8_t* in, size_t len) {
+    if (len >= HOSTLINK_FRAME_n) return false;
+    int raw_n = cobs_decode(in, len, frame);
+    if (raw_n < 3 || hostlink_crc16(frame, raw_n) != 0) return false;
+    channel = frame[0];
+    payload = frame + 1;
+    payload_n = raw_n - 3;
+    return true;
+}
+
+// the frame held back is not resumed: drop it, keep what follows
+void HostlinkDecoder::drop_held() {
+    ++errors;
+    n -= held_n;
+    memmove(buf, buf + held_n, n);
+    held_n = 0;
+    inserted = false;
+}
+
+bool HostlinkDecoder::feed(uint8_t b) {
+    if (b) {
+        if (n < sizeof(buf)) {
+            buf[n++] = b;
+        } else {
+            overflow = true;
+        }
+        // too long to be inserted: the frame held back was not cut short
+        if (held_n && !inserted && n - held_n >= HOSTLINK_INSERT_n) drop_held();
+        return false;
+    }
+
+    // delimiter
+    if (overflow) {
+        ++errors;
+        n = held_n = 0;
+        inserted = false;
+        overflow = false;
+        return false;
+    }
+    size_t len = n - held_n;
+    if (!len) {
+        // empty frame (resync): never between a cut and its inserted frame
+        if (held_n && !inserted) drop_held();
+        return false;
+    }
+
+    // a frame of its own (possibly inserted into the one held back)
+    if (decode(buf + held_n, len)) {
+        if (held_n) {
+            if (channel == HOSTLINK_INSERT_CHANNEL) {
+                inserted = true;
+            } else {
+                drop_held();
+            }
+        }
+        n = held_n;
+        ++frames;
+        return true;
+    }
+    // the frame held back, resumed after inserted frames
+    if (inserted && decode(buf, n)) {
+        n = held_n = 0;
+        inserted = false;
+        ++frames;
+        return true;
+    }
+    // not (yet) a frame: hold it back -- it may have been cut short
+    if (held_n && !inserted) drop_held();
+    held_n = n;
+    inserted = false;
+    return false;
+}
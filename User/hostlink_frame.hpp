@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// host link framing
+// - frame: | channel (1) | payload | CRC-16 (2, big-endian) |, COBS-encoded,
+//   followed by a 0x00 delimiter
+// - CRC-16/CCITT-FALSE over channel and payload
+// - COBS: an encoded frame contains no 0x00, so a delimiter always marks a
+//   frame boundary; after any error (lost byte, truncated frame) the receiver
+//   resynchronizes on the next one, and empty frames are simply skipped
+// - frames up to HOSTLINK_PAYLOAD_n fit into one COBS block (1 byte overhead)
+// - inserted frames: a short frame on channel HOSTLINK_INSERT_CHANNEL may be
+//   sent in the middle of another one, preceded by a delimiter, after which
+//   the other frame resumes where it was cut: | part | 00 | insert | 00 |
+//   rest | 00 | (more inserted frames may follow the first, each with its
+//   leading delimiter)
+//   - the receiver holds back a frame that does not decode, and resumes it
+//     if an inserted frame follows right away (no empty frame in between)
+//   - a frame held back is dropped (counted as an error) on an empty frame
+//     or any other frame -- a normal frame never follows a cut directly
+//   - never cut right before the trailing 01 codes of a frame: without them,
+//     it still decodes as a valid frame (shorter by its trailing zeros)
+// NOTE: hardware-independent (host-buildable)
+
+static const size_t HOSTLINK_PAYLOAD_n = 240;
+
+// channel + payload + CRC
+static const size_t HOSTLINK_RAW_n = 1 + HOSTLINK_PAYLOAD_n + 2;
+
+// encoded frame incl. delimiter (worst case)
+static const size_t HOSTLINK_FRAME_n = HOSTLINK_RAW_n + 1 + 1;
+
+// inserted frames (see above): channel, longest payload, encoded length incl.
+// delimiter
+static const uint8_t HOSTLINK_INSERT_CHANNEL = 0;
+static const size_t HOSTLINK_INSERT_PAYLOAD_n = 16;
+static const size_t HOSTLINK_INSERT_n = 1 + HOSTLINK_INSERT_PAYLOAD_n + 2 + 1 + 1;
+
+uint16_t hostlink_crc16(const uint8_t* data, size_t n, uint16_t crc = 0xFFFF);
+
+// encode a frame incl. delimiter into `out` (at least HOSTLINK_FRAME_n bytes)
+// ring buffer: written to out[(at + i) & mask] (mask: size - 1)
+// return: encoded length (0: payload too long)
+size_t hostlink_frame_encode(uint8_t channel, const uint8_t* payload, size_t n,
+                             uint8_t* out, size_t at = 0, size_t mask = ~(size_t)0);
+
+// streaming decoder
+struct HostlinkDecoder {
+    // encoded frame being received, after the one held back (if any)
+    uint8_t buf[HOSTLINK_FRAME_n + HOSTLINK_INSERT_n];
+    size_t n;
+    size_t held_n;  // frame held back (may be resumed): buf[0..held_n)
+    bool inserted;  // ... and a frame has been inserted into it
+    bool overflow;  // frame in progress is too long (dropped at the delimiter)
+    uint8_t frame[HOSTLINK_RAW_n]; // decoded
+
+    // last completed frame
+    uint8_t channel;
+    const uint8_t* payload;
+    size_t payload_n;
+
+    // statistics
+    uint32_t frames;
+    uint32_t errors; // bad encoding, bad CRC, too long (counted once dropped)
+
+    HostlinkDecoder() { reset(); }
+    void reset();
+
+    // consume one byte
+    // return: whether a valid frame is complete (see `channel`, `payload`)
+    bool feed(uint8_t b);
+
+    // internal
+    bool decode(const uint8_t* in, size_t len);
+    void drop_held();
+};
@@ -0,0 +1,118 @@
+#include "keymap.hpp"
+
+#include <string.h>
+
+#include "keymat.hpp"
+#include "ramfunc.h"
+
+
+////////////////////////////////////////
+// tables
+// NOTE: not const -- keep them in SRAM, next to the ISR reading them
+
+// default (hardcoded) mapping: Bayan (B-griff)
+static_assert(KEYMAT_ROW_n == 10, "current mapping assumes 10 rows");
+static_assert(KEYMAT_COL_n == 10, "current mapping assumes 10 cols");
+static keymap_t keymap_b = {
+    {34, 40, 46, 52, 58, 64, 70, 76, 82, 88}, // A# E
+    {37, 43, 49, 55, 61, 67, 73, 79, 85, 91}, // C# G
+    {35, 41, 47, 53, 59, 65, 71, 77, 83, 89}, // B  F
+    {38, 44, 50, 56, 62, 68, 74, 80, 86, 92}, // D  G#
+    {33, 39, 45, 51, 57, 63, 69, 75, 81, 87}, // A  D#
+    {36, 42, 48, 54, 60, 66, 72, 78, 84, 90}, // C  F#
+    {34, 40, 46, 52, 58, 64, 70, 76, 82, 88}, // A# E
+    {37, 43, 49, 55, 61, 67, 73, 79, 85, 91}, // C# G
+    {32, 38, 44, 50, 56, 62, 68, 74, 80, 86}, // G# D
+    {35, 41, 47, 53, 59, 65, 71, 77, 83, 89}, // B  F
+};
+
+// C-griff: mirror image of B-griff -- outer and inner rows swap places
+// B-griff rows (by pitch class mod 3): C-row (outer), C#-row, D-row (inner);
+// a key in the C-row sounds 2 semitones higher, in the D-row 2 lower
+static keymap_t keymap_c;
+
+static void keymap_c_init() {
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            uint8_t b = keymap_b[ri][ci];
+            keymap_c[ri][ci] = b + 2 - 2 * (b % 3);
+        }
+    }
+}
+
+
+////////////////////////////////////////
+// layers
+
+struct KeymapLayer {
+    const keymap_t* table;
+    int8_t transpose;
+};
+
+static KeymapLayer keymap_layers[KEYMAP_LAYER_n] = {
+    {&keymap_b, 0},
+    {&keymap_c, 0},
+    {&keymap_b, 0},
+    {&keymap_b, 0},
+};
+
+static const KeymapLayer* volatile keymap_active = &keymap_layers[KEYMAP_B_GRIFF];
+
+// keycode each key was pressed with
+static uint8_t keymap_latched[KEYMAT_ROW_n][KEYMAT_COL_n];
+
+void keymap_init() {
+    keymap_c_init();
+    memset(keymap_latched, KEYMAP_NONE, sizeof(keymap_latched));
+}
+
+const keymap_t& keymap_b_griff() {
+    return keymap_b;
+}
+
+void keymap_set_custom(const keymap_t* custom, int8_t transpose) {
+    keymap_layers[KEYMAP_TRANSPOSED].transpose = transpose;
+    keymap_layers[KEYMAP_CUSTOM].table = custom;
+}
+
+void keymap_select(keymap_layer_t layer) {
+    if (layer >= KEYMAP_LAYER_n) return;
+    keymap_active = &keymap_layers[layer];
+}
+
+keymap_layer_t keymap_layer() {
+    return (keymap_layer_t)(keymap_active - keymap_layers);
+}
+
+// layer switch by key combination
+// return: whether the key has been consumed
+RAMFUNC static bool keymap_combo(uint8_t ri, uint8_t ci) {
+    for (size_t i = 0 ; i < 2 ; ++i) {
+        if (!keymat_state_get(KEYMAP_COMBO_MOD[i][0], KEYMAP_COMBO_MOD[i][1])) return false;
+    }
+    for (size_t layer = 0 ; layer < KEYMAP_LAYER_n ; ++layer) {
+        if (KEYMAP_COMBO_SEL[layer][0] == ri && KEYMAP_COMBO_SEL[layer][1] == ci) {
+            keymap_select((keymap_layer_t)layer);
+            return true;
+        }
+    }
+    return false;
+}
+
+RAMFUNC uint8_t keymap_press(uint8_t ri, uint8_t ci) {
+    uint8_t keycode = KEYMAP_NONE;
+    if (!keymap_combo(ri, ci)) {
+        // NOTE: read the layer pointer once
+        const KeymapLayer* layer = keymap_active;
+        int16_t k = (*layer->table)[ri][ci] + layer->transpose;
+        if (0 <= k && k <= 127) keycode = k;
+    }
+    keymap_latched[ri][ci] = keycode;
+    return keycode;
+}
+
+RAMFUNC uint8_t keymap_release(uint8_t ri, uint8_t ci) {
+    uint8_t keycode = keymap_latched[ri][ci];
+    keymap_latched[ri][ci] = KEYMAP_NONE;
+    return keycode;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "keymat_conf.hpp"
+
+// keymap layers: key (row, col) => keycode (MIDI note number)
+// - the active layer is switched with a single pointer write, so the event
+//   callback (ISR) never sees a half-updated layer
+// - keycodes are latched on press: a key held across a switch is released
+//   with the keycode it was pressed with
+
+typedef uint8_t keymap_t[KEYMAT_ROW_n][KEYMAT_COL_n];
+
+enum keymap_layer_t : uint8_t {
+    KEYMAP_B_GRIFF,     // bayan, B-system (hardcoded)
+    KEYMAP_C_GRIFF,     // C-system: B-griff mirrored
+    KEYMAP_TRANSPOSED,  // B-griff, transposed (see `keymap_set_custom`)
+    KEYMAP_CUSTOM,      // loaded at run time (see `keymap_set_custom`)
+    KEYMAP_LAYER_n,
+};
+
+// no note: key is consumed (e.g. a layer switch combination)
+static const uint8_t KEYMAP_NONE = 0xFF;
+
+// switch by key combination: while both modifier keys are held, pressing the
+// n-th selector key switches to layer n (the selector key produces no note)
+// NOTE: the modifiers themselves still play -- pick keys unlikely to be held
+// together otherwise (here: lowest and highest key)
+static const uint8_t KEYMAP_COMBO_MOD[2][2] = {{8, 0}, {3, 9}}; // {row, col}
+static const uint8_t KEYMAP_COMBO_SEL[KEYMAP_LAYER_n][2] = {{4, 0}, {0, 0}, {2, 0}, {5, 0}};
+
+// build the fixed layers
+void keymap_init(void);
+
+// the hardcoded B-griff layer (e.g. as a template for the custom layer)
+const keymap_t& keymap_b_griff(void);
+
+// parameters of the run-time layers
+// NOTE: ISR context -- call from the field callback (or before scanning);
+// `custom` must stay valid until replaced
+void keymap_set_custom(const keymap_t* custom, int8_t transpose);
+
+// switch layers (any context)
+void keymap_select(keymap_layer_t layer);
+keymap_layer_t keymap_layer(void);
+
+// key events => keycode (KEYMAP_NONE: no note)
+// NOTE: call from the event callback only (ISR)
+uint8_t keymap_press(uint8_t ri, uint8_t ci);
+uint8_t keymap_release(uint8_t ri, uint8_t ci);
@@ -5,8 +5,10 @@
 #include "dma.h"
 #include "tim.h"
 
-#include "bitband.h"
-#include "debouncer.hpp"
+#include "clock.hpp"
+#include "cyccnt.h"
+#include "keymat_debounce.hpp"
+#include "ramfunc.h"
 
 
 ////////////////////////////////////////
@@ -23,7 +25,10 @@ static uint32_t keymat_out_clear; // for clearing all row outputs
 
 // keymat_in: double buffer; stores raw input from DMA (GPIO pin state snapshots)
 // NOTE: 32-bit for DMA transfer; ordered by GPIO pin#, not col#
-static volatile uint32_t keymat_in[2][KEYMAT_ROW_n];
+// NOTE: KEYMAT_SAMPLE_n consecutive snapshots of each row (only the last
+// KEYMAT_VOTE_n are used)
+static volatile uint32_t keymat_in[2][KEYMAT_ROW_n * KEYMAT_SAMPLE_n];
+const uint16_t keymat_ram_n = sizeof(keymat_out) + sizeof(keymat_in);
 
 // populate keymat_out
 static void keymat_out_init() {
@@ -43,37 +48,6 @@ static void keymat_out_init() {
 }
 
 
-////////////////////////////////////////
-// debouncing
-
-#define CEIL_DIV(a, b) (((a) + (b) - 1) / (b))
-static Debouncer<
-    keymat_debounce_counter_t,
-    CEIL_DIV(KEYMAT_BOUNCE_THRES_TRANSIENT_Tus, KEYMAT_FIELD_PERIOD_Tus),
-    CEIL_DIV(KEYMAT_BOUNCE_THRES_STEADY_Tus, KEYMAT_FIELD_PERIOD_Tus)
-    > debouncer[KEYMAT_ROW_n][KEYMAT_COL_n];
-
-// run debouncing algorithm when a full snapshot has been captured
-// half: which half of the double buffer `keymat_in` contains the most recent snapshot
-static void keymat_debounce_field(uint8_t half) {
-    volatile uint32_t* in = keymat_in[half];
-    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
-        uint32_t row = in[ri];
-        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
-            bool input = (row >> KEYMAT_COL_PINS[ci]) & 1;
-            bool changed = debouncer[ri][ci].update(input);
-            if (changed) {
-                bool output = debouncer[ri][ci].output();
-                // atomically write state bit using Cortex-M bit-band alias
-                SBIT_RAM(keymat_state + ri, ci) = output;
-                // callback might not be registered
-                if (keymat_callback) keymat_callback(ri, ci, output);
-            }
-        }
-    }
-}
-
-
 ////////////////////////////////////////
 // peripheral interface
 
@@ -81,15 +55,60 @@ static void keymat_debounce_field(uint8_t half) {
 extern DMA_HandleTypeDef KEYMAT_HDMA_UP;
 extern DMA_HandleTypeDef KEYMAT_HDMA_CC;
 
-// DMA interrupt callbacks: snapshot captured; run debouncing
-static void keymat_half_cb(DMA_HandleTypeDef* hdma) { keymat_debounce_field(0); }
-static void keymat_full_cb(DMA_HandleTypeDef* hdma) { keymat_debounce_field(1); }
-
 // forward decl
 static void keymat_hw_init();
 static void keymat_hw_start();
 static void keymat_hw_stop();
 
+volatile uint32_t keymat_resyncs = 0;
+
+#if USER_KEYMAT_VOTE
+// column reads requested so far (mod `keymat_in`): KEYMAT_SYNC_TIM counts
+// the compare matches of KEYMAT_TIM (TRGO = OC4REF, rising at each match)
+#define KEYMAT_SYNC_TIM TIM3
+static const uint16_t KEYMAT_IN_n = 2 * KEYMAT_ROW_n * KEYMAT_SAMPLE_n;
+
+// whether the column reads done are still in step with those requested
+// NOTE: a read request lost (DMA held off for a whole sample period) would
+// put every later sample into the wrong slot for good
+// NOTE: a request may be pending for a few cycles, or come in between the
+// reads of the counters: look again (a lost one never catches up)
+RAMFUNC static bool keymat_in_sync() {
+    for (uint8_t i = 0 ; i < 32 ; ++i) {
+        uint16_t req = KEYMAT_SYNC_TIM->CNT;
+        uint16_t done = (KEYMAT_IN_n - KEYMAT_HDMA_CC.Instance->CNDTR) % KEYMAT_IN_n;
+        if (req == KEYMAT_SYNC_TIM->CNT && req == done) return true;
+    }
+    return false;
+}
+#endif // USER_KEYMAT_VOTE
+
+// reduce a snapshot to one word per row, then debounce
+// USER_KEYMAT_VOTE: bitwise majority of each row's last 3 samples; out of
+// step (see `keymat_in_sync`): the field is dropped, and scanning restarted
+FORCEINLINE static void keymat_field(const volatile uint32_t* in) {
+#if USER_KEYMAT_VOTE
+    if (!keymat_in_sync()) {
+        ++keymat_resyncs;
+        keymat_hw_start();
+        return;
+    }
+    uint32_t field[KEYMAT_ROW_n];
+    in += KEYMAT_SAMPLE_n - KEYMAT_VOTE_n;
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri, in += KEYMAT_SAMPLE_n) {
+        uint32_t a = in[0], b = in[1], c = in[2];
+        field[ri] = (a & b) | (c & (a | b));
+    }
+    keymat_debounce_field(field);
+#else
+    keymat_debounce_field(in);
+#endif
+}
+
+// DMA interrupt callbacks: snapshot captured; run debouncing
+RAMFUNC static void keymat_half_cb(DMA_HandleTypeDef* hdma) { keymat_field(keymat_in[0]); }
+RAMFUNC static void keymat_full_cb(DMA_HandleTypeDef* hdma) { keymat_field(keymat_in[1]); }
+
 // setup peripherals
 static void keymat_hw_init() {
     // setup DMA using HAL
@@ -97,9 +116,30 @@ static void keymat_hw_init() {
     KEYMAT_HDMA_CC.XferCpltCallback = keymat_full_cb;
 
     // setup TIM directly with registers (easier than using HAL)
-    KEYMAT_TIM->PSC = SystemCoreClock/1000000 - 1; // 1us tick (assuming timer clock freq same as CPU)
-    KEYMAT_TIM->ARR = KEYMAT_ROW_PERIOD_Tus - 1;
-    KEYMAT_TIM->CCR4 = KEYMAT_READ_DELAY_Tus;
+    keymat_retime(clock_tim_freq(KEYMAT_TIM)); // 1us tick
+    KEYMAT_TIM->ARR = KEYMAT_SAMPLE_PERIOD_Tus - 1;
+    KEYMAT_TIM->CCR4 = KEYMAT_SAMPLE_PERIOD_Tus - 1; // last sample: KEYMAT_READ_DELAY_Tus
+    // repetition counter: one update (=> next row) every KEYMAT_SAMPLE_n
+    // periods, one compare match (=> column read) every period
+    // NOTE: the other compare channels' DMA requests share channels with the
+    // UARTs (CH1/CH2: USART3, CH3: USART2 RX)
+    KEYMAT_TIM->RCR = KEYMAT_SAMPLE_n - 1;
+#if USER_KEYMAT_VOTE
+    // a column read every KEYMAT_SAMPLE_PERIOD_Tus (16 cycles at 8MHz after
+    // a STOP wake-up): ahead of every other DMA channel
+    KEYMAT_HDMA_CC.Init.Priority = DMA_PRIORITY_VERY_HIGH;
+    MODIFY_REG(KEYMAT_HDMA_CC.Instance->CCR, DMA_CCR_PL, DMA_PRIORITY_VERY_HIGH);
+    // count the reads requested (see `keymat_in_sync`)
+    // - OC4REF (PWM mode 2): high from the compare match to the period end
+    // - KEYMAT_SYNC_TIM: external clock mode 1 from ITR0 (TIM1), wraps with
+    //   `keymat_in`
+    MODIFY_REG(KEYMAT_TIM->CCMR2, TIM_CCMR2_OC4M, TIM_CCMR2_OC4M_2 | TIM_CCMR2_OC4M_1 | TIM_CCMR2_OC4M_0);
+    MODIFY_REG(KEYMAT_TIM->CR2, TIM_CR2_MMS, TIM_CR2_MMS_2 | TIM_CR2_MMS_1 | TIM_CR2_MMS_0);
+    __HAL_RCC_TIM3_CLK_ENABLE();
+    KEYMAT_SYNC_TIM->ARR = KEYMAT_IN_n - 1;
+    KEYMAT_SYNC_TIM->SMCR = TIM_SMCR_SMS_2 | TIM_SMCR_SMS_1 | TIM_SMCR_SMS_0; // TS = 0: ITR0
+    KEYMAT_SYNC_TIM->CR1 = TIM_CR1_CEN;
+#endif // USER_KEYMAT_VOTE
     KEYMAT_TIM->CCER = TIM_CCER_CC4E; // enable output compare
     KEYMAT_TIM->DIER = TIM_DIER_UDE | TIM_DIER_CC4DE; // enable DMA requests
 }
@@ -110,9 +150,13 @@ static void keymat_hw_start() {
     keymat_hw_stop();
     // start DMA
     HAL_DMA_Start   (&KEYMAT_HDMA_UP, (uint32_t)keymat_out, (uint32_t)&(KEYMAT_ROW_GPIO->BSRR), KEYMAT_ROW_n);
-    HAL_DMA_Start_IT(&KEYMAT_HDMA_CC, (uint32_t)&(KEYMAT_COL_GPIO->IDR),   (uint32_t)keymat_in, KEYMAT_ROW_n*2);
+    HAL_DMA_Start_IT(&KEYMAT_HDMA_CC, (uint32_t)&(KEYMAT_COL_GPIO->IDR),   (uint32_t)keymat_in, KEYMAT_ROW_n*KEYMAT_SAMPLE_n*2);
     // start timer
-    KEYMAT_TIM->EGR = TIM_EGR_UG; // reset counter to 0 and generate initial output DMA transfer
+    KEYMAT_TIM->EGR = TIM_EGR_UG; // reset counter to 0 (and RCR) and generate initial output DMA transfer
+#if USER_KEYMAT_VOTE
+    // NOTE: after UG -- OC4REF is low now (no read requested)
+    KEYMAT_SYNC_TIM->CNT = 0;
+#endif // USER_KEYMAT_VOTE
     KEYMAT_TIM->CR1 |= TIM_CR1_CEN;
 }
 
@@ -129,15 +173,104 @@ static void keymat_hw_stop() {
 
 
 ////////////////////////////////////////
-// public interface
+// low-power idle: wake-up on any key
 
-volatile uint16_t keymat_state[KEYMAT_ROW_n];
+// EXTI lines of all column pins
+static uint32_t keymat_col_mask() {
+    uint32_t mask = 0;
+    for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+        mask |= 1 << KEYMAT_COL_PINS[ci];
+    }
+    return mask;
+}
 
-extern keymat_callback_t keymat_callback = nullptr;
+static IRQn_Type keymat_col_irq(uint8_t pin) {
+    if (pin < 5) return (IRQn_Type)(EXTI0_IRQn + pin);
+    if (pin < 10) return EXTI9_5_IRQn;
+    return EXTI15_10_IRQn;
+}
+
+static void keymat_exti_arm() {
+    // route EXTI lines to the column port
+    uint32_t port = ((uint32_t)KEYMAT_COL_GPIO - (uint32_t)GPIOA) / ((uint32_t)GPIOB - (uint32_t)GPIOA);
+    for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+        uint8_t pin = KEYMAT_COL_PINS[ci];
+        uint32_t shift = 4 * (pin & 3);
+        AFIO->EXTICR[pin >> 2] = (AFIO->EXTICR[pin >> 2] & ~(0xFu << shift)) | (port << shift);
+    }
+    // key press: column pulled up by the (active-high) row
+    uint32_t mask = keymat_col_mask();
+    EXTI->RTSR |= mask;
+    EXTI->FTSR &= ~mask;
+    EXTI->PR = mask;
+    EXTI->IMR |= mask;
+    for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+        IRQn_Type irq = keymat_col_irq(KEYMAT_COL_PINS[ci]);
+        HAL_NVIC_SetPriority(irq, 5, 0);
+        HAL_NVIC_EnableIRQ(irq);
+    }
+}
+
+static void keymat_exti_disarm() {
+    uint32_t mask = keymat_col_mask();
+    EXTI->IMR &= ~mask;
+    EXTI->RTSR &= ~mask;
+    EXTI->PR = mask;
+    for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+        HAL_NVIC_DisableIRQ(keymat_col_irq(KEYMAT_COL_PINS[ci]));
+    }
+}
+
+// EXTI callback (from HAL_GPIO_EXTI_IRQHandler)
+extern "C" void HAL_GPIO_EXTI_Callback(uint16_t pin) {
+    if (!(keymat_col_mask() & pin)) return;
+    // one edge is enough -- bouncing contacts would just keep re-triggering
+    keymat_exti_disarm();
+    keymat_woken = true;
+}
+
+
+////////////////////////////////////////
+// public interface
 
 void keymat_init() {
     keymat_out_init();
+    keymat_debounce_init();
     keymat_hw_init();
 }
 void keymat_start() { keymat_hw_start(); }
 void keymat_stop() { keymat_hw_stop(); }
+
+volatile bool keymat_woken = false;
+
+bool keymat_sleep() {
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        if (keymat_state[ri]) return false;
+    }
+    keymat_hw_stop();
+    keymat_woken = false;
+    // drive all rows at once: any key press now pulls its column high
+    // BSRR[15:0] has priority over [31:16] -- see `keymat_out_init`
+    KEYMAT_ROW_GPIO->BSRR = keymat_out_clear >> 16;
+    // same settling time as during scanning
+    uint32_t t0 = cyccnt();
+    while (cyccnt() - t0 < SystemCoreClock/1000000 * KEYMAT_READ_DELAY_Tus);
+    if (KEYMAT_COL_GPIO->IDR & keymat_col_mask()) {
+        // contact already closed (e.g. still bouncing): would never see an edge
+        keymat_hw_start();
+        return false;
+    }
+    keymat_exti_arm();
+    return true;
+}
+
+void keymat_wake() {
+    keymat_exti_disarm();
+    keymat_debounce_wake();
+    keymat_hw_start();
+}
+
+void keymat_retime(uint32_t tim_freq) {
+    // NOTE: PSC is preloaded -- takes effect at the next update event (row boundary)
+    KEYMAT_TIM->PSC = tim_freq/1000000 - 1;
+}
@@ -13,12 +13,81 @@ static bool keymat_state_get(uint8_t ri, uint8_t ci) {
     return (keymat_state[ri] >> ci) & 1;
 }
 
+// performance counters: CPU cycles spent debouncing one field (incl. callbacks)
+// NOTE: requires DWT cycle counter (see cyccnt.h)
+extern volatile uint32_t keymat_field_cycles_last;
+extern volatile uint32_t keymat_field_cycles_max;
+
+// fields debounced so far, keys changed state in the last one
+extern volatile uint32_t keymat_fields;
+extern volatile uint8_t keymat_field_changes;
+
+// USER_KEYMAT_VOTE: scanning restarted, column reads out of step with the
+// rows (see keymat.cpp)
+extern volatile uint32_t keymat_resyncs;
+
 // event callback: notify that a key has changed state
 // NOTE: called indirectly from ISR
 typedef void (*keymat_callback_t)(uint8_t ri, uint8_t ci, bool state);
 extern keymat_callback_t keymat_callback;
 
+// field callback: a new snapshot has been captured (i.e. the last row has just
+// been sampled); called before any event callback of that field
+// NOTE: called indirectly from ISR
+typedef void (*keymat_field_callback_t)(void);
+extern keymat_field_callback_t keymat_field_callback;
+
+// raw callback: the snapshot just captured, before debouncing (one bit per
+// column, same layout as `keymat_state`); called after the field callback
+// NOTE: called indirectly from ISR; its run time adds to the scan ISR's
+typedef void (*keymat_raw_callback_t)(const uint16_t* rows);
+extern keymat_raw_callback_t keymat_raw_callback;
+
+// change debouncing thresholds (see keymat_conf.hpp; rounded up to whole fields)
+// return: false if out of range (nothing changed)
+// NOTE: call from the field callback (or while stopped) -- the new thresholds
+// then apply to the whole next field; keys keep their current state
+bool keymat_set_debounce(uint32_t transient_Tus, uint32_t steady_Tus);
+
+// adaptive debouncing: each key gets a steady threshold of its own, learned
+// from the bounce seen after each of its edges (see keymat_conf.hpp)
+// - a clean edge lowers it by one field at a time; a longer bounce raises it
+//   at once; a glitch (output back where it was) resets it to the global one
+// - `learned`: steady threshold of each key in fields, row by row (0: not
+//   learned yet => global); nullptr: start over
+// - off: every key uses the global thresholds again
+// NOTE: call like `keymat_set_debounce`
+void keymat_set_adaptive(bool on, const uint8_t* learned);
+
+// copy the learned thresholds (KEYMAT_ROW_n * KEYMAT_COL_n, same layout)
+// NOTE: thread context -- a copy may mix two consecutive fields
+void keymat_get_learned(uint8_t* learned);
+
+// learned thresholds changed so far (to tell when to store a new copy)
+extern volatile uint32_t keymat_adapt_updates;
+
 // actions
 void keymat_init(void);
 void keymat_start(void);
 void keymat_stop(void);
+
+// low-power idle
+// - `keymat_sleep`: stop scanning, drive all rows and arm wake-up (EXTI) on any
+//   column; return false (and keep scanning) if a key is currently held
+// - `keymat_woken`: set from ISR when a key press has been detected while asleep
+// - `keymat_wake`: resume scanning (whether woken by a key or not)
+bool keymat_sleep(void);
+void keymat_wake(void);
+extern volatile bool keymat_woken;
+
+// wake-up latency: number of fields scanned after `keymat_wake` until the first
+// key event (compare with the debouncing transient threshold in fields)
+extern volatile uint16_t keymat_wake_fields_last;
+extern volatile uint16_t keymat_wake_fields_max;
+
+// adapt scan timing to a new timer input clock frequency (Hz)
+// NOTE: glitch-free -- takes effect from the next row on
+void keymat_retime(uint32_t tim_freq);
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t keymat_ram_n;
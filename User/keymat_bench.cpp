@@ -0,0 +1,64 @@
+#include "keymat_bench.hpp"
+
+#include "keymat_debounce.hpp"
+
+
+// BOUNCE: one press/release cycle
+static const uint32_t BOUNCE_PERIOD = 128;
+static const uint32_t BOUNCE_FIELDS = 6;
+
+void keymat_bench_input(keymat_bench_pattern_t pattern, uint32_t i, uint32_t* in) {
+    bool on;
+    switch (pattern) {
+    case KEYMAT_BENCH_CHORD:
+        on = true;
+        break;
+    case KEYMAT_BENCH_BOUNCE: {
+        // press at phase 0, release at half period; contact toggles right after each edge
+        uint32_t phase = i % BOUNCE_PERIOD;
+        uint32_t edge = phase % (BOUNCE_PERIOD / 2);
+        on = phase < BOUNCE_PERIOD / 2;
+        if (edge < BOUNCE_FIELDS && (edge & 1)) on = !on;
+        break;
+    }
+    default:
+        on = false;
+        break;
+    }
+    uint32_t cols = 0;
+    if (on) {
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) cols |= 1 << KEYMAT_COL_PINS[ci];
+    }
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) in[ri] = cols;
+}
+
+void keymat_bench_run(keymat_bench_pattern_t pattern, KeymatBenchResult& result) {
+    keymat_callback_t callback = keymat_callback;
+    keymat_field_callback_t field_callback = keymat_field_callback;
+    keymat_raw_callback_t raw_callback = keymat_raw_callback;
+    keymat_callback = nullptr;
+    keymat_field_callback = nullptr;
+    keymat_raw_callback = nullptr;
+
+    keymat_debounce_init();
+    keymat_set_adaptive(true, nullptr);
+    uint32_t in[KEYMAT_ROW_n];
+    uint64_t sum = 0;
+    uint32_t max = 0;
+    for (uint32_t i = 0 ; i < KEYMAT_BENCH_FIELDS ; ++i) {
+        keymat_bench_input(pattern, i, in);
+        keymat_debounce_field(in);
+        uint32_t dt = keymat_field_cycles_last;
+        sum += dt;
+        if (dt > max) max = dt;
+    }
+    result.cycles_mean = sum / KEYMAT_BENCH_FIELDS;
+    result.cycles_max = max;
+
+    keymat_debounce_init();
+    keymat_field_cycles_last = 0;
+    keymat_field_cycles_max = 0;
+    keymat_callback = callback;
+    keymat_field_callback = field_callback;
+    keymat_raw_callback = raw_callback;
+}
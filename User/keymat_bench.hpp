@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "keymat_conf.hpp"
+
+// debouncing benchmark: synthetic raw input through `keymat_debounce_field`
+// - IDLE: all keys open
+// - CHORD: all keys held (steady state)
+// - BOUNCE: all keys pressed and released together, every edge bouncing for a
+//   few fields => every key changes state in the same field (worst case)
+// NOTE: hardware-independent (host-buildable): cycles come from the DWT cycle
+// counter (0 on the host -- see Tools/debounce_bench.cpp for host timing)
+
+enum keymat_bench_pattern_t : uint8_t {
+    KEYMAT_BENCH_IDLE,
+    KEYMAT_BENCH_CHORD,
+    KEYMAT_BENCH_BOUNCE,
+    KEYMAT_BENCH_n,
+};
+
+// fields per run: long enough for BOUNCE to press and release every key twice
+static const uint32_t KEYMAT_BENCH_FIELDS = 256;
+
+// raw input of field `i` of a pattern (ordered by pin#, as read from GPIO)
+void keymat_bench_input(keymat_bench_pattern_t pattern, uint32_t i, uint32_t* in);
+
+struct KeymatBenchResult {
+    uint32_t cycles_mean; // per field
+    uint32_t cycles_max;
+};
+
+// run a pattern for KEYMAT_BENCH_FIELDS fields, with adaptive thresholds
+// (the costlier mode, see `keymat_set_adaptive`)
+// NOTE: only while not scanning, before the settings are applied: callbacks
+// are detached meanwhile, debouncing (state, thresholds, cycle counters)
+// starts over afterwards
+void keymat_bench_run(keymat_bench_pattern_t pattern, KeymatBenchResult& result);
@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 
+#include "user_conf.h"
+
 
 ////////////////////////////////////////
 // keyboard matrix dimensions
@@ -35,12 +37,39 @@ static const uint8_t KEYMAT_COL_PINS[KEYMAT_COL_n] = {1, 4, 5, 6, 7, 8, 9, 10, 1
 // timing
 
 // raw scanning
-static const uint16_t KEYMAT_ROW_PERIOD_Tus = 20; // duration of a row being active within a scan cycle
-static const uint16_t KEYMAT_READ_DELAY_Tus = 19; // time from writing a row to reading columns in that row
+// NOTE: a row is sampled KEYMAT_SAMPLE_n times, one tick before the end of
+// each sample period (the timer repeats its period that many times per row);
+// only the last KEYMAT_VOTE_n samples count (majority voting, see
+// USER_KEYMAT_VOTE) -- the earlier ones are just what the DMA can't skip
+// NOTE: the settling time after a row switch has not been measured: the
+// last sample stays at 19us as with a single sample, the voted ones at 15,
+// 17, 19us (a majority needs the one at 17us settled)
+#if USER_KEYMAT_VOTE
+static const uint8_t KEYMAT_SAMPLE_n = 10;
+static const uint8_t KEYMAT_VOTE_n = 3;
+static const uint16_t KEYMAT_SAMPLE_PERIOD_Tus = 2; // time between samples of the same row
+#else
+static const uint8_t KEYMAT_SAMPLE_n = 1;
+static const uint8_t KEYMAT_VOTE_n = 1;
+static const uint16_t KEYMAT_SAMPLE_PERIOD_Tus = 20;
+#endif
+// check
+static_assert(KEYMAT_VOTE_n == 1 || KEYMAT_VOTE_n == 3, "majority of 3");
+static_assert(KEYMAT_VOTE_n <= KEYMAT_SAMPLE_n, "");
+static_assert(KEYMAT_SAMPLE_PERIOD_Tus >= 2, "timer period of at least 2 ticks");
 // derived
+static const uint16_t KEYMAT_ROW_PERIOD_Tus = KEYMAT_SAMPLE_PERIOD_Tus * KEYMAT_SAMPLE_n; // duration of a row being active within a scan cycle
+static const uint16_t KEYMAT_READ_DELAY_Tus = KEYMAT_ROW_PERIOD_Tus - 1; // time from writing a row to reading columns in that row (last sample)
 static const uint16_t KEYMAT_FIELD_PERIOD_Tus = KEYMAT_ROW_PERIOD_Tus * KEYMAT_ROW_n; // total time to complete a scan cycle
 
 // debouncing
 static const uint32_t KEYMAT_BOUNCE_THRES_STEADY_Tus = 6000;
 static const uint32_t KEYMAT_BOUNCE_THRES_TRANSIENT_Tus = 600;
 typedef int8_t keymat_debounce_counter_t;
+// longest steady threshold the counter can hold (in fields)
+static const uint32_t KEYMAT_DEBOUNCE_FIELDS_MAX = 127;
+// adaptive debouncing (see keymat.hpp): a key's steady threshold tracks twice
+// its longest recent bounce plus a margin, no lower than this (nor than the
+// transient threshold) and no higher than the global steady threshold
+static const uint32_t KEYMAT_ADAPT_STEADY_MIN_Tus = 1000;
+static const uint32_t KEYMAT_ADAPT_MARGIN_Tus = 600;
@@ -0,0 +1,256 @@
+#include "keymat_debounce.hpp"
+
+#include "cyccnt.h"
+#include "ramfunc.h"
+
+// keep `Debouncer::update` inside the (RAMFUNC) field handler
+#define DEBOUNCER_INLINE FORCEINLINE
+#include "debouncer.hpp"
+
+// atomically write a state bit
+#if defined(__CC_ARM) || defined(__arm__)
+#   include "bitband.h"
+#   define KEYMAT_STATE_WRITE(ri, ci, v) (SBIT_RAM(keymat_state + (ri), (ci)) = (v))
+#else
+// host build: single-threaded
+#   define KEYMAT_STATE_WRITE(ri, ci, v) (keymat_state[ri] = (keymat_state[ri] & ~(1u << (ci))) | ((uint16_t)(v) << (ci)))
+#endif
+
+
+////////////////////////////////////////
+// debouncing
+
+#define CEIL_DIV(a, b) (((a) + (b) - 1) / (b))
+typedef DebouncerVar<keymat_debounce_counter_t> keymat_debouncer_t;
+static keymat_debouncer_t debouncer[KEYMAT_ROW_n][KEYMAT_COL_n];
+static keymat_debouncer_t::Thres keymat_thres;
+
+
+////////////////////////////////////////
+// adaptive thresholds (see `keymat_set_adaptive`)
+
+struct KeyAdapt {
+    uint8_t steady; // steady threshold (fields)
+    // bounce measurement while in transient (states 1 and 3, see `Debouncer`)
+    uint8_t since;  // fields since the edge (saturating)
+    uint8_t bounce; // `since` at the last sample disagreeing with the output
+};
+static KeyAdapt keymat_adapt[KEYMAT_ROW_n][KEYMAT_COL_n];
+static bool keymat_adaptive = false;
+// bounds of a learned threshold (fields), follow the global thresholds
+static uint8_t keymat_adapt_lo, keymat_adapt_hi;
+static const uint8_t KEYMAT_ADAPT_MARGIN = CEIL_DIV(KEYMAT_ADAPT_MARGIN_Tus, KEYMAT_FIELD_PERIOD_Tus);
+
+const uint16_t keymat_debounce_ram_n = sizeof(debouncer) + sizeof(keymat_adapt);
+
+volatile uint32_t keymat_adapt_updates = 0;
+
+FORCEINLINE static keymat_debouncer_t::Thres keymat_key_thres(const KeyAdapt& a) {
+    keymat_debouncer_t::Thres th;
+    th.steady = a.steady;
+    th.transient_abs = a.steady - (keymat_thres.steady - keymat_thres.transient_abs);
+    return th;
+}
+
+static uint8_t keymat_adapt_clamp(uint32_t steady) {
+    if (steady < keymat_adapt_lo) return keymat_adapt_lo;
+    if (steady > keymat_adapt_hi) return keymat_adapt_hi;
+    return steady;
+}
+
+// a transient is over: move the key's threshold
+// - settled: towards twice the bounce plus the margin -- up at once, down by
+//   one field per edge (a single clean edge says little)
+// - glitch: the input changed back for good => the global threshold
+// return: whether it changed
+FORCEINLINE static bool keymat_learn(KeyAdapt& a, bool glitch) {
+    uint32_t target = glitch ? keymat_adapt_hi : keymat_adapt_clamp(2 * a.bounce + KEYMAT_ADAPT_MARGIN);
+    uint8_t steady = a.steady;
+    if (target > steady) {
+        steady = target;
+    } else if (target < steady) {
+        --steady;
+    } else {
+        return false;
+    }
+    a.steady = steady;
+    keymat_adapt_updates = keymat_adapt_updates + 1;
+    return true;
+}
+
+// one key with its own threshold
+// return: whether the output has changed
+FORCEINLINE static bool keymat_key_update_adaptive(keymat_debouncer_t& d, KeyAdapt& a, bool input) {
+    uint8_t before = d.state;
+    bool changed = d.update(input, keymat_key_thres(a));
+    if (d.state & 1) {
+        if (!(before & 1)) {
+            // edge: measure from here
+            a.since = 0;
+            a.bounce = 0;
+        } else {
+            if (a.since < 0xFF) ++a.since;
+            if (input != d.output()) a.bounce = a.since;
+        }
+    } else if (before & 1) {
+        // back to steady state: the output only changes on a glitch
+        if (keymat_learn(a, changed)) d.retune(keymat_key_thres(a));
+    }
+    return changed;
+}
+
+// thresholds changed: every key keeps its output
+static void keymat_retune_all() {
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            KeyAdapt& a = keymat_adapt[ri][ci];
+            a.steady = keymat_adapt_clamp(a.steady);
+            debouncer[ri][ci].retune(keymat_adaptive ? keymat_key_thres(a) : keymat_thres);
+        }
+    }
+}
+
+
+void keymat_debounce_init() {
+    keymat_adaptive = false;
+    keymat_set_debounce(KEYMAT_BOUNCE_THRES_TRANSIENT_Tus, KEYMAT_BOUNCE_THRES_STEADY_Tus);
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        keymat_state[ri] = 0;
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            debouncer[ri][ci].init(false, keymat_thres);
+        }
+    }
+}
+
+// wake-up latency measurement (see `keymat_wake`)
+static bool keymat_wake_pending = false;
+static uint16_t keymat_wake_fields = 0;
+
+void keymat_debounce_wake() {
+    keymat_wake_fields = 0;
+    keymat_wake_pending = true;
+}
+
+// raw snapshot in column order
+RAMFUNC static void keymat_raw_field(const volatile uint32_t* in) {
+    uint16_t rows[KEYMAT_ROW_n];
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        uint32_t row = in[ri];
+        uint16_t bits = 0;
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            bits |= ((row >> KEYMAT_COL_PINS[ci]) & 1) << ci;
+        }
+        rows[ri] = bits;
+    }
+    keymat_raw_callback(rows);
+}
+
+// a key has changed state
+RAMFUNC static void keymat_key_changed(uint8_t ri, uint8_t ci, bool output) {
+    KEYMAT_STATE_WRITE(ri, ci, output);
+    if (keymat_wake_pending) {
+        keymat_wake_pending = false;
+        keymat_wake_fields_last = keymat_wake_fields;
+        if (keymat_wake_fields > keymat_wake_fields_max) {
+            keymat_wake_fields_max = keymat_wake_fields;
+        }
+    }
+    // callback might not be registered
+    if (keymat_callback) keymat_callback(ri, ci, output);
+}
+
+// all keys of a snapshot
+// NOTE: one loop per mode -- the fixed thresholds pay nothing for the other
+// return: number of keys changed
+template <bool ADAPT>
+FORCEINLINE static uint8_t keymat_debounce_keys(const volatile uint32_t* in) {
+    uint8_t changes = 0;
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        uint32_t row = in[ri];
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            bool input = (row >> KEYMAT_COL_PINS[ci]) & 1;
+            keymat_debouncer_t& d = debouncer[ri][ci];
+            bool changed = ADAPT
+                ? keymat_key_update_adaptive(d, keymat_adapt[ri][ci], input)
+                : d.update(input, keymat_thres);
+            if (changed) {
+                ++changes;
+                keymat_key_changed(ri, ci, d.output());
+            }
+        }
+    }
+    return changes;
+}
+
+// run debouncing algorithm when a full snapshot has been captured
+RAMFUNC void keymat_debounce_field(const volatile uint32_t* in) {
+    uint32_t t0 = cyccnt();
+    if (keymat_wake_pending) ++keymat_wake_fields;
+    // callback might not be registered
+    if (keymat_field_callback) keymat_field_callback();
+    if (keymat_raw_callback) keymat_raw_field(in);
+    uint8_t changes = keymat_adaptive ? keymat_debounce_keys<true>(in) : keymat_debounce_keys<false>(in);
+    keymat_field_changes = changes;
+    ++keymat_fields;
+    uint32_t dt = cyccnt() - t0;
+    keymat_field_cycles_last = dt;
+    if (dt > keymat_field_cycles_max) keymat_field_cycles_max = dt;
+}
+
+
+////////////////////////////////////////
+// public interface
+
+volatile uint16_t keymat_state[KEYMAT_ROW_n];
+
+volatile uint32_t keymat_field_cycles_last = 0;
+volatile uint32_t keymat_field_cycles_max = 0;
+
+volatile uint32_t keymat_fields = 0;
+volatile uint8_t keymat_field_changes = 0;
+
+volatile uint16_t keymat_wake_fields_last = 0;
+volatile uint16_t keymat_wake_fields_max = 0;
+
+extern keymat_callback_t keymat_callback = nullptr;
+extern keymat_field_callback_t keymat_field_callback = nullptr;
+extern keymat_raw_callback_t keymat_raw_callback = nullptr;
+
+bool keymat_set_debounce(uint32_t transient_Tus, uint32_t steady_Tus) {
+    uint32_t transient = CEIL_DIV(transient_Tus, KEYMAT_FIELD_PERIOD_Tus);
+    uint32_t steady = CEIL_DIV(steady_Tus, KEYMAT_FIELD_PERIOD_Tus);
+    if (steady > KEYMAT_DEBOUNCE_FIELDS_MAX) return false;
+    keymat_debouncer_t::Thres th;
+    if (!th.set(transient, steady)) return false;
+    keymat_thres = th;
+    // learned thresholds: above the transient one, up to the steady one
+    uint32_t lo = CEIL_DIV(KEYMAT_ADAPT_STEADY_MIN_Tus, KEYMAT_FIELD_PERIOD_Tus);
+    if (lo <= transient) lo = transient + 1;
+    if (lo > steady) lo = steady;
+    keymat_adapt_lo = lo;
+    keymat_adapt_hi = steady;
+    keymat_retune_all();
+    return true;
+}
+
+void keymat_set_adaptive(bool on, const uint8_t* learned) {
+    keymat_adaptive = on;
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            KeyAdapt& a = keymat_adapt[ri][ci];
+            uint8_t steady = learned ? learned[ri * KEYMAT_COL_n + ci] : 0;
+            a.steady = steady ? steady : keymat_adapt_hi;
+            a.since = 0;
+            a.bounce = 0;
+        }
+    }
+    keymat_retune_all();
+}
+
+void keymat_get_learned(uint8_t* learned) {
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            learned[ri * KEYMAT_COL_n + ci] = keymat_adapt[ri][ci].steady;
+        }
+    }
+}
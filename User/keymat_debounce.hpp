@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "keymat.hpp"
+
+// debouncing: one field (full raw snapshot of the matrix) at a time
+// - the part of keymat that does not touch the hardware: fed by the scan DMA
+//   on the instrument (keymat.cpp), by recorded or synthesized captures on the
+//   host (see Tools/keymat_replay.cpp)
+// - owns `keymat_state`, the callbacks and the counters declared in keymat.hpp
+// NOTE: hardware-independent (host-buildable)
+
+// all keys released, thresholds from keymat_conf.hpp
+void keymat_debounce_init(void);
+
+// run debouncing on a full snapshot
+// in: raw GPIO input (IDR) of each row, ordered by pin# (see KEYMAT_COL_PINS)
+void keymat_debounce_field(const volatile uint32_t* in);
+
+// count fields until the next key event (see `keymat_wake_fields_last`)
+void keymat_debounce_wake(void);
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t keymat_debounce_ram_n;
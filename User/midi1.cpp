@@ -0,0 +1,57 @@
+#include "midi1.hpp"
+
+
+static void send3(midi1_output_t output, uint8_t a, uint8_t b, uint8_t c) {
+    uint8_t msg[3] = {a, b, c};
+    output(msg, 3);
+}
+
+static void send2(midi1_output_t output, uint8_t a, uint8_t b) {
+    uint8_t msg[2] = {a, b};
+    output(msg, 2);
+}
+
+size_t midi1_encode(const MidiEvent& e, midi1_output_t output) {
+    uint8_t ch = e.channel & 0xF;
+    uint8_t note = e.note & 0x7F;
+    switch (e.type) {
+    case MIDI_EV_NOTE_OFF:
+        send3(output, 0x80 | ch, note, midi_scale_down(e.velocity, 16, 7));
+        return 1;
+    case MIDI_EV_NOTE_ON: {
+        uint8_t v = midi_scale_down(e.velocity, 16, 7);
+        send3(output, 0x90 | ch, note, v ? v : 1);
+        return 1;
+    }
+    case MIDI_EV_POLY_PRESSURE:
+        send3(output, 0xA0 | ch, note, midi_scale_down(e.value, 32, 7));
+        return 1;
+    case MIDI_EV_CONTROL:
+        send3(output, 0xB0 | ch, e.ctl & 0x7F, midi_scale_down(e.value, 32, 7));
+        return 1;
+    case MIDI_EV_RPN: {
+        uint16_t v = midi_scale_down(e.value, 32, 14);
+        size_t n = 5;
+        send3(output, 0xB0 | ch, 0x65, (e.param >> 7) & 0x7F);
+        send3(output, 0xB0 | ch, 0x64, e.param & 0x7F);
+        send3(output, 0xB0 | ch, 0x06, v >> 7);
+        if (v & 0x7F) {
+            send3(output, 0xB0 | ch, 0x26, v & 0x7F);
+            ++n;
+        }
+        send3(output, 0xB0 | ch, 0x65, 0x7F);
+        send3(output, 0xB0 | ch, 0x64, 0x7F);
+        return n;
+    }
+    case MIDI_EV_CHANNEL_PRESSURE:
+        send2(output, 0xD0 | ch, midi_scale_down(e.value, 32, 7));
+        return 1;
+    case MIDI_EV_PITCH_BEND: {
+        uint16_t v = midi_scale_down(e.value, 32, 14);
+        send3(output, 0xE0 | ch, v & 0x7F, v >> 7);
+        return 1;
+    }
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "midi_event.hpp"
+
+// MIDI 1.0 serialization of events (see midi_event.hpp)
+// - values are scaled down: velocity to 7 bits (note on: at least 1, as 0
+//   would mean note off), pressure and controllers to 7 bits, pitch bend to
+//   14 bits
+// - RPN: parameter number, data entry MSB (LSB only if not 0), RPN null
+// - group and note attributes are dropped
+// NOTE: continuous controllers at 14-bit resolution (CC pairs, NRPN) with
+// change detection: see expr.hpp
+// NOTE: hardware-independent (host-buildable)
+
+// output: one complete message (running status is never used)
+typedef void (*midi1_output_t)(const uint8_t* msg, size_t n);
+
+// return: number of messages sent
+size_t midi1_encode(const MidiEvent& e, midi1_output_t output);
@@ -0,0 +1,34 @@
+#include "midi_event.hpp"
+
+#include <string.h>
+
+
+MidiEvent midi_event(midi_event_type_t type, uint8_t channel) {
+    MidiEvent e;
+    memset(&e, 0, sizeof(e));
+    e.type = type;
+    e.channel = channel & 0xF;
+    return e;
+}
+
+// values up to the center are shifted; values above it have the bits below
+// the sign bit repeated into the low bits, so that max maps onto max
+uint32_t midi_scale_up(uint32_t value, uint8_t src_bits, uint8_t dst_bits) {
+    uint8_t scale_bits = dst_bits - src_bits;
+    uint32_t shifted = value << scale_bits;
+    uint32_t center = 1u << (src_bits - 1);
+    if (value <= center) return shifted;
+
+    uint8_t repeat_bits = src_bits - 1;
+    uint32_t repeat = value & ((1u << repeat_bits) - 1);
+    if (scale_bits > repeat_bits) {
+        repeat <<= scale_bits - repeat_bits;
+    } else {
+        repeat >>= repeat_bits - scale_bits;
+    }
+    while (repeat) {
+        shifted |= repeat;
+        repeat >>= repeat_bits;
+    }
+    return shifted;
+}
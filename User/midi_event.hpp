@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// transport-independent MIDI events
+// - the note pipeline (coupler, MPE, expression) produces each event once,
+//   at MIDI 2.0 resolution; each transport serializes it in its own protocol
+//   (MIDI 1.0 byte stream: see midi1.hpp; Universal MIDI Packet: see ump.hpp)
+// - resolution: velocity and note attribute 16-bit; controllers, pressure and
+//   pitch bend 32-bit (bend: center 0x80000000)
+// - values are scaled between resolutions by the MIDI 2.0 min-center-max
+//   rule, so that min, center and max map onto each other exactly
+// NOTE: hardware-independent (host-buildable)
+
+enum midi_event_type_t : uint8_t {
+    MIDI_EV_NOTE_OFF,
+    MIDI_EV_NOTE_ON,
+    MIDI_EV_POLY_PRESSURE,  // note, value
+    MIDI_EV_CONTROL,        // ctl, value
+    MIDI_EV_RPN,            // param, value
+    MIDI_EV_CHANNEL_PRESSURE,
+    MIDI_EV_PITCH_BEND,
+    MIDI_EV_TYPE_n,
+};
+
+// per-note attribute types (note on/off)
+enum midi_attr_t : uint8_t {
+    MIDI_ATTR_NONE = 0x00,
+    MIDI_ATTR_MANUFACTURER = 0x01,
+    MIDI_ATTR_PROFILE = 0x02,
+    MIDI_ATTR_PITCH_7_9 = 0x03, // pitch in semitones, 7.9 fixed point
+};
+
+struct MidiEvent {
+    midi_event_type_t type;
+    uint8_t group;      // UMP group (0..15; MIDI 1.0: ignored)
+    uint8_t channel;    // 0..15
+    uint8_t note;       // note on/off, poly pressure
+    uint8_t ctl;        // control change: controller number
+    midi_attr_t attr_type;  // note on/off (MIDI 1.0: ignored)
+    uint16_t attr;          // note on/off: attribute data
+    uint16_t velocity;      // note on/off
+    uint16_t param;     // RPN: parameter number (14-bit, MSB << 7 | LSB)
+    uint32_t value;     // poly/channel pressure, control, RPN, pitch bend
+};
+
+static const uint32_t MIDI_BEND_CENTER = 0x80000000u;
+
+// zero-filled event of the given type
+MidiEvent midi_event(midi_event_type_t type, uint8_t channel);
+
+// scale `value` from `src_bits` up to `dst_bits` (min-center-max)
+uint32_t midi_scale_up(uint32_t value, uint8_t src_bits, uint8_t dst_bits);
+
+// scale `value` from `src_bits` down to `dst_bits` (truncating)
+static inline uint32_t midi_scale_down(uint32_t value, uint8_t src_bits, uint8_t dst_bits) {
+    return value >> (src_bits - dst_bits);
+}
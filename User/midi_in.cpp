@@ -0,0 +1,111 @@
+#include "midi_in.hpp"
+
+#include "stm32f1xx_hal.h"
+#include "usart.h"
+
+#include "ramfunc.h"
+
+
+////////////////////////////////////////
+// buffer
+
+// 256 bytes @ 115200 baud ~ 22ms of continuous input
+static const uint16_t MIDI_IN_BUF_n = 256;
+static_assert((MIDI_IN_BUF_n & (MIDI_IN_BUF_n - 1)) == 0, "");
+
+static volatile uint8_t midi_in_buf[MIDI_IN_BUF_n];
+const uint16_t midi_in_ram_n = sizeof(midi_in_buf);
+static uint16_t midi_in_rpos = 0; // next byte to read
+
+// total number of bytes written by DMA, in units of half buffers
+// NOTE: only used to detect overruns
+static volatile uint32_t midi_in_halves = 0;
+static uint32_t midi_in_rhalves = 0;
+
+volatile uint32_t midi_in_overruns = 0;
+
+midi_in_callback_t midi_in_callback = nullptr;
+
+
+////////////////////////////////////////
+// DMA
+
+// not generated by CubeMX (USART3 RX DMA is set up here)
+// NOTE: referenced by DMA1_Channel3_IRQHandler
+extern "C" DMA_HandleTypeDef hdma_usart3_rx;
+DMA_HandleTypeDef hdma_usart3_rx;
+
+// DMA write position
+static uint16_t midi_in_wpos() {
+    return MIDI_IN_BUF_n - hdma_usart3_rx.Instance->CNDTR;
+}
+
+RAMFUNC static void midi_in_notify() {
+    if (midi_in_callback) midi_in_callback();
+}
+
+RAMFUNC static void midi_in_half_cb(DMA_HandleTypeDef* hdma) {
+    midi_in_halves = midi_in_halves + 1;
+    midi_in_notify();
+}
+
+RAMFUNC void midi_in_uart_irq() {
+    USART_TypeDef* uart = huart3.Instance;
+    if ((uart->CR1 & USART_CR1_IDLEIE) && (uart->SR & USART_SR_IDLE)) {
+        // clear IDLE: read SR (above) then DR
+        // NOTE: DMA has already taken the last byte -- nothing is lost
+        (void)uart->DR;
+        midi_in_notify();
+    }
+}
+
+static void midi_in_dma_init() {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    hdma_usart3_rx.Instance = DMA1_Channel3;
+    hdma_usart3_rx.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma_usart3_rx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart3_rx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart3_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart3_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart3_rx.Init.Mode = DMA_CIRCULAR;
+    hdma_usart3_rx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    HAL_DMA_Init(&hdma_usart3_rx);
+    hdma_usart3_rx.XferHalfCpltCallback = midi_in_half_cb;
+    hdma_usart3_rx.XferCpltCallback = midi_in_half_cb;
+
+    HAL_NVIC_SetPriority(DMA1_Channel3_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel3_IRQn);
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void midi_in_init() {
+    midi_in_dma_init();
+    HAL_DMA_Start_IT(&hdma_usart3_rx, (uint32_t)&huart3.Instance->DR, (uint32_t)midi_in_buf, MIDI_IN_BUF_n);
+    huart3.Instance->CR3 |= USART_CR3_DMAR;
+    // line idle: one interrupt per burst, not per byte
+    __HAL_UART_CLEAR_IDLEFLAG(&huart3);
+    huart3.Instance->CR1 |= USART_CR1_IDLEIE;
+}
+
+size_t midi_in_available() {
+    return (uint16_t)(midi_in_wpos() - midi_in_rpos) & (MIDI_IN_BUF_n - 1);
+}
+
+bool midi_in_read(uint8_t& b) {
+    // overrun: DMA has lapped the reader -- skip to the oldest valid data
+    uint32_t halves = midi_in_halves;
+    if (halves - midi_in_rhalves >= 2) {
+        ++midi_in_overruns;
+        midi_in_rpos = midi_in_wpos();
+        midi_in_rhalves = halves;
+        return false;
+    }
+    if (!midi_in_available()) return false;
+    b = midi_in_buf[midi_in_rpos];
+    midi_in_rpos = (midi_in_rpos + 1) & (MIDI_IN_BUF_n - 1);
+    if ((midi_in_rpos & (MIDI_IN_BUF_n / 2 - 1)) == 0) ++midi_in_rhalves;
+    return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MIDI input: USART3 RX into a circular DMA buffer
+// - no interrupt per received byte: the consumer polls the DMA write position
+// - wake-up notification on line idle (end of a burst) and every half buffer
+
+void midi_in_init(void);
+
+// number of received bytes not yet consumed
+size_t midi_in_available(void);
+
+// consume one byte
+// return: false if nothing available
+bool midi_in_read(uint8_t& b);
+
+// notification: new input is available
+// NOTE: called from ISR
+typedef void (*midi_in_callback_t)(void);
+extern midi_in_callback_t midi_in_callback;
+
+// interrupt handlers
+extern "C" void midi_in_uart_irq(void);
+
+// statistics: the consumer fell behind by more than a full buffer
+extern volatile uint32_t midi_in_overruns;
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t midi_in_ram_n;
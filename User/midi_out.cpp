@@ -0,0 +1,105 @@
+#include "midi_out.hpp"
+
+#include "stm32f1xx_hal.h"
+#include "usart.h"
+
+#include "ramfunc.h"
+
+
+////////////////////////////////////////
+// buffer
+
+static const uint16_t MIDI_OUT_BUF_n = 256;
+static_assert((MIDI_OUT_BUF_n & (MIDI_OUT_BUF_n - 1)) == 0, "");
+
+static uint8_t midi_out_buf[MIDI_OUT_BUF_n];
+const uint16_t midi_out_ram_n = sizeof(midi_out_buf);
+// free-running indices
+static volatile uint16_t midi_out_head = 0; // next byte to queue (thread)
+static volatile uint16_t midi_out_tail = 0; // next byte to send (DMA)
+static volatile uint16_t midi_out_busy = 0; // length of the ongoing DMA transfer
+
+
+////////////////////////////////////////
+// DMA
+
+// not generated by CubeMX (USART3 TX DMA is set up here)
+// NOTE: referenced by DMA1_Channel2_IRQHandler
+extern "C" DMA_HandleTypeDef hdma_usart3_tx;
+DMA_HandleTypeDef hdma_usart3_tx;
+
+// start sending the next contiguous chunk if idle
+// NOTE: must not be interrupted by itself -- call from ISR or with IRQs masked
+RAMFUNC static void midi_out_kick() {
+    if (midi_out_busy) return;
+    uint16_t n = midi_out_head - midi_out_tail;
+    if (!n) return;
+    uint16_t i = midi_out_tail & (MIDI_OUT_BUF_n - 1);
+    if (n > MIDI_OUT_BUF_n - i) n = MIDI_OUT_BUF_n - i;
+    midi_out_busy = n;
+    // TC would otherwise still be set from the previous chunk (see `midi_out_flush`)
+    __HAL_UART_CLEAR_FLAG(&huart3, UART_FLAG_TC);
+    HAL_DMA_Start_IT(&hdma_usart3_tx, (uint32_t)(midi_out_buf + i), (uint32_t)&huart3.Instance->DR, n);
+}
+
+RAMFUNC static void midi_out_cplt_cb(DMA_HandleTypeDef* hdma) {
+    midi_out_tail = midi_out_tail + midi_out_busy;
+    midi_out_busy = 0;
+    midi_out_kick();
+}
+
+static void midi_out_dma_init() {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+    hdma_usart3_tx.Instance = DMA1_Channel2;
+    hdma_usart3_tx.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_usart3_tx.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_usart3_tx.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_usart3_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+    hdma_usart3_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    hdma_usart3_tx.Init.Mode = DMA_NORMAL;
+    hdma_usart3_tx.Init.Priority = DMA_PRIORITY_MEDIUM;
+    HAL_DMA_Init(&hdma_usart3_tx);
+    hdma_usart3_tx.XferCpltCallback = midi_out_cplt_cb;
+
+    // below keymat DMA (3, 4), above USART3 (6)
+    HAL_NVIC_SetPriority(DMA1_Channel2_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(DMA1_Channel2_IRQn);
+
+    // UART issues a DMA request whenever TDR is empty
+    huart3.Instance->CR3 |= USART_CR3_DMAT;
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void midi_out_init() {
+    midi_out_dma_init();
+}
+
+bool midi_out_send(const uint8_t* data, size_t n) {
+    // NOTE: messages are short -- simply keep everyone else out while copying
+    bool ok = false;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint16_t head = midi_out_head;
+    if (n <= (size_t)(MIDI_OUT_BUF_n - (uint16_t)(head - midi_out_tail))) {
+        for (size_t i = 0 ; i < n ; ++i) {
+            midi_out_buf[(head + i) & (MIDI_OUT_BUF_n - 1)] = data[i];
+        }
+        midi_out_head = head + n;
+        midi_out_kick();
+        ok = true;
+    }
+    __set_PRIMASK(primask);
+    return ok;
+}
+
+size_t midi_out_pending() {
+    return (uint16_t)(midi_out_head - midi_out_tail);
+}
+
+void midi_out_flush() {
+    while (midi_out_pending());
+    while (!__HAL_UART_GET_FLAG(&huart3, UART_FLAG_TC));
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MIDI output: non-blocking, DMA-driven transmission on USART3
+// - bytes are queued in a ring buffer and sent in contiguous DMA chunks
+// - may be called from any context; a message is queued atomically
+
+void midi_out_init(void);
+
+// queue bytes for transmission
+// return: false if there is not enough room (nothing queued)
+bool midi_out_send(const uint8_t* data, size_t n);
+
+// bytes queued but not yet handed to the UART
+size_t midi_out_pending(void);
+
+// wait until everything queued has left the UART (incl. last stop bit)
+void midi_out_flush(void);
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t midi_out_ram_n;
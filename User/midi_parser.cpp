@@ -0,0 +1,103 @@
+#include "midi_parser.hpp"
+
+
+void MidiParser::reset() {
+    msg_n = 0;
+    msg_len = 0;
+    running = 0;
+    rt = 0;
+    sysex_n = 0;
+    in_sysex = false;
+    sysex_overflow = false;
+}
+
+uint8_t MidiParser::length(uint8_t status) {
+    if (status < 0x80) return 0;
+    if (status < 0xF0) {
+        switch (status & 0xF0) {
+        case 0xC0: // program change
+        case 0xD0: // channel pressure
+            return 2;
+        default:
+            return 3;
+        }
+    }
+    switch (status) {
+    case 0xF1: // MTC quarter frame
+    case 0xF3: // song select
+        return 2;
+    case 0xF2: // song position
+        return 3;
+    case 0xF0: // SysEx: variable
+        return 0;
+    default:   // F4/F5 (undefined), F6 (tune request), F7 (EOX), real-time
+        return 1;
+    }
+}
+
+MidiParser::Result MidiParser::feed(uint8_t b) {
+    // real-time: transparent to everything else
+    if (b >= 0xF8) {
+        rt = b;
+        return REALTIME;
+    }
+
+    if (b & 0x80) {
+        // any status byte terminates SysEx
+        bool was_sysex = in_sysex;
+        in_sysex = false;
+        if (b == 0xF0) {
+            // system common cancels running status
+            running = 0;
+            msg_len = 0;
+            in_sysex = true;
+            sysex[0] = b;
+            sysex_n = 1;
+            sysex_overflow = false;
+            return NONE;
+        }
+        if (b == 0xF7) {
+            if (!was_sysex) return NONE; // stray EOX
+            if (sysex_n < MIDI_SYSEX_n) {
+                sysex[sysex_n++] = b;
+            } else {
+                sysex_overflow = true;
+            }
+            return SYSEX;
+        }
+        // NOTE: a SysEx cut short by another status byte is dropped
+        msg[0] = b;
+        msg_n = 1;
+        msg_len = length(b);
+        running = b < 0xF0 ? b : 0;
+        if (msg_len == 1) {
+            msg_len = 0;
+            return MESSAGE;
+        }
+        return NONE;
+    }
+
+    // data byte
+    if (in_sysex) {
+        if (sysex_n < MIDI_SYSEX_n) {
+            sysex[sysex_n++] = b;
+        } else {
+            sysex_overflow = true;
+        }
+        return NONE;
+    }
+    if (msg_n == 0 || msg_n >= msg_len) {
+        // message already complete: running status?
+        if (!running) return NONE; // orphan data byte
+        msg[0] = running;
+        msg_n = 1;
+        msg_len = length(running);
+    }
+    msg[msg_n++] = b;
+    if (msg_n == msg_len) {
+        // keep msg_len so that a following data byte restarts via running status
+        if (!running) msg_len = 0;
+        return MESSAGE;
+    }
+    return NONE;
+}
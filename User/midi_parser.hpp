@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// streaming MIDI 1.0 byte stream parser
+// - running status
+// - real-time bytes (0xF8-0xFF) anywhere, incl. in the middle of a message
+//   or SysEx; reported on their own without disturbing the message in progress
+// - system exclusive, collected into a bounded buffer
+// NOTE: hardware-independent (host-buildable)
+
+static const size_t MIDI_SYSEX_n = 160; // incl. F0/F7
+
+struct MidiParser {
+    enum Result : uint8_t {
+        NONE,       // nothing complete yet
+        MESSAGE,    // channel voice/mode or system common: `msg[0..msg_n)`
+        REALTIME,   // single real-time byte: `rt`
+        SYSEX,      // system exclusive: `sysex[0..sysex_n)`, F0 ... F7
+    };
+
+    // message being assembled / last completed
+    uint8_t msg[3];
+    uint8_t msg_n;
+    uint8_t msg_len;    // expected length of current message (0: no status)
+    uint8_t running;    // running status (0: none)
+
+    uint8_t rt;
+
+    uint8_t sysex[MIDI_SYSEX_n];
+    size_t sysex_n;
+    bool in_sysex;
+    bool sysex_overflow; // last SysEx was longer than the buffer (truncated)
+
+    MidiParser() { reset(); }
+    void reset();
+
+    // consume one byte
+    Result feed(uint8_t b);
+
+    // total length of a message given its status byte (0: not a status byte
+    // or variable length)
+    static uint8_t length(uint8_t status);
+};
@@ -0,0 +1,61 @@
+#include "midi_thru.hpp"
+
+#include "midi_in.hpp"
+#include "midi_out.hpp"
+#include "midi_parser.hpp"
+
+
+static MidiParser midi_thru_parser;
+
+volatile bool midi_thru_enabled = true;
+midi_thru_sysex_callback_t midi_thru_sysex_callback = nullptr;
+
+// parsed but not yet forwarded (parser output stays valid until fed again)
+static MidiParser::Result midi_thru_held = MidiParser::NONE;
+
+// try to forward the held message
+// return: whether it is gone
+static bool midi_thru_flush() {
+    const MidiParser& p = midi_thru_parser;
+    if (!midi_thru_enabled) {
+        midi_thru_held = MidiParser::NONE;
+        return true;
+    }
+    switch (midi_thru_held) {
+    case MidiParser::MESSAGE:
+        if (midi_out_pending() > MIDI_THRU_BACKLOG_n) return false;
+        if (!midi_out_send(p.msg, p.msg_n)) return false;
+        break;
+    case MidiParser::SYSEX:
+        if (!p.sysex_overflow) {
+            if (midi_out_pending() > MIDI_THRU_BACKLOG_n) return false;
+            if (!midi_out_send(p.sysex, p.sysex_n)) return false;
+        }
+        break;
+    default:
+        break;
+    }
+    midi_thru_held = MidiParser::NONE;
+    return true;
+}
+
+void midi_thru_poll() {
+    uint8_t b;
+    while (midi_thru_flush() && midi_in_read(b)) {
+        MidiParser::Result r = midi_thru_parser.feed(b);
+        if (r == MidiParser::REALTIME) {
+            // timing-critical, and allowed anywhere in the stream
+            if (midi_thru_enabled) while (!midi_out_send(&midi_thru_parser.rt, 1));
+        } else if (r == MidiParser::SYSEX && !midi_thru_parser.sysex_overflow &&
+                midi_thru_sysex_callback &&
+                midi_thru_sysex_callback(midi_thru_parser.sysex, midi_thru_parser.sysex_n)) {
+            // consumed locally
+        } else {
+            midi_thru_held = r;
+        }
+    }
+}
+
+bool midi_thru_pending() {
+    return midi_thru_held != MidiParser::NONE || midi_in_available();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// MIDI thru/merge: forward upstream messages (MIDI input) to the MIDI output,
+// interleaved with local events at message boundaries
+// - local events keep priority: upstream messages are only forwarded while the
+//   output backlog is short, otherwise they wait (unparsed) in the input buffer
+// - real-time bytes are forwarded immediately
+// - SysEx longer than the parser buffer cannot be forwarded and is dropped
+// NOTE: a forwarded SysEx still blocks local events for as long as it takes
+// to transmit -- MIDI 1.0 does not allow interleaving anything but real-time
+
+// max output backlog (bytes) that still allows forwarding upstream messages
+static const unsigned MIDI_THRU_BACKLOG_n = 3;
+
+// forwarding on/off (input is still consumed and SysEx still handled)
+extern volatile bool midi_thru_enabled;
+
+// SysEx hook: complete SysEx messages are offered here before being forwarded
+// return: true if consumed (not forwarded)
+// NOTE: called from `midi_thru_poll`, i.e. thread context
+typedef bool (*midi_thru_sysex_callback_t)(const uint8_t* data, size_t n);
+extern midi_thru_sysex_callback_t midi_thru_sysex_callback;
+
+// forward as much upstream input as the output backlog allows
+// call whenever input is available and after local events have been queued
+void midi_thru_poll(void);
+
+// whether upstream input is still waiting to be forwarded
+bool midi_thru_pending(void);
@@ -0,0 +1,190 @@
+#include "mpe.hpp"
+
+#include <string.h>
+
+
+static const uint8_t NONE = 0xFF;
+static const uint8_t MANAGER = 0;
+
+mpe_output_t mpe_output = nullptr;
+volatile uint32_t mpe_steals = 0;
+
+static uint8_t mpe_members = 0;
+
+
+////////////////////////////////////////
+// channel lists
+// each member channel is in exactly one list: free (head: released longest
+// ago) or busy (head: started longest ago)
+
+struct MpeList {
+    uint8_t head, tail;
+};
+
+static uint8_t mpe_prev[16], mpe_next[16];
+static MpeList mpe_free, mpe_busy;
+static uint16_t mpe_free_mask; // bit per channel (fast membership test)
+
+static void list_init(MpeList& l) {
+    l.head = l.tail = NONE;
+}
+
+static void list_append(MpeList& l, uint8_t ch) {
+    mpe_prev[ch] = l.tail;
+    mpe_next[ch] = NONE;
+    if (l.tail != NONE) mpe_next[l.tail] = ch; else l.head = ch;
+    l.tail = ch;
+}
+
+static void list_remove(MpeList& l, uint8_t ch) {
+    if (mpe_prev[ch] != NONE) mpe_next[mpe_prev[ch]] = mpe_next[ch]; else l.head = mpe_next[ch];
+    if (mpe_next[ch] != NONE) mpe_prev[mpe_next[ch]] = mpe_prev[ch]; else l.tail = mpe_prev[ch];
+}
+
+
+////////////////////////////////////////
+// notes
+
+static uint8_t mpe_note_ch[128];  // member channel of each sounding note
+static uint8_t mpe_ch_note[16];   // note on each busy channel
+static uint8_t mpe_ch_refs[16];   // references to that note
+
+static void send(const MidiEvent& e) {
+    if (mpe_output) mpe_output(e);
+}
+
+static void send_note(midi_event_type_t type, uint8_t ch, uint8_t note, uint16_t velocity) {
+    MidiEvent e = midi_event(type, ch);
+    e.note = note;
+    e.velocity = velocity;
+    send(e);
+}
+
+static void send_value(midi_event_type_t type, uint8_t ch, uint32_t value) {
+    MidiEvent e = midi_event(type, ch);
+    e.value = value;
+    send(e);
+}
+
+static void mpe_release_ch(uint8_t ch) {
+    send_note(MIDI_EV_NOTE_OFF, ch, mpe_ch_note[ch], 0);
+    mpe_note_ch[mpe_ch_note[ch]] = NONE;
+    mpe_ch_note[ch] = NONE;
+    mpe_ch_refs[ch] = 0;
+    list_remove(mpe_busy, ch);
+    list_append(mpe_free, ch);
+    mpe_free_mask |= 1 << ch;
+}
+
+static uint8_t mpe_alloc_ch() {
+    if (!mpe_free_mask) {
+        // steal the oldest note
+        ++mpe_steals;
+        mpe_release_ch(mpe_busy.head);
+    }
+    uint8_t ch = mpe_free.head;
+    list_remove(mpe_free, ch);
+    mpe_free_mask &= ~(1 << ch);
+    list_append(mpe_busy, ch);
+    return ch;
+}
+
+static void mpe_note_on(uint8_t note, uint16_t velocity) {
+    uint8_t ch = mpe_note_ch[note];
+    if (ch != NONE) {
+        // already sounding: share
+        if (mpe_ch_refs[ch] < 0xFF) ++mpe_ch_refs[ch];
+        return;
+    }
+    ch = mpe_alloc_ch();
+    mpe_note_ch[note] = ch;
+    mpe_ch_note[ch] = note;
+    mpe_ch_refs[ch] = 1;
+    // reset expression left over from the previous note on this channel
+    send_value(MIDI_EV_PITCH_BEND, ch, MIDI_BEND_CENTER);
+    send_value(MIDI_EV_CHANNEL_PRESSURE, ch, 0);
+    send_note(MIDI_EV_NOTE_ON, ch, note, velocity);
+}
+
+static void mpe_note_off(uint8_t note) {
+    uint8_t ch = mpe_note_ch[note];
+    if (ch == NONE) return; // stolen
+    if (--mpe_ch_refs[ch]) return;
+    mpe_release_ch(ch);
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void mpe_set_zone(uint8_t members) {
+    if (members > MPE_MEMBER_MAX) members = MPE_MEMBER_MAX;
+    bool announce = members || mpe_members;
+    // stop everything still sounding in the old zone
+    for (uint8_t ch = 1 ; ch <= mpe_members ; ++ch) {
+        if (!(mpe_free_mask & (1 << ch))) mpe_release_ch(ch);
+    }
+
+    mpe_members = members;
+    memset(mpe_note_ch, NONE, sizeof(mpe_note_ch));
+    memset(mpe_ch_note, NONE, sizeof(mpe_ch_note));
+    memset(mpe_ch_refs, 0, sizeof(mpe_ch_refs));
+    list_init(mpe_free);
+    list_init(mpe_busy);
+    mpe_free_mask = 0;
+    for (uint8_t ch = 1 ; ch <= members ; ++ch) {
+        list_append(mpe_free, ch);
+        mpe_free_mask |= 1 << ch;
+    }
+
+    if (!announce) return;
+    // MPE configuration message: RPN 6 on the manager channel
+    // NOTE: member count in the data entry MSB (LSB 0)
+    MidiEvent e = midi_event(MIDI_EV_RPN, MANAGER);
+    e.param = 6;
+    e.value = (uint32_t)members << 25;
+    send(e);
+}
+
+uint8_t mpe_zone() {
+    return mpe_members;
+}
+
+void mpe_event(const MidiEvent& e) {
+    if (!mpe_members) return;
+    switch (e.type) {
+    case MIDI_EV_NOTE_ON:
+        mpe_note_on(e.note & 0x7F, e.velocity);
+        break;
+    case MIDI_EV_NOTE_OFF:
+        mpe_note_off(e.note & 0x7F);
+        break;
+    default: {
+        // zone-wide: manager channel
+        MidiEvent m = e;
+        m.channel = MANAGER;
+        send(m);
+        break;
+    }
+    }
+}
+
+void mpe_bend(uint8_t note, uint32_t bend) {
+    if (!mpe_members || note > 127) return;
+    uint8_t ch = mpe_note_ch[note];
+    if (ch == NONE) return;
+    send_value(MIDI_EV_PITCH_BEND, ch, bend);
+}
+
+void mpe_pressure(uint8_t note, uint32_t pressure) {
+    if (!mpe_members || note > 127) return;
+    uint8_t ch = mpe_note_ch[note];
+    if (ch == NONE) return;
+    send_value(MIDI_EV_CHANNEL_PRESSURE, ch, pressure);
+}
+
+void mpe_pressure_all(uint32_t pressure) {
+    for (uint8_t ch = mpe_busy.head ; ch != NONE ; ch = mpe_next[ch]) {
+        send_value(MIDI_EV_CHANNEL_PRESSURE, ch, pressure);
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "midi_event.hpp"
+
+// MPE (MIDI Polyphonic Expression) output: lower zone
+// - manager channel: 1 (index 0); member channels: 2 .. 1 + members
+// - every sounding note gets a member channel of its own, so pitch bend and
+//   pressure can be sent per note
+// - allocation is O(1): free and busy channels are kept in two intrusive
+//   lists (LRU order); a free channel is the one released longest ago (its
+//   release tail has faded), when none is free the oldest note is stolen
+// - notes are reference-counted: pressing a note that is already sounding
+//   (duplicate button, overlapping ranks) shares its channel, which is only
+//   released with the last reference
+// NOTE: thread context only
+
+static const uint8_t MPE_MEMBER_MAX = 15;
+
+// output: one event
+typedef void (*mpe_output_t)(const MidiEvent& e);
+extern mpe_output_t mpe_output;
+
+// (re)configure the zone (0: MPE off) and announce it (MPE configuration
+// message); notes sounding in the old zone are stopped
+// NOTE: call once at startup (nothing is sent if MPE stays off)
+void mpe_set_zone(uint8_t members);
+uint8_t mpe_zone(void);
+
+// note on/off (channel of the event is ignored); other events go to the
+// manager channel
+// NOTE: only while MPE is on
+void mpe_event(const MidiEvent& e);
+
+// per-note expression (no-op if the note is not sounding)
+// bend: 32-bit (center MIDI_BEND_CENTER); pressure: 32-bit
+void mpe_bend(uint8_t note, uint32_t bend);
+void mpe_pressure(uint8_t note, uint32_t pressure);
+
+// pressure on all sounding notes (e.g. bellows)
+void mpe_pressure_all(uint32_t pressure);
+
+// statistics
+extern volatile uint32_t mpe_steals;
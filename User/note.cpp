@@ -0,0 +1,126 @@
+#include "note.hpp"
+
+#include "user_conf.h"
+#include "coupler.hpp"
+#include "keymap.hpp"
+#include "keymat.hpp"
+#include "mpe.hpp"
+#include "ramfunc.h"
+#include "settings.hpp"
+#include "ump.hpp"
+
+#if USER_SYNTH
+#include "synth.hpp"
+#endif // USER_SYNTH
+
+
+midi1_output_t note_midi1_output = nullptr;
+void (*note_ump_output)(const uint8_t* data, size_t n) = nullptr;
+
+// MIDI channel each key was pressed with
+static uint8_t key_channel[KEYMAT_ROW_n][KEYMAT_COL_n];
+
+// layer selected by the settings last applied
+// NOTE: a layer switched to by key combination stays until this changes
+static uint8_t settings_layer = KEYMAP_LAYER_n;
+
+// adaptive debouncing as last applied (0xFF: not yet)
+// NOTE: the stored thresholds are only loaded when this changes -- the live
+// ones are newer
+static uint8_t settings_adapt = 0xFF;
+
+
+////////////////////////////////////////
+// keys
+
+// NOTE: ISR
+RAMFUNC bool note_key(uint8_t ri, uint8_t ci, bool state, NoteKey& k) {
+    const Settings& s = settings();
+    // NOTE: release with whatever the key was pressed with
+    uint8_t keycode;
+    if (state) {
+        keycode = keymap_press(ri, ci);
+        key_channel[ri][ci] = s.channel;
+    } else {
+        keycode = keymap_release(ri, ci);
+    }
+    if (keycode == KEYMAP_NONE) return false;
+    k.key = ri * KEYMAT_COL_n + ci;
+    k.keycode = keycode;
+    k.channel = key_channel[ri][ci];
+    k.velocity = s.velocity;
+    k.state = state;
+    return true;
+}
+
+void note_key_play(const NoteKey& k) {
+    if (k.state) {
+        coupler_press(k.key, k.keycode, k.channel, midi_scale_up(k.velocity, 7, 16));
+    } else {
+        coupler_release(k.key);
+    }
+}
+
+
+////////////////////////////////////////
+// output
+
+void note_send_ump(const MidiEvent& e) {
+    if (!note_ump_output) return;
+    uint32_t words[UMP_WORD_MAX];
+    uint8_t data[4 * UMP_WORD_MAX];
+    size_t n = ump_encode(e, words);
+    if (n) note_ump_output(data, ump_bytes(words, n, data));
+}
+
+// each event is produced once; every transport serializes it (and the
+// synthesizer plays it)
+void note_send(const MidiEvent& e) {
+    if (note_midi1_output) midi1_encode(e, note_midi1_output);
+    note_send_ump(e);
+#if USER_SYNTH
+    synth_event(e);
+#endif // USER_SYNTH
+}
+
+void note_output(const MidiEvent& e) {
+    if (mpe_zone()) {
+        mpe_event(e);
+    } else {
+        note_send(e);
+    }
+}
+
+
+////////////////////////////////////////
+// settings
+
+// 7-bit velocity setting => 16-bit
+static uint16_t note_velocity(const Settings& s) {
+    return midi_scale_up(s.velocity, 7, 16);
+}
+
+void note_settings_activate() {
+    const Settings& s = settings();
+    keymap_set_custom(&s.mapping, s.transpose);
+    if (s.layer != settings_layer) {
+        settings_layer = s.layer;
+        keymap_select((keymap_layer_t)s.layer);
+    }
+    keymat_set_debounce(s.debounce_transient_Tus, s.debounce_steady_Tus);
+    if (s.debounce_adapt != settings_adapt) {
+        settings_adapt = s.debounce_adapt;
+        keymat_set_adaptive(s.debounce_adapt, &s.debounce_learned[0][0]);
+    }
+}
+
+void note_settings_update() {
+    const Settings& s = settings();
+    if (s.mpe != mpe_zone()) {
+        // held notes move over to the new output path (retriggered)
+        coupler_stop_all();
+        mpe_set_zone(s.mpe);
+        coupler_start_all(note_velocity(s));
+    }
+    coupler_set(s.coupler, note_velocity(s));
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "midi1.hpp"
+#include "midi_event.hpp"
+
+// note output: debounced key changes => keymap => coupler => MPE => MIDI 1.0 /
+// UMP encoders (and the synthesizer, USER_SYNTH)
+// - the same code on the instrument (user_main.cpp) and in the capture replay
+//   (Tools/keymat_replay.cpp): the replay goldens check what is shipped
+// - only the transports differ (see the outputs below)
+// NOTE: hardware-independent (host-buildable); thread context unless noted
+
+// transports: MIDI 1.0 messages, UMP byte stream (see ump.hpp; none: nullptr)
+extern midi1_output_t note_midi1_output;
+extern void (*note_ump_output)(const uint8_t* data, size_t n);
+
+// a key change on its way to the coupler
+struct NoteKey {
+    uint8_t key;        // row * KEYMAT_COL_n + col
+    uint8_t keycode;    // see keymap.hpp
+    uint8_t channel;    // the key was pressed with
+    uint8_t velocity;   // 7-bit, as set when the key changed
+    bool state;
+};
+
+// map a debounced key change with the settings as of now
+// return: false if it plays nothing (e.g. a layer switch)
+// NOTE: called from the key callback (ISR)
+bool note_key(uint8_t ri, uint8_t ci, bool state, NoteKey& k);
+
+// play a mapped key change
+void note_key_play(const NoteKey& k);
+
+// every transport serializes the event (see `mpe_output`)
+void note_send(const MidiEvent& e);
+
+// UMP transport only (e.g. expression at full resolution)
+void note_send_ump(const MidiEvent& e);
+
+// directly or through the MPE channel allocator (see `coupler_output`)
+void note_output(const MidiEvent& e);
+
+// apply key settings (keymap, layer, debouncing) changed since the last field
+// NOTE: from the field callback (or before scanning starts)
+void note_settings_activate(void);
+
+// note output settings changed: re-voice held keys / reconfigure MPE now
+void note_settings_update(void);
@@ -0,0 +1,69 @@
+#include "power.hpp"
+
+#include "stm32f1xx_hal.h"
+
+#include "user_conf.h"
+#include "clock.hpp"
+#include "keymat.hpp"
+#include "midi_out.hpp"
+
+
+// STOP unclocks the USARTs, and their RX pins have no EXTI line to spare
+// (PC11 would collide with column PA11): with UART input, SLEEP only
+#if USER_SLEEP_MODE == 2 && !USER_MIDI_IN && !USER_HOSTLINK
+#define POWER_STOP 1
+#else
+#define POWER_STOP 0
+#endif // USER_SLEEP_MODE
+
+static volatile bool power_woken = false;
+
+void power_wake() {
+    power_woken = true;
+}
+
+bool power_sleep() {
+#if USER_SLEEP_MODE
+    // let the last MIDI byte leave before anything is stopped
+    midi_out_flush();
+
+    // NOTE: cleared before the keyboard is stopped: UART input arriving from
+    // here on ends the sleep right away
+    power_woken = false;
+    if (!keymat_sleep()) return false;
+
+#if POWER_STOP
+    // PWR_CR (LPDS) is not writable with the PWR clock off
+    __HAL_RCC_PWR_CLK_ENABLE();
+#endif // POWER_STOP
+    // no periodic wake-ups from the (RTOS) tick
+    SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+    // NOTE: UART input wakes the core (DMA / IDLE interrupts) and ends the
+    // sleep: it is handled by the caller, as any activity
+    // NOTE: a wake-up between the check and WFI still wakes the core -- IRQs
+    // are masked but pend (the handler runs once they are unmasked)
+    for (;;) {
+        __disable_irq();
+        if (keymat_woken || power_woken) break;
+#if POWER_STOP
+        HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+#else
+        HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+#endif // POWER_STOP
+        __enable_irq();
+    }
+    __enable_irq();
+#if POWER_STOP
+    // back on HSI with the PLL off: resume scanning at that speed right away
+    // and let the PLL relock while the first fields are being scanned
+    clock_stop_exit();
+#endif // POWER_STOP
+    SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+
+    keymat_wake();
+    clock_set_profile(CLOCK_PROFILE_FULL);
+    return true;
+#else
+    return false;
+#endif // USER_SLEEP_MODE
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// low-power idle: stop scanning and halt until any key is pressed
+// - mode (SLEEP/STOP) is selected by USER_SLEEP_MODE; SLEEP only with MIDI
+//   input or the host link (STOP would drop their input)
+// - also ends on `power_wake` (e.g. UART input arrived)
+// - on return, scanning has resumed and the clock is at the FULL profile
+// - the key press that woke us up is reported by the scan as usual
+// return: false if a key is held down (did not sleep)
+// NOTE: call from the thread that transmits (see `clock_set_profile`)
+bool power_sleep(void);
+
+// end `power_sleep` (other than by a key press)
+// NOTE: callable from ISR
+void power_wake(void);
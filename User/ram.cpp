@@ -0,0 +1,123 @@
+#include "ram.hpp"
+
+#include "stm32f1xx_hal.h"
+
+#include "coupler.hpp"
+#include "flash_store.hpp"
+#include "hostlink.hpp"
+#include "keymat.hpp"
+#include "keymat_debounce.hpp"
+#include "midi_in.hpp"
+#include "midi_out.hpp"
+#include "scope.hpp"
+#include "sched.hpp"
+#include "settings.hpp"
+#include "synth.hpp"
+#include "synth_pwm.hpp"
+#include "vtor.hpp"
+
+
+// linker (see firmware.sct)
+extern "C" {
+    extern uint32_t Image$$RW_IRAM1$$Base[];
+    extern uint32_t Image$$RW_IRAM1$$ZI$$Limit[];
+    extern uint32_t Image$$RW_STACK$$ZI$$Base[];
+    extern uint32_t Image$$RW_STACK$$ZI$$Limit[];
+}
+
+static uint32_t* const SRAM_END = (uint32_t*)(SRAM_BASE + 20 * 1024);
+
+// no heap: the link fails if anything pulls in malloc (incl. `new`)
+// - MicroLIB (as in the project): the scatter file asserts that the heap
+//   region is empty (see firmware.sct)
+// - standard library: by requesting the heapless variant of the library
+#if defined(__CC_ARM) && !defined(__MICROLIB)
+#pragma import(__use_no_heap)
+#endif
+
+
+////////////////////////////////////////
+// stacks
+
+static const uint32_t PATTERN = 0xCCCCCCCC; // same as RTX (OS_STKINIT)
+
+// RTX: lowest word of each thread stack (checked by RTX on each switch)
+static const uint32_t RTX_STACK_MAGIC = 0xE25A2EA5;
+
+// left alone below the stack pointer (frame of the painting function itself)
+static const uint32_t PAINT_MARGIN = 64;
+
+struct RamStack {
+    uint32_t* base;
+    uint32_t* top;      // nullptr: unknown
+    uint32_t* painted;  // end of the painted part (nullptr: never painted)
+};
+static RamStack ram_stacks[RAM_STACK_n];
+
+void ram_stack_paint() {
+    // NOTE: an interrupt on the same stack would push its frame into the
+    // part being painted
+    __disable_irq();
+    bool thread = __get_CONTROL() & CONTROL_SPSEL_Msk;
+    uint32_t* end = (uint32_t*)(thread ? __get_PSP() : __get_MSP()) - PAINT_MARGIN / 4;
+    RamStack& s = ram_stacks[thread ? RAM_STACK_THREAD : RAM_STACK_MAIN];
+    if (thread) {
+        uint32_t* p = end;
+        while (p > (uint32_t*)SRAM_BASE && *p != RTX_STACK_MAGIC) --p;
+        if (*p == RTX_STACK_MAGIC) {
+            s.base = p + 1;
+            s.top = nullptr;
+        }
+    } else {
+        s.base = Image$$RW_STACK$$ZI$$Base;
+        s.top = Image$$RW_STACK$$ZI$$Limit;
+    }
+    if (s.base && end > s.base) {
+        for (uint32_t* p = s.base ; p < end ; ++p) *p = PATTERN;
+        s.painted = end;
+    }
+    __enable_irq();
+}
+
+uint32_t ram_stack_size(ram_stack_t s) {
+    const RamStack& st = ram_stacks[s];
+    return st.top ? (st.top - st.base) * 4 : 0;
+}
+
+uint32_t ram_stack_free(ram_stack_t s) {
+    const RamStack& st = ram_stacks[s];
+    if (!st.painted) return 0;
+    const uint32_t* p = st.base;
+    while (p < st.painted && *p == PATTERN) ++p;
+    return (p - st.base) * 4;
+}
+
+
+////////////////////////////////////////
+// static budget
+
+const RamBudget ram_budget[] = {
+    {"keymat DMA", &keymat_ram_n},
+    {"debouncers", &keymat_debounce_ram_n},
+    {"key events", &user_ram_n},
+    {"MIDI in DMA", &midi_in_ram_n},
+    {"MIDI out DMA", &midi_out_ram_n},
+    {"host link DMA", &hostlink_ram_n},
+    {"scope", &scope_ram_n},
+    {"sched queue", &sched_ram_n},
+    {"settings", &settings_ram_n},
+    {"flash store", &flash_store_ram_n},
+    {"coupler", &coupler_ram_n},
+    {"vector table", &vtor_ram_n},
+    {"synth", &synth_ram_n},
+    {"synth output DMA", &synth_pwm_ram_n},
+};
+const uint8_t ram_budget_n = sizeof(ram_budget) / sizeof(ram_budget[0]);
+
+uint32_t ram_data_bytes() {
+    return (Image$$RW_IRAM1$$ZI$$Limit - Image$$RW_IRAM1$$Base) * 4;
+}
+
+uint32_t ram_spare_bytes() {
+    return (SRAM_END - Image$$RW_STACK$$ZI$$Limit) * 4;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// RAM usage (20KB SRAM)
+// - stacks: painted with a pattern early on; the deepest word overwritten
+//   since is the high-water mark
+//   - main stack (MSP): the STACK section of the startup file, placed in a
+//     region of its own (see firmware.sct); ISRs only once the RTOS runs
+//   - main thread (RTOS): allocated by RTX, its lowest word holds RTX's
+//     stack check word (found by searching down from the stack pointer)
+// - static budget: the larger buffers of each module, sizes fixed at
+//   compile time (`<module>_ram_n`, declared in the module's header)
+// - no heap: everything is allocated statically (RTOS objects included);
+//   malloc / `new` are rejected at link time (see ram.cpp, firmware.sct) --
+//   and the startup file's heap is not linked at all
+// NOTE: the RTX idle/timer threads are not covered (see the RTX config)
+
+enum ram_stack_t : uint8_t {
+    RAM_STACK_MAIN,     // MSP
+    RAM_STACK_THREAD,   // main thread (RTOS only)
+    RAM_STACK_n,
+};
+
+// paint the unused part of the stack in use (below the stack pointer)
+// NOTE: call early -- from `user_main`, then again from the main thread
+// once the RTOS runs
+void ram_stack_paint(void);
+
+// size (bytes; 0: unknown)
+uint32_t ram_stack_size(ram_stack_t s);
+
+// least free space so far (bytes; 0: overflowed, or never painted)
+// NOTE: a lower bound (only the painted part counts); scans it -- ~1 cycle
+// per byte
+uint32_t ram_stack_free(ram_stack_t s);
+
+// static budget
+struct RamBudget {
+    const char* name;
+    const uint16_t* bytes;
+};
+extern const RamBudget ram_budget[];
+extern const uint8_t ram_budget_n;
+
+// key events (user_main.cpp): mail queue / ring
+extern const uint16_t user_ram_n;
+
+// whole image (linker): RW + ZI data (excl. the main stack), and what is
+// left of the SRAM after data and main stack
+uint32_t ram_data_bytes(void);
+uint32_t ram_spare_bytes(void);
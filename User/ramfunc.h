@@ -0,0 +1,23 @@
+#pragma once
+
+#include "user_conf.h"
+
+// RAMFUNC: place a function in SRAM
+// - section `.ramfunc` is collected into execution region `RW_IRAM_CODE` (see
+//   MDK-ARM/firmware.sct) and copied from FLASH by scatter-loading before main()
+// - `noinline`: otherwise the body could end up inlined into FLASH code
+// NOTE: SRAM is precious (20KB total) -- only use for small, hot code
+#if USER_RAMFUNC && (defined(__CC_ARM) || (defined(__GNUC__) && defined(__arm__)))
+#   define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+#else
+#   define RAMFUNC
+#endif
+
+// FORCEINLINE: make sure a helper is pulled into its (RAMFUNC) caller
+#if defined(__CC_ARM)
+#   define FORCEINLINE __forceinline
+#elif defined(__GNUC__)
+#   define FORCEINLINE inline __attribute__((always_inline))
+#else
+#   define FORCEINLINE inline
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// compiler barrier: element accesses must not be moved across index updates
+// NOTE: single-core Cortex-M -- no hardware barrier needed between ISR and thread
+#if defined(__CC_ARM)
+#   define RING_BARRIER() __memory_changed()
+#else
+#   define RING_BARRIER() __asm__ __volatile__("" ::: "memory")
+#endif
+
+// single-producer single-consumer lock-free FIFO
+// - producer and consumer may run in different contexts (e.g. ISR => thread)
+//   without locking, as long as each side stays in its own context
+// - indices are free-running; N must be a power of 2
+template <typename T, size_t N>
+struct Ring {
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "N must be a power of 2");
+    static_assert(N <= 0x8000, "");
+
+    T buf[N];
+    volatile uint16_t head; // next slot to write (producer)
+    volatile uint16_t tail; // next slot to read (consumer)
+
+    Ring() : head(0), tail(0) {}
+
+    size_t size() const { return (uint16_t)(head - tail); }
+    bool empty() const { return head == tail; }
+    bool full() const { return size() >= N; }
+
+    // producer side
+    bool push(const T& x) {
+        if (full()) return false;
+        buf[head & (N - 1)] = x;
+        RING_BARRIER();
+        head = head + 1;
+        return true;
+    }
+
+    // consumer side
+    T* peek() {
+        if (empty()) return nullptr;
+        return &buf[tail & (N - 1)];
+    }
+    void drop() {
+        RING_BARRIER();
+        tail = tail + 1;
+    }
+    bool pop(T& x) {
+        T* p = peek();
+        if (!p) return false;
+        x = *p;
+        drop();
+        return true;
+    }
+};
@@ -0,0 +1,113 @@
+#include "sched.hpp"
+
+#include <string.h>
+
+#include "stm32f1xx_hal.h"
+#include "usart.h"
+
+#include "clock.hpp"
+#include "midi_out.hpp"
+#include "ramfunc.h"
+#include "ring.hpp"
+
+
+////////////////////////////////////////
+// hardware resources
+
+#define SCHED_TIM TIM2
+#define SCHED_TIM_IRQn TIM2_IRQn
+
+
+////////////////////////////////////////
+// queue
+
+struct SchedMsg {
+    uint16_t t;
+    uint8_t n;
+    uint8_t data[SCHED_MSG_n];
+};
+static Ring<SchedMsg, 32> sched_queue;
+const uint16_t sched_ram_n = sizeof(sched_queue);
+
+volatile uint32_t sched_hist[SCHED_HIST_n];
+volatile uint16_t sched_error_Tus_max = 0;
+
+// time for one byte to leave the UART (us)
+static uint16_t sched_byte_Tus() {
+    return (10 * 1000000 + huart3.Init.BaudRate - 1) / huart3.Init.BaudRate;
+}
+
+// make the compare interrupt fire for the message at the head of the queue
+// NOTE: call from ISR or with IRQs masked
+RAMFUNC static void sched_arm() {
+    SchedMsg* m = sched_queue.peek();
+    if (!m) {
+        SCHED_TIM->DIER &= ~TIM_DIER_CC1IE;
+        return;
+    }
+    SCHED_TIM->CCR1 = m->t;
+    SCHED_TIM->DIER |= TIM_DIER_CC1IE;
+    // already due: compare would only match after wrapping around
+    if ((int16_t)(m->t - SCHED_TIM->CNT) <= 0) SCHED_TIM->EGR = TIM_EGR_CC1G;
+}
+
+RAMFUNC void sched_irq() {
+    SCHED_TIM->SR = ~TIM_SR_CC1IF;
+    SchedMsg* m;
+    while ((m = sched_queue.peek()) && (int16_t)(m->t - SCHED_TIM->CNT) <= 0) {
+        // error as seen on the wire: late release + bytes still queued ahead
+        uint16_t err = (uint16_t)(SCHED_TIM->CNT - m->t) + midi_out_pending() * sched_byte_Tus();
+        size_t bin = err / SCHED_HIST_BIN_Tus;
+        if (bin >= SCHED_HIST_n) bin = SCHED_HIST_n - 1;
+        ++sched_hist[bin];
+        if (err > sched_error_Tus_max) sched_error_Tus_max = err;
+
+        midi_out_send(m->data, m->n);
+        sched_queue.drop();
+    }
+    sched_arm();
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void sched_init() {
+    __HAL_RCC_TIM2_CLK_ENABLE();
+    SCHED_TIM->ARR = 0xFFFF;
+    SCHED_TIM->CCMR1 = 0; // CC1: output compare, frozen (interrupt only)
+    sched_retime(clock_tim_freq(SCHED_TIM));
+    SCHED_TIM->SR = 0;
+    SCHED_TIM->CR1 |= TIM_CR1_CEN;
+
+    // same as USART3: output only needs to be on time, not urgent
+    HAL_NVIC_SetPriority(SCHED_TIM_IRQn, 5, 0);
+    HAL_NVIC_EnableIRQ(SCHED_TIM_IRQn);
+}
+
+void sched_retime(uint32_t tim_freq) {
+    // PSC is preloaded: force an update event to load it right away, which
+    // also clears the counter -- restore it (off by at most 1 tick)
+    uint16_t cnt = SCHED_TIM->CNT;
+    SCHED_TIM->PSC = tim_freq/1000000 - 1;
+    SCHED_TIM->EGR = TIM_EGR_UG;
+    SCHED_TIM->CNT = cnt;
+}
+
+uint16_t sched_now() {
+    return SCHED_TIM->CNT;
+}
+
+bool sched_send(uint16_t t, const uint8_t* data, size_t n) {
+    if (n > SCHED_MSG_n) return false;
+    SchedMsg m;
+    m.t = t;
+    m.n = n;
+    memcpy(m.data, data, n);
+    if (!sched_queue.push(m)) return false;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sched_arm();
+    __set_PRIMASK(primask);
+    return true;
+}
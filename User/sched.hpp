@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// fixed-latency output scheduling
+// - free-running 1us timebase (16-bit, wraps every 65.536ms)
+// - each message is released to the MIDI output at a given time by a timer
+//   compare interrupt; given detection time + constant delay, output timing
+//   no longer depends on processing/UART backlog or scan row position
+
+// histogram of release timing error (wire time - target time)
+static const size_t SCHED_HIST_n = 16;
+static const uint16_t SCHED_HIST_BIN_Tus = 20; // last bin collects everything above
+
+// max message length (channel voice messages)
+static const size_t SCHED_MSG_n = 3;
+
+void sched_init(void);
+
+// adapt to a new timer input clock frequency (Hz)
+void sched_retime(uint32_t tim_freq);
+
+// current time (us)
+uint16_t sched_now(void);
+
+// queue a message for release at time `t`
+// NOTE: release times must be non-decreasing (FIFO), and less than 32ms ahead
+// return: false if the queue is full
+bool sched_send(uint16_t t, const uint8_t* data, size_t n);
+
+// timer interrupt handler
+extern "C" void sched_irq(void);
+
+// statistics
+extern volatile uint32_t sched_hist[SCHED_HIST_n];
+extern volatile uint16_t sched_error_Tus_max;
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t sched_ram_n;
@@ -0,0 +1,107 @@
+#include "scope.hpp"
+
+#include "hostlink.hpp"
+#include "keymat.hpp"
+#include "ramfunc.h"
+#include "ring.hpp"
+#include "scope_codec.hpp"
+
+
+scope_notify_t scope_notify = nullptr;
+volatile uint32_t scope_lost = 0;
+
+static const size_t SCOPE_PACKET_n = HOSTLINK_PAYLOAD_n;
+static_assert(SCOPE_PACKET_n >= SCOPE_HEADER_n + SCOPE_RECORD_MAX + SCOPE_TAIL_n, "");
+
+// packet buffers, filled and sent strictly in turn
+static const uint8_t BUF_n = 2;
+static uint8_t scope_buf[BUF_n][SCOPE_PACKET_n];
+static volatile uint16_t scope_len[BUF_n]; // ready to send (0: free)
+
+// ISR side
+static ScopeEncoder scope_enc;
+const uint16_t scope_ram_n = sizeof(scope_buf) + sizeof(scope_enc);
+static int8_t scope_cur = -1;  // being filled (-1: none)
+static uint8_t scope_fill = 0; // next to fill
+// thread side
+static uint8_t scope_send = 0; // next to send
+
+static bool scope_on = false;
+
+// NOTE: ISR
+RAMFUNC static bool scope_open() {
+    if (scope_len[scope_fill]) return false; // not sent yet
+    scope_cur = scope_fill;
+    scope_fill = (scope_fill + 1) % BUF_n;
+    scope_enc.open(scope_buf[scope_cur], SCOPE_PACKET_n);
+    return true;
+}
+
+// NOTE: ISR (or thread with the raw callback off)
+RAMFUNC static void scope_ready() {
+    uint16_t n = scope_enc.close();
+    RING_BARRIER();
+    scope_len[scope_cur] = n;
+    scope_cur = -1;
+    if (scope_notify) scope_notify();
+}
+
+// raw field hook
+// NOTE: ISR
+RAMFUNC static void scope_field(const uint16_t* rows) {
+    if (scope_cur < 0 && !scope_open()) {
+        scope_enc.drop(rows);
+        ++scope_lost;
+        return;
+    }
+    if (!scope_enc.add(rows)) {
+        scope_ready();
+        if (!scope_open()) {
+            scope_enc.drop(rows);
+            ++scope_lost;
+            return;
+        }
+        // NOTE: always fits into an empty packet
+        scope_enc.add(rows);
+    }
+    if (scope_enc.fields() >= SCOPE_FLUSH_FIELDS) scope_ready();
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void scope_start() {
+    scope_stop();
+    // NOTE: packets queued by a previous run stay queued and drain in order;
+    // `scope_fill` already follows the last of them
+    scope_enc.reset();
+    scope_cur = -1;
+    scope_on = true;
+    RING_BARRIER();
+    keymat_raw_callback = scope_field;
+}
+
+void scope_stop() {
+    if (!scope_on) return;
+    // NOTE: the scan ISR cannot be halfway through a field while the thread
+    // runs -- once unregistered, the encoder is ours
+    keymat_raw_callback = nullptr;
+    RING_BARRIER();
+    if (scope_cur >= 0) scope_ready();
+    scope_on = false;
+}
+
+bool scope_active() {
+    return scope_on;
+}
+
+void scope_poll() {
+    // NOTE: packets still queued after a stop are sent as well
+    while (uint16_t n = scope_len[scope_send]) {
+        // link backed up: retry later (the ISR drops fields meanwhile)
+        if (!hostlink_send(HOSTLINK_CH_SCAN, scope_buf[scope_send], n)) return;
+        scope_len[scope_send] = 0;
+        scope_send = (scope_send + 1) % BUF_n;
+    }
+}
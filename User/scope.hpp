@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+// raw scan oscilloscope: every raw field snapshot (`keymat_in`, i.e. before
+// debouncing) streamed to the host over the host link (SCAN channel)
+// - USER_KEYMAT_VOTE: the snapshot after majority voting
+// - lossless at the full field rate (5kHz): only changed rows are sent,
+//   unchanged fields are run-length coded (see scope_codec.hpp) -- a key
+//   bouncing shows up field by field at a few kB/s
+// - encoded in the scan ISR into one of two packet buffers; the thread hands
+//   full packets to the host link, partial ones every SCOPE_FLUSH_FIELDS
+// - when the thread or the link falls behind, fields are lost (counted); the
+//   host sees the gap in the field numbers
+// - host => device: a SCAN frame with payload 1 starts (field numbers restart
+//   at 0), 0 stops the stream
+// NOTE: field numbers count scanned fields -- they do not advance while the
+// scan sleeps (see keymat.hpp)
+
+static const uint16_t SCOPE_FLUSH_FIELDS = 50; // 10ms
+
+// NOTE: thread context
+void scope_start(void);
+void scope_stop(void);
+bool scope_active(void);
+
+// send completed packets
+// NOTE: thread context
+void scope_poll(void);
+
+// notification: a packet is ready to be sent
+// NOTE: called from ISR
+typedef void (*scope_notify_t)(void);
+extern scope_notify_t scope_notify;
+
+// statistics: fields not recorded
+extern volatile uint32_t scope_lost;
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t scope_ram_n;
@@ -0,0 +1,153 @@
+#include "scope_codec.hpp"
+
+#include <string.h>
+
+
+static uint8_t* wr16(uint8_t* p, uint16_t v) {
+    p[0] = v; p[1] = v >> 8;
+    return p + 2;
+}
+
+static uint8_t* wr32(uint8_t* p, uint32_t v) {
+    return wr16(wr16(p, v), v >> 16);
+}
+
+static uint16_t rd16(const uint8_t* p) { return p[0] | (p[1] << 8); }
+static uint32_t rd32(const uint8_t* p) { return rd16(p) | ((uint32_t)rd16(p + 2) << 16); }
+
+
+////////////////////////////////////////
+// encoder
+
+void ScopeEncoder::reset() {
+    buf = nullptr;
+    cap = 0;
+    n = 0;
+    field = 0;
+    first = 0;
+    skip = 0;
+    memset(rows, 0, sizeof(rows));
+}
+
+void ScopeEncoder::open(uint8_t* b, size_t c) {
+    buf = b;
+    cap = c;
+    first = field;
+    skip = 0;
+    uint8_t* p = wr32(buf, field);
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) p = wr16(p, rows[ri]);
+    n = p - buf;
+}
+
+static uint8_t* put_varint(uint8_t* p, uint32_t v) {
+    while (v >= 0x80) {
+        *p++ = v | 0x80;
+        v >>= 7;
+    }
+    *p++ = v;
+    return p;
+}
+
+bool ScopeEncoder::add(const uint16_t* r) {
+    uint16_t mask = 0;
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        if (r[ri] != rows[ri]) mask |= 1 << ri;
+    }
+    if (!mask) {
+        ++skip;
+        ++field;
+        return true;
+    }
+    if (n + SCOPE_RECORD_MAX + SCOPE_TAIL_n > cap) return false;
+    uint8_t* p = put_varint(buf + n, skip);
+    p = wr16(p, mask);
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        if (!(mask & (1 << ri))) continue;
+        p = wr16(p, r[ri] ^ rows[ri]);
+        rows[ri] = r[ri];
+    }
+    n = p - buf;
+    skip = 0;
+    ++field;
+    return true;
+}
+
+void ScopeEncoder::drop(const uint16_t* r) {
+    memcpy(rows, r, sizeof(rows));
+    ++field;
+}
+
+size_t ScopeEncoder::close() {
+    // NOTE: room for this was left by `add`
+    if (skip) {
+        uint8_t* p = put_varint(buf + n, skip);
+        n = wr16(p, 0) - buf;
+        skip = 0;
+    }
+    size_t len = n;
+    n = 0;
+    return len;
+}
+
+
+////////////////////////////////////////
+// decoder
+
+void ScopeDecoder::reset() {
+    synced = false;
+    field = 0;
+    memset(rows, 0, sizeof(rows));
+    gaps = 0;
+}
+
+static void scope_report(ScopeDecoder& d, const uint16_t* r, scope_key_callback_t cb, void* ctx) {
+    for (uint8_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        uint16_t diff = r[ri] ^ d.rows[ri];
+        for (uint8_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            if (diff & (1 << ci)) cb(ctx, d.field, ri, ci, (r[ri] >> ci) & 1);
+        }
+        d.rows[ri] = r[ri];
+    }
+}
+
+bool ScopeDecoder::decode(const uint8_t* p, size_t len, scope_key_callback_t cb, void* ctx) {
+    const uint8_t* end = p + len;
+    if (len < SCOPE_HEADER_n) return false;
+    uint32_t f = rd32(p);
+    p += 4;
+    uint16_t base[KEYMAT_ROW_n];
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri, p += 2) base[ri] = rd16(p);
+
+    if (synced && f != field) gaps += f - field;
+    field = f;
+    // first packet: the base is where the timeline starts, not a change
+    if (!synced) memcpy(rows, base, sizeof(rows));
+    scope_report(*this, base, cb, ctx);
+    synced = true;
+
+    while (p < end) {
+        uint32_t skip = 0;
+        for (uint8_t shift = 0 ; ; shift += 7) {
+            if (p >= end || shift > 21) return synced = false;
+            uint8_t b = *p++;
+            skip |= (uint32_t)(b & 0x7F) << shift;
+            if (!(b & 0x80)) break;
+        }
+        if (end - p < 2) return synced = false;
+        uint16_t mask = rd16(p);
+        p += 2;
+        field += skip;
+        if (!mask) continue;
+        uint16_t r[KEYMAT_ROW_n];
+        memcpy(r, rows, sizeof(r));
+        for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+            if (!(mask & (1 << ri))) continue;
+            if (end - p < 2) return synced = false;
+            r[ri] ^= rd16(p);
+            p += 2;
+        }
+        scope_report(*this, r, cb, ctx);
+        ++field;
+    }
+    return true;
+}
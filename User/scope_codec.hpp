@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "keymat_conf.hpp"
+
+// raw scan stream encoding (see scope.hpp)
+// packet: | field (4) | base (ROW_n x 2) | record ... |
+// - field: number of the first field covered; base: raw rows before it
+//   (one bit per column, same layout as `keymat_state`)
+// - record: | skip (varint) | mask (2) | XOR (2) for each bit set in mask |
+//   `skip` fields without any change, then one field in which the rows in
+//   `mask` changed; mask 0: `skip` fields without any change, nothing else
+// - multi-byte values are little-endian; varint: 7 bits per byte, LSB first,
+//   bit 7 set on all but the last byte
+// - every packet decodes on its own: a lost packet shows up as a gap in the
+//   field numbers, the keys' state is resynchronized from the next base
+// NOTE: hardware-independent (host-buildable)
+
+static const size_t SCOPE_HEADER_n = 4 + 2 * KEYMAT_ROW_n;
+// longest record (skip < 2^21)
+static const size_t SCOPE_RECORD_MAX = 3 + 2 + 2 * KEYMAT_ROW_n;
+// closing skip-only record
+static const size_t SCOPE_TAIL_n = 3 + 2;
+
+struct ScopeEncoder {
+    uint8_t* buf;
+    size_t cap;
+    size_t n;       // packet length so far (0: no packet open)
+    uint32_t field; // number of the next field
+    uint32_t first; // number of the first field in the open packet
+    uint32_t skip;  // fields without change not yet recorded
+    uint16_t rows[KEYMAT_ROW_n]; // last snapshot
+
+    // start over: field 0, all keys open
+    void reset();
+
+    // open a packet in `buf`
+    // (at least SCOPE_HEADER_n + SCOPE_RECORD_MAX + SCOPE_TAIL_n bytes)
+    void open(uint8_t* buf, size_t cap);
+
+    // add the next field
+    // return: false if the packet is full (field not added: close, open the
+    // next one and add it again)
+    bool add(const uint16_t* rows);
+
+    // a field that cannot be recorded (no packet open): the next packet
+    // starts after it, with its rows as the base
+    void drop(const uint16_t* rows);
+
+    // fields in the open packet
+    uint32_t fields() const { return field - first; }
+
+    // close the packet; return: its length
+    size_t close();
+};
+
+// key changed state: at field `field`, key (`ri`, `ci`)
+typedef void (*scope_key_callback_t)(void* ctx, uint32_t field, uint8_t ri, uint8_t ci, bool state);
+
+struct ScopeDecoder {
+    bool synced;
+    uint32_t field; // number of the next field expected
+    uint16_t rows[KEYMAT_ROW_n];
+    uint32_t gaps;  // fields lost (packets missing)
+
+    ScopeDecoder() { reset(); }
+    void reset();
+
+    // decode one packet, reporting every key that changed state
+    // NOTE: a change of state across a gap is reported at the first field
+    // after it
+    // return: false if malformed (state is resynchronized by the next packet)
+    bool decode(const uint8_t* p, size_t n, scope_key_callback_t cb, void* ctx);
+};
@@ -0,0 +1,164 @@
+#include "settings.hpp"
+
+#include <string.h>
+
+#include "flash_store.hpp"
+#include "settings_sysex.hpp"
+#include "ramfunc.h"
+#include "ring.hpp" // RING_BARRIER
+
+
+////////////////////////////////////////
+// defaults
+
+static const Settings settings_default = {
+    {},     // custom layer: B-griff (see `settings_init`)
+    KEYMAP_B_GRIFF,
+    0,      // transpose
+    0,      // channel
+    100,    // velocity
+    true,   // thru
+    0x42,   // SysEx device ID
+    {
+        // 8', 16', 4', 2'; 8' only
+        {{0, 0}, {-12, 0}, {+12, 0}, {+24, 0}},
+        0x1,
+    },
+    0,      // MPE off
+    EXPR_RES_AUTO,
+    11,     // bellows: expression
+    KEYMAT_BOUNCE_THRES_TRANSIENT_Tus,
+    KEYMAT_BOUNCE_THRES_STEADY_Tus,
+    false,  // fixed debouncing thresholds
+    {},     // nothing learned
+};
+
+
+////////////////////////////////////////
+// double buffer
+
+static Settings settings_buf[2];
+const uint16_t settings_ram_n = sizeof(settings_buf);
+static const Settings* volatile settings_active = &settings_buf[0];
+static Settings* settings_staged = &settings_buf[1];
+
+static bool settings_staged_dirty = false;
+static volatile bool settings_pending = false;
+
+void settings_init() {
+    settings_buf[0] = settings_default;
+    memcpy(settings_buf[0].mapping, keymap_b_griff(), sizeof(keymap_t));
+    settings_buf[1] = settings_buf[0];
+    settings_active = &settings_buf[0];
+    settings_staged = &settings_buf[1];
+    settings_staged_dirty = false;
+    settings_pending = false;
+}
+
+const Settings& settings() {
+    return *settings_active;
+}
+
+Settings* settings_edit() {
+    if (settings_pending) return nullptr;
+    if (!settings_staged_dirty) {
+        // staging buffer holds the previously active settings after a swap
+        *settings_staged = *settings_active;
+        settings_staged_dirty = true;
+    }
+    return settings_staged;
+}
+
+bool settings_dirty() {
+    return settings_staged_dirty;
+}
+
+void settings_revert() {
+    if (settings_pending) return;
+    settings_staged_dirty = false;
+}
+
+bool settings_valid(const Settings& s) {
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            if (s.mapping[ri][ci] > 127) return false;
+        }
+    }
+    if (s.layer >= KEYMAP_LAYER_n) return false;
+    if (s.transpose < -SETTINGS_TRANSPOSE_MAX || s.transpose > SETTINGS_TRANSPOSE_MAX) return false;
+    if (s.channel > 15) return false;
+    if (s.velocity < 1 || s.velocity > 127) return false;
+    if (s.device >= SETTINGS_SYSEX_BROADCAST) return false;
+    if (s.coupler.mask == 0 || s.coupler.mask >= (1 << COUPLER_RANK_n)) return false;
+    if (s.mpe > MPE_MEMBER_MAX) return false;
+    if (s.expr_res >= EXPR_RES_n || s.bellows_cc > 31) return false;
+    for (size_t i = 0 ; i < COUPLER_RANK_n ; ++i) {
+        const CouplerRank& r = s.coupler.ranks[i];
+        if (r.offset < -SETTINGS_TRANSPOSE_MAX || r.offset > SETTINGS_TRANSPOSE_MAX) return false;
+        if (r.channel > 15) return false;
+    }
+    // same rounding as `keymat_set_debounce`
+    uint32_t transient = (s.debounce_transient_Tus + KEYMAT_FIELD_PERIOD_Tus - 1) / KEYMAT_FIELD_PERIOD_Tus;
+    uint32_t steady = (s.debounce_steady_Tus + KEYMAT_FIELD_PERIOD_Tus - 1) / KEYMAT_FIELD_PERIOD_Tus;
+    if (!(0 < transient && transient < steady && steady <= KEYMAT_DEBOUNCE_FIELDS_MAX)) return false;
+    // learned thresholds: clamped to the current bounds when loaded
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        for (size_t ci = 0 ; ci < KEYMAT_COL_n ; ++ci) {
+            if (s.debounce_learned[ri][ci] > KEYMAT_DEBOUNCE_FIELDS_MAX) return false;
+        }
+    }
+    return true;
+}
+
+bool settings_apply() {
+    if (settings_pending) return false;
+    if (!settings_staged_dirty) return true;
+    if (!settings_valid(*settings_staged)) return false;
+    // staging copy must be complete before the field ISR may swap it in
+    RING_BARRIER();
+    settings_pending = true;
+    return true;
+}
+
+bool settings_apply_pending() {
+    return settings_pending;
+}
+
+RAMFUNC bool settings_field() {
+    if (!settings_pending) return false;
+    Settings* old = (Settings*)settings_active;
+    settings_active = settings_staged;
+    settings_staged = old;
+    settings_staged_dirty = false;
+    settings_pending = false;
+    return true;
+}
+
+
+////////////////////////////////////////
+// persistence
+
+static const size_t SETTINGS_RECORD_n = 2 + sizeof(Settings);
+static_assert(SETTINGS_RECORD_n <= FLASH_STORE_DATA_n, "");
+
+bool settings_restore() {
+    const uint8_t* data;
+    size_t n;
+    if (!flash_store_read(data, n)) return false;
+    if (n != SETTINGS_RECORD_n) return false;
+    if ((data[0] | (data[1] << 8)) != SETTINGS_VERSION) return false;
+    Settings s;
+    memcpy(&s, data + 2, sizeof(Settings));
+    if (!settings_valid(s)) return false;
+    settings_buf[0] = s;
+    settings_buf[1] = s;
+    return true;
+}
+
+bool settings_save() {
+    uint8_t record[SETTINGS_RECORD_n];
+    record[0] = SETTINGS_VERSION;
+    record[1] = SETTINGS_VERSION >> 8;
+    memcpy(record + 2, (const void*)settings_active, sizeof(Settings));
+    return flash_store_write(record, SETTINGS_RECORD_n);
+}
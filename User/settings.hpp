@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "coupler.hpp"
+#include "expr.hpp"
+#include "keymap.hpp"
+#include "mpe.hpp"
+
+// run-time settings (keymap, MIDI output, debouncing)
+// - the active settings are read-only; edits go to a staging copy which is
+//   swapped in as a whole between two scan fields (`settings_field`)
+// - the ISR therefore never sees a half-updated table, and never waits
+
+struct Settings {
+    // keymap (see keymap.hpp)
+    keymap_t mapping;   // custom layer
+    uint8_t layer;      // selected on apply/boot
+    int8_t transpose;   // transposed layer: semitones
+    // MIDI output
+    uint8_t channel;    // 0..15
+    uint8_t velocity;   // 1..127
+    bool thru;          // merge MIDI input into the output (see midi_thru.hpp)
+    uint8_t device;     // SysEx device ID, 0..0x7E (see settings_sysex.hpp)
+    CouplerConfig coupler; // registers (see coupler.hpp)
+    uint8_t mpe;        // MPE member channels (0: off; see mpe.hpp)
+    // expression (see expr.hpp)
+    uint8_t expr_res;   // expr_res_t
+    uint8_t bellows_cc; // 0..31 (LSB: + 32)
+    // debouncing (see keymat_conf.hpp)
+    uint16_t debounce_transient_Tus;
+    uint16_t debounce_steady_Tus;
+    bool debounce_adapt; // per-key steady thresholds (see `keymat_set_adaptive`)
+    // learned thresholds as last stored (fields; 0: not learned)
+    // NOTE: loaded when adaptive debouncing is turned on (and at boot); the
+    // live copy is in keymat
+    uint8_t debounce_learned[KEYMAT_ROW_n][KEYMAT_COL_n];
+};
+
+static const int8_t SETTINGS_TRANSPOSE_MAX = 48;
+
+// load defaults (hardcoded) and make them active
+// NOTE: call before scanning starts
+void settings_init(void);
+
+// persistence (see flash_store.hpp)
+// - record: layout version (2 bytes) + `Settings` as is
+// - `settings_restore`: make the stored settings active, if there are any and
+//   they match the current layout (call after `settings_init`)
+// - `settings_save`: queue the active settings for writing
+//   return: false if a previous save is still in progress
+// NOTE: bump SETTINGS_VERSION whenever `Settings` changes
+static const uint16_t SETTINGS_VERSION = 7;
+bool settings_restore(void);
+bool settings_save(void);
+
+// active settings
+// NOTE: stays consistent for the duration of a field when read from the field
+// or event callbacks; in thread context, only until the next `settings_apply`
+const Settings& settings(void);
+
+// staging copy, initially equal to the active settings
+// return: nullptr while an apply is still pending
+Settings* settings_edit(void);
+
+// whether the staging copy differs from the active settings
+bool settings_dirty(void);
+
+// discard the staging copy
+void settings_revert(void);
+
+// range check
+bool settings_valid(const Settings& s);
+
+// make the staging copy active from the next field on
+// return: false if invalid (nothing changed) or still pending
+bool settings_apply(void);
+bool settings_apply_pending(void);
+
+// swap in the staging copy if an apply is pending
+// return: whether the active settings have changed
+// NOTE: call from the field callback (see keymat.hpp)
+bool settings_field(void);
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t settings_ram_n;
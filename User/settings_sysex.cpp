@@ -0,0 +1,278 @@
+#include "settings_sysex.hpp"
+
+#include <string.h>
+
+#include "settings.hpp"
+
+
+static const size_t HEADER_n = 4; // F0 ID DEVICE CMD
+static const size_t MAP_n = KEYMAT_ROW_n * KEYMAT_COL_n;
+
+// settings as seen by the host: staged if there are unapplied changes
+static const Settings& settings_view() {
+    if (settings_dirty()) {
+        const Settings* s = settings_edit();
+        if (s) return *s;
+    }
+    return settings();
+}
+
+// return: false if unknown parameter
+static bool param_get(const Settings& s, uint8_t param, uint16_t& v) {
+    switch (param) {
+    case SETTINGS_PARAM_CHANNEL: v = s.channel; return true;
+    case SETTINGS_PARAM_VELOCITY: v = s.velocity; return true;
+    case SETTINGS_PARAM_THRU: v = s.thru; return true;
+    case SETTINGS_PARAM_LAYER: v = s.layer; return true;
+    case SETTINGS_PARAM_TRANSPOSE: v = s.transpose + 64; return true;
+    case SETTINGS_PARAM_REGISTER: v = s.coupler.mask; return true;
+    case SETTINGS_PARAM_MPE: v = s.mpe; return true;
+    case SETTINGS_PARAM_EXPR_RES: v = s.expr_res; return true;
+    case SETTINGS_PARAM_BELLOWS_CC: v = s.bellows_cc; return true;
+    case SETTINGS_PARAM_DEVICE: v = s.device; return true;
+    case SETTINGS_PARAM_DEBOUNCE_TRANSIENT_Tus: v = s.debounce_transient_Tus; return true;
+    case SETTINGS_PARAM_DEBOUNCE_STEADY_Tus: v = s.debounce_steady_Tus; return true;
+    case SETTINGS_PARAM_DEBOUNCE_ADAPT: v = s.debounce_adapt; return true;
+    default: break;
+    }
+    if (param >= SETTINGS_PARAM_RANK_OFFSET && param < SETTINGS_PARAM_RANK_OFFSET + COUPLER_RANK_n) {
+        v = s.coupler.ranks[param - SETTINGS_PARAM_RANK_OFFSET].offset + 64;
+        return true;
+    }
+    if (param >= SETTINGS_PARAM_RANK_CHANNEL && param < SETTINGS_PARAM_RANK_CHANNEL + COUPLER_RANK_n) {
+        v = s.coupler.ranks[param - SETTINGS_PARAM_RANK_CHANNEL].channel;
+        return true;
+    }
+    return false;
+}
+
+// NOTE: only checks the range of each value on its own -- consistency is
+// checked on apply
+static SettingsSysexError param_set(Settings& s, uint8_t param, uint16_t v) {
+    switch (param) {
+    case SETTINGS_PARAM_CHANNEL:
+        if (v > 15) return SETTINGS_SYSEX_E_RANGE;
+        s.channel = v;
+        break;
+    case SETTINGS_PARAM_VELOCITY:
+        if (v < 1 || v > 127) return SETTINGS_SYSEX_E_RANGE;
+        s.velocity = v;
+        break;
+    case SETTINGS_PARAM_THRU:
+        if (v > 1) return SETTINGS_SYSEX_E_RANGE;
+        s.thru = v;
+        break;
+    case SETTINGS_PARAM_LAYER:
+        if (v >= KEYMAP_LAYER_n) return SETTINGS_SYSEX_E_RANGE;
+        s.layer = v;
+        break;
+    case SETTINGS_PARAM_TRANSPOSE:
+        if (v < 64 - SETTINGS_TRANSPOSE_MAX || v > 64 + SETTINGS_TRANSPOSE_MAX) return SETTINGS_SYSEX_E_RANGE;
+        s.transpose = (int)v - 64;
+        break;
+    case SETTINGS_PARAM_REGISTER:
+        if (v == 0 || v >= (1 << COUPLER_RANK_n)) return SETTINGS_SYSEX_E_RANGE;
+        s.coupler.mask = v;
+        break;
+    case SETTINGS_PARAM_MPE:
+        if (v > MPE_MEMBER_MAX) return SETTINGS_SYSEX_E_RANGE;
+        s.mpe = v;
+        break;
+    case SETTINGS_PARAM_EXPR_RES:
+        if (v >= EXPR_RES_n) return SETTINGS_SYSEX_E_RANGE;
+        s.expr_res = v;
+        break;
+    case SETTINGS_PARAM_BELLOWS_CC:
+        if (v > 31) return SETTINGS_SYSEX_E_RANGE;
+        s.bellows_cc = v;
+        break;
+    case SETTINGS_PARAM_DEVICE:
+        if (v >= SETTINGS_SYSEX_BROADCAST) return SETTINGS_SYSEX_E_RANGE;
+        s.device = v;
+        break;
+    case SETTINGS_PARAM_DEBOUNCE_TRANSIENT_Tus:
+        s.debounce_transient_Tus = v;
+        break;
+    case SETTINGS_PARAM_DEBOUNCE_STEADY_Tus:
+        s.debounce_steady_Tus = v;
+        break;
+    case SETTINGS_PARAM_DEBOUNCE_ADAPT:
+        if (v > 1) return SETTINGS_SYSEX_E_RANGE;
+        s.debounce_adapt = v;
+        if (!v) memset(s.debounce_learned, 0, sizeof(s.debounce_learned));
+        break;
+    default:
+        if (param >= SETTINGS_PARAM_RANK_OFFSET && param < SETTINGS_PARAM_RANK_OFFSET + COUPLER_RANK_n) {
+            if (v < 64 - SETTINGS_TRANSPOSE_MAX || v > 64 + SETTINGS_TRANSPOSE_MAX) return SETTINGS_SYSEX_E_RANGE;
+            s.coupler.ranks[param - SETTINGS_PARAM_RANK_OFFSET].offset = (int)v - 64;
+            break;
+        }
+        if (param >= SETTINGS_PARAM_RANK_CHANNEL && param < SETTINGS_PARAM_RANK_CHANNEL + COUPLER_RANK_n) {
+            if (v > 15) return SETTINGS_SYSEX_E_RANGE;
+            s.coupler.ranks[param - SETTINGS_PARAM_RANK_CHANNEL].channel = v;
+            break;
+        }
+        return SETTINGS_SYSEX_E_RANGE;
+    }
+    return (SettingsSysexError)0;
+}
+
+static size_t reply_begin(uint8_t* reply, uint8_t cmd) {
+    reply[0] = 0xF0;
+    reply[1] = SETTINGS_SYSEX_ID;
+    reply[2] = settings().device;
+    reply[3] = cmd;
+    return HEADER_n;
+}
+
+static size_t reply_ack(uint8_t* reply, uint8_t cmd) {
+    size_t n = reply_begin(reply, SETTINGS_SYSEX_ACK);
+    reply[n++] = cmd;
+    reply[n++] = 0xF7;
+    return n;
+}
+
+static size_t reply_nak(uint8_t* reply, uint8_t cmd, SettingsSysexError e) {
+    size_t n = reply_begin(reply, SETTINGS_SYSEX_NAK);
+    reply[n++] = cmd;
+    reply[n++] = e;
+    reply[n++] = 0xF7;
+    return n;
+}
+
+bool settings_sysex(const uint8_t* msg, size_t n, uint8_t* reply, size_t& reply_n) {
+    reply_n = 0;
+    if (n < HEADER_n + 1) return false;
+    if (msg[0] != 0xF0 || msg[n - 1] != 0xF7) return false;
+    if (msg[1] != SETTINGS_SYSEX_ID) return false;
+    // replies (incl. ACK / NAK) from an instrument up the chain: for the host
+    // NOTE: before the device check -- all instruments ship with the same ID
+    if (msg[3] & SETTINGS_SYSEX_REPLY) return false;
+    if (msg[2] != settings().device && msg[2] != SETTINGS_SYSEX_BROADCAST) return false;
+
+    uint8_t cmd = msg[3];
+    const uint8_t* p = msg + HEADER_n;
+    size_t p_n = n - HEADER_n - 1;
+
+    switch (cmd) {
+    case SETTINGS_SYSEX_INFO: {
+        if (p_n != 0) break;
+        size_t i = reply_begin(reply, cmd | SETTINGS_SYSEX_REPLY);
+        reply[i++] = SETTINGS_SYSEX_VERSION;
+        reply[i++] = KEYMAT_ROW_n;
+        reply[i++] = KEYMAT_COL_n;
+        reply[i++] = 0xF7;
+        reply_n = i;
+        return true;
+    }
+    case SETTINGS_SYSEX_GET_MAP: {
+        if (p_n != 0) break;
+        size_t i = reply_begin(reply, cmd | SETTINGS_SYSEX_REPLY);
+        memcpy(reply + i, settings_view().mapping, MAP_n);
+        i += MAP_n;
+        reply[i++] = 0xF7;
+        reply_n = i;
+        return true;
+    }
+    case SETTINGS_SYSEX_SET_MAP: {
+        if (p_n != MAP_n) break;
+        Settings* s = settings_edit();
+        if (!s) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_BUSY);
+            return true;
+        }
+        // NOTE: data bytes are 7-bit, i.e. always valid keycodes
+        memcpy(s->mapping, p, MAP_n);
+        reply_n = reply_ack(reply, cmd);
+        return true;
+    }
+    case SETTINGS_SYSEX_SET_KEY: {
+        if (p_n != 3) break;
+        if (p[0] >= KEYMAT_ROW_n || p[1] >= KEYMAT_COL_n) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_RANGE);
+            return true;
+        }
+        Settings* s = settings_edit();
+        if (!s) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_BUSY);
+            return true;
+        }
+        s->mapping[p[0]][p[1]] = p[2];
+        reply_n = reply_ack(reply, cmd);
+        return true;
+    }
+    case SETTINGS_SYSEX_GET_PARAM: {
+        if (p_n != 1) break;
+        uint16_t v;
+        if (!param_get(settings_view(), p[0], v)) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_RANGE);
+            return true;
+        }
+        size_t i = reply_begin(reply, cmd | SETTINGS_SYSEX_REPLY);
+        reply[i++] = p[0];
+        reply[i++] = v & 0x7F;
+        reply[i++] = (v >> 7) & 0x7F;
+        reply[i++] = (v >> 14) & 0x7F;
+        reply[i++] = 0xF7;
+        reply_n = i;
+        return true;
+    }
+    case SETTINGS_SYSEX_SET_PARAM: {
+        if (p_n != 4) break;
+        uint32_t v = p[1] | (p[2] << 7) | ((uint32_t)p[3] << 14);
+        if (v > 0xFFFF) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_RANGE);
+            return true;
+        }
+        Settings* s = settings_edit();
+        if (!s) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_BUSY);
+            return true;
+        }
+        SettingsSysexError e = param_set(*s, p[0], v);
+        reply_n = e ? reply_nak(reply, cmd, e) : reply_ack(reply, cmd);
+        return true;
+    }
+    case SETTINGS_SYSEX_APPLY: {
+        if (p_n != 0) break;
+        if (settings_apply_pending()) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_BUSY);
+        } else if (!settings_apply()) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_INVALID);
+        } else {
+            reply_n = reply_ack(reply, cmd);
+        }
+        return true;
+    }
+    case SETTINGS_SYSEX_REVERT: {
+        if (p_n != 0) break;
+        if (settings_apply_pending()) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_BUSY);
+        } else {
+            settings_revert();
+            reply_n = reply_ack(reply, cmd);
+        }
+        return true;
+    }
+    case SETTINGS_SYSEX_SAVE: {
+        if (p_n != 0) break;
+        if (settings_apply_pending() || !settings_save()) {
+            reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_BUSY);
+        } else {
+            reply_n = reply_ack(reply, cmd);
+        }
+        return true;
+    }
+    default:
+        reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_CMD);
+        return true;
+    }
+
+    // known command, wrong payload length
+    reply_n = reply_nak(reply, cmd, SETTINGS_SYSEX_E_LENGTH);
+    return true;
+}
+
+bool settings_sysex_broadcast(const uint8_t* msg, size_t n) {
+    return n > 2 && msg[2] == SETTINGS_SYSEX_BROADCAST;
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "keymat_conf.hpp"
+
+// SysEx configuration protocol (over MIDI input; replies on MIDI output)
+//
+// frame: F0 7D <device> <cmd> <payload...> F7
+// - 7D: manufacturer ID reserved for non-commercial use
+// - device: ID of this instrument (setting, default 42), or 7F (broadcast:
+//   handled by every instrument in a thru chain); other SysEx is not ours
+//   (forwarded)
+// - replies carry the ID of the instrument (as active when sent); replies
+//   from other instruments (cmd 41 and up) are forwarded, whatever their ID
+//
+// | cmd | request payload     | reply                          |
+// |-----|---------------------|--------------------------------|
+// | 01  | -                   | 41 <version> <rows> <cols>     |
+// | 02  | -                   | 42 <keycode * rows * cols>     |
+// | 03  | <keycode * rows * cols> | ACK                        |
+// | 04  | <row> <col> <keycode> | ACK                          |
+// | 05  | <param>             | 45 <param> <v0> <v1> <v2>      |
+// | 06  | <param> <v0> <v1> <v2> | ACK                         |
+// | 07  | -                   | ACK (apply staged changes)     |
+// | 08  | -                   | ACK (discard staged changes)   |
+// | 09  | -                   | ACK (save active settings)     |
+//
+// - ACK: 7E <cmd>; NAK: 7F <cmd> <error>
+// - values: 16-bit, 7 bits per byte, least significant first
+// - keymap (02/03/04): the custom layer (see keymap.hpp)
+// - writes (03/04/06) only change the staging copy; reads (02/05) return the
+//   staging copy if there are unapplied changes, the active settings otherwise
+// - apply (07) takes effect between two scan fields, all changes at once
+// - save (09) stores the active (i.e. applied) settings in flash, loaded on
+//   the next boot; the write itself happens in the background
+// NOTE: never waits -- while an apply is pending, writes are refused (BUSY)
+
+static const uint8_t SETTINGS_SYSEX_ID = 0x7D;
+static const uint8_t SETTINGS_SYSEX_BROADCAST = 0x7F;
+static const uint8_t SETTINGS_SYSEX_VERSION = 1;
+
+enum SettingsSysexCmd : uint8_t {
+    SETTINGS_SYSEX_INFO = 0x01,
+    SETTINGS_SYSEX_GET_MAP = 0x02,
+    SETTINGS_SYSEX_SET_MAP = 0x03,
+    SETTINGS_SYSEX_SET_KEY = 0x04,
+    SETTINGS_SYSEX_GET_PARAM = 0x05,
+    SETTINGS_SYSEX_SET_PARAM = 0x06,
+    SETTINGS_SYSEX_APPLY = 0x07,
+    SETTINGS_SYSEX_REVERT = 0x08,
+    SETTINGS_SYSEX_SAVE = 0x09,
+    SETTINGS_SYSEX_REPLY = 0x40, // reply: cmd | REPLY (set in ACK / NAK as well)
+    SETTINGS_SYSEX_ACK = 0x7E,
+    SETTINGS_SYSEX_NAK = 0x7F,
+};
+
+enum SettingsSysexParam : uint8_t {
+    SETTINGS_PARAM_CHANNEL = 0x00,
+    SETTINGS_PARAM_VELOCITY = 0x01,
+    SETTINGS_PARAM_THRU = 0x02,
+    SETTINGS_PARAM_LAYER = 0x03,     // see keymap.hpp
+    SETTINGS_PARAM_TRANSPOSE = 0x04, // semitones + 64
+    SETTINGS_PARAM_REGISTER = 0x05,  // selected ranks (see coupler.hpp)
+    SETTINGS_PARAM_MPE = 0x06,       // MPE member channels, 0: off (see mpe.hpp)
+    SETTINGS_PARAM_EXPR_RES = 0x07,  // expr_res_t (see expr.hpp)
+    SETTINGS_PARAM_BELLOWS_CC = 0x08, // 0..31
+    SETTINGS_PARAM_DEVICE = 0x09,     // SysEx device ID, 0..0x7E
+    SETTINGS_PARAM_DEBOUNCE_TRANSIENT_Tus = 0x10,
+    SETTINGS_PARAM_DEBOUNCE_STEADY_Tus = 0x11,
+    SETTINGS_PARAM_DEBOUNCE_ADAPT = 0x12, // per-key thresholds; 0: off (forgets what was learned)
+    SETTINGS_PARAM_RANK_OFFSET = 0x20,  // + rank; semitones + 64
+    SETTINGS_PARAM_RANK_CHANNEL = 0x28, // + rank; relative to the base channel
+};
+
+enum SettingsSysexError : uint8_t {
+    SETTINGS_SYSEX_E_CMD = 0x01,    // unknown command
+    SETTINGS_SYSEX_E_LENGTH = 0x02, // wrong payload length
+    SETTINGS_SYSEX_E_RANGE = 0x03,  // value out of range
+    SETTINGS_SYSEX_E_BUSY = 0x04,   // apply/save still pending
+    SETTINGS_SYSEX_E_INVALID = 0x05, // apply: inconsistent settings
+};
+
+// longest reply (keymap)
+static const size_t SETTINGS_SYSEX_REPLY_n = 5 + KEYMAT_ROW_n * KEYMAT_COL_n;
+
+// handle one complete SysEx message (F0 ... F7)
+// return: false if not addressed to us
+// `reply[0..reply_n)`: message to send back (reply_n = 0: none)
+// NOTE: thread context (uses `settings_edit`)
+bool settings_sysex(const uint8_t* msg, size_t n, uint8_t* reply, size_t& reply_n);
+
+// whether a message (addressed to us) is a broadcast, i.e. is to be
+// forwarded as well
+bool settings_sysex_broadcast(const uint8_t* msg, size_t n);
@@ -0,0 +1,319 @@
+#include "synth.hpp"
+
+#include <string.h>
+
+#include "cyccnt.h"
+
+
+////////////////////////////////////////
+// tables
+
+// one period of an accordion reed: harmonics 1..12 in sine phase, amplitude
+// n^-0.7, even harmonics -2.5dB; peak 32000
+// (band-limited so that notes up to C6 stay below Nyquist)
+static const size_t WAVE_BITS = 9;
+static const int16_t SYNTH_WAVE[1 << WAVE_BITS] = {
+         0,   2943,   5858,   8720,  11501,  14178,  16726,  19125,  21355,  23399,
+     25242,  26873,  28284,  29467,  30422,  31148,  31648,  31929,  32000,  31872,
+     31558,  31076,  30441,  29673,  28792,  27819,  26774,  25680,  24556,  23423,
+     22300,  21206,  20157,  19167,  18251,  17419,  16679,  16039,  15502,  15071,
+     14747,  14526,  14404,  14377,  14435,  14571,  14775,  15034,  15338,  15675,
+     16031,  16396,  16757,  17103,  17424,  17710,  17953,  18146,  18283,  18360,
+     18375,  18325,  18213,  18039,  17806,  17519,  17184,  16806,  16393,  15953,
+     15493,  15024,  14552,  14086,  13635,  13206,  12806,  12440,  12115,  11835,
+     11602,  11419,  11286,  11203,  11170,  11183,  11239,  11335,  11464,  11621,
+     11801,  11997,  12201,  12408,  12610,  12802,  12976,  13128,  13252,  13345,
+     13403,  13423,  13404,  13346,  13247,  13110,  12937,  12730,  12492,  12229,
+     11944,  11643,  11331,  11014,  10697,  10387,  10087,   9804,   9542,   9305,
+      9097,   8919,   8775,   8666,   8592,   8552,   8547,   8573,   8628,   8710,
+      8814,   8937,   9074,   9219,   9370,   9519,   9663,   9797,   9917,  10018,
+     10097,  10151,  10178,  10175,  10142,  10079,   9986,   9863,   9713,   9538,
+      9341,   9124,   8892,   8649,   8398,   8145,   7894,   7649,   7414,   7193,
+      6990,   6808,   6650,   6517,   6412,   6334,   6286,   6265,   6271,   6303,
+      6359,   6435,   6529,   6638,   6758,   6884,   7014,   7142,   7265,   7379,
+      7480,   7565,   7631,   7676,   7698,   7695,   7665,   7610,   7529,   7423,
+      7293,   7141,   6969,   6781,   6578,   6366,   6147,   5924,   5703,   5486,
+      5277,   5079,   4897,   4733,   4588,   4467,   4369,   4297,   4250,   4230,
+      4236,   4266,   4320,   4396,   4491,   4603,   4729,   4866,   5011,   5160,
+      5311,   5458,   5600,   5733,   5854,   5960,   6048,   6117,   6165,   6189,
+      6190,   6166,   6117,   6042,   5943,   5819,   5672,   5503,   5313,   5103,
+      4875,   4631,   4372,   4101,   3818,   3525,   3225,   2917,   2604,   2286,
+      1965,   1641,   1315,    987,    659,    330,      0,   -330,   -659,   -987,
+     -1315,  -1641,  -1965,  -2286,  -2604,  -2917,  -3225,  -3525,  -3818,  -4101,
+     -4372,  -4631,  -4875,  -5103,  -5313,  -5503,  -5672,  -5819,  -5943,  -6042,
+     -6117,  -6166,  -6190,  -6189,  -6165,  -6117,  -6048,  -5960,  -5854,  -5733,
+     -5600,  -5458,  -5311,  -5160,  -5011,  -4866,  -4729,  -4603,  -4491,  -4396,
+     -4320,  -4266,  -4236,  -4230,  -4250,  -4297,  -4369,  -4467,  -4588,  -4733,
+     -4897,  -5079,  -5277,  -5486,  -5703,  -5924,  -6147,  -6366,  -6578,  -6781,
+     -6969,  -7141,  -7293,  -7423,  -7529,  -7610,  -7665,  -7695,  -7698,  -7676,
+     -7631,  -7565,  -7480,  -7379,  -7265,  -7142,  -7014,  -6884,  -6758,  -6638,
+     -6529,  -6435,  -6359,  -6303,  -6271,  -6265,  -6286,  -6334,  -6412,  -6517,
+     -6650,  -6808,  -6990,  -7193,  -7414,  -7649,  -7894,  -8145,  -8398,  -8649,
+     -8892,  -9124,  -9341,  -9538,  -9713,  -9863,  -9986, -10079, -10142, -10175,
+    -10178, -10151, -10097, -10018,  -9917,  -9797,  -9663,  -9519,  -9370,  -9219,
+     -9074,  -8937,  -8814,  -8710,  -8628,  -8573,  -8547,  -8552,  -8592,  -8666,
+     -8775,  -8919,  -9097,  -9305,  -9542,  -9804, -10087, -10387, -10697, -11014,
+    -11331, -11643, -11944, -12229, -12492, -12730, -12937, -13110, -13247, -13346,
+    -13404, -13423, -13403, -13345, -13252, -13128, -12976, -12802, -12610, -12408,
+    -12201, -11997, -11801, -11621, -11464, -11335, -11239, -11183, -11170, -11203,
+    -11286, -11419, -11602, -11835, -12115, -12440, -12806, -13206, -13635, -14086,
+    -14552, -15024, -15493, -15953, -16393, -16806, -17184, -17519, -17806, -18039,
+    -18213, -18325, -18375, -18360, -18283, -18146, -17953, -17710, -17424, -17103,
+    -16757, -16396, -16031, -15675, -15338, -15034, -14775, -14571, -14435, -14377,
+    -14404, -14526, -14747, -15071, -15502, -16039, -16679, -17419, -18251, -19167,
+    -20157, -21206, -22300, -23423, -24556, -25680, -26774, -27819, -28792, -29673,
+    -30441, -31076, -31558, -31872, -32000, -31929, -31648, -31148, -30422, -29467,
+    -28284, -26873, -25242, -23399, -21355, -19125, -16726, -14178, -11501,  -8720,
+     -5858,  -2943,};
+
+// phase increments of the top octave (notes 120..131) at SYNTH_RATE;
+// lower octaves: shifted down
+static const uint32_t SYNTH_INC_TOP[12] = {
+    1150641405, 1219062103, 1291551308, 1368350945, 1449717327, 1535922005,
+    1627252680, 1724014160, 1826529376, 1935140465, 2050209905, 2172121730,
+};
+
+static uint32_t synth_inc(uint8_t note) {
+    return SYNTH_INC_TOP[note % 12] >> (10 - note / 12);
+}
+
+
+////////////////////////////////////////
+// voices
+
+// levels: Q30 (Q14 applied per sample)
+static const int32_t LEVEL_FULL = 1 << 30;
+static const int32_t ATTACK_STEP = LEVEL_FULL / (SYNTH_RATE * 8 / 1000);    // 8ms
+static const int32_t RELEASE_STEP = LEVEL_FULL / (SYNTH_RATE * 40 / 1000);  // 40ms
+
+struct SynthVoice {
+    // thread
+    uint8_t channel;
+    uint8_t note;
+    uint32_t age;       // note on order
+    volatile uint8_t reeds;
+    volatile uint32_t inc[SYNTH_REED_MAX];
+    volatile int32_t target; // held: level to reach; 0: released
+    // renderer
+    uint32_t phase[SYNTH_REED_MAX];
+    volatile int32_t level;
+};
+
+static SynthVoice synth_voice[SYNTH_VOICE_n];
+static uint32_t synth_age = 0;
+
+// note on settings
+static uint8_t synth_reeds = 1;
+static uint32_t synth_detune = 0; // relative increment (/65536)
+
+// global amplitude: target (thread), current (renderer)
+static volatile int32_t synth_master_target = LEVEL_FULL;
+static int32_t synth_master = LEVEL_FULL;
+
+// renderer: voice sum
+static int32_t synth_acc[SYNTH_BLOCK_MAX];
+
+const uint16_t synth_ram_n = sizeof(synth_voice) + sizeof(synth_acc);
+
+volatile uint32_t synth_steals = 0;
+
+static bool synth_free(const SynthVoice& v) {
+    return !v.target && !v.level;
+}
+
+void synth_init() {
+    memset(synth_voice, 0, sizeof(synth_voice));
+    synth_age = 0;
+    synth_reeds = 1;
+    synth_detune = 0;
+    synth_master_target = LEVEL_FULL;
+    synth_master = LEVEL_FULL;
+}
+
+void synth_config(uint8_t reeds, uint8_t detune_cents) {
+    if (reeds < 1) reeds = 1;
+    if (reeds > SYNTH_REED_MAX) reeds = SYNTH_REED_MAX;
+    if (detune_cents > 50) detune_cents = 50;
+    synth_reeds = reeds;
+    // 2^(c/1200) - 1 ~ c * ln2/1200 (within 1.5% up to 50 cents)
+    synth_detune = (uint32_t)detune_cents * 37855 / 1000;
+}
+
+// free voice, else the quietest released one, else the oldest held one
+static SynthVoice& synth_alloc() {
+    SynthVoice* best = nullptr;
+    for (size_t i = 0 ; i < SYNTH_VOICE_n ; ++i) {
+        SynthVoice& v = synth_voice[i];
+        if (synth_free(v)) return v;
+        if (!best) {
+            best = &v;
+        } else if (!v.target) {
+            if (best->target || v.level < best->level) best = &v;
+        } else if (best->target && (int32_t)(v.age - best->age) < 0) {
+            best = &v;
+        }
+    }
+    ++synth_steals;
+    return *best;
+}
+
+static void synth_note_on(uint8_t channel, uint8_t note, uint16_t velocity) {
+    SynthVoice& v = synth_alloc();
+    v.channel = channel;
+    v.note = note;
+    v.age = synth_age++;
+    uint32_t inc = synth_inc(note);
+    uint32_t d = (inc >> 16) * synth_detune;
+    v.inc[0] = inc;
+    v.inc[1] = inc + d;
+    v.inc[2] = inc - d;
+    v.reeds = synth_reeds;
+    // NOTE: written last -- the renderer picks the voice up from here on
+    v.target = ((int32_t)velocity << 14) / synth_reeds;
+}
+
+static void synth_note_off(uint8_t channel, uint8_t note) {
+    for (size_t i = 0 ; i < SYNTH_VOICE_n ; ++i) {
+        SynthVoice& v = synth_voice[i];
+        if (v.target && v.channel == channel && v.note == note) v.target = 0;
+    }
+}
+
+void synth_event(const MidiEvent& e) {
+    switch (e.type) {
+    case MIDI_EV_NOTE_ON:
+        synth_note_on(e.channel, e.note & 0x7F, e.velocity ? e.velocity : 1);
+        break;
+    case MIDI_EV_NOTE_OFF:
+        synth_note_off(e.channel, e.note & 0x7F);
+        break;
+    default:
+        break;
+    }
+}
+
+void synth_all_off() {
+    for (size_t i = 0 ; i < SYNTH_VOICE_n ; ++i) synth_voice[i].target = 0;
+}
+
+void synth_pressure(uint32_t pressure) {
+    synth_master_target = pressure >> 2;
+}
+
+uint8_t synth_voices() {
+    uint8_t n = 0;
+    for (size_t i = 0 ; i < SYNTH_VOICE_n ; ++i) n += !synth_free(synth_voice[i]);
+    return n;
+}
+
+
+////////////////////////////////////////
+// rendering
+
+// level after `n` samples of attack / release towards `target`
+static int32_t synth_ramp(int32_t level, int32_t target, size_t n) {
+    if (level < target) {
+        int32_t up = ATTACK_STEP * (int32_t)n;
+        return target - level > up ? level + up : target;
+    } else {
+        int32_t down = RELEASE_STEP * (int32_t)n;
+        return level - target > down ? level - down : target;
+    }
+}
+
+// mixing kernel: add one voice (R reeds) to the block, level ramping from
+// `g` by `dg` per sample
+// NOTE: per sample and reed: 1 table lookup, 1 add to the phase; per sample:
+// 1 multiply-accumulate => ~8 + 5 * R cycles on the M3
+template <uint8_t R>
+static void synth_mix(SynthVoice& v, int32_t* acc, size_t n, int32_t g, int32_t dg) {
+    static const uint8_t SHIFT = 32 - WAVE_BITS;
+    uint32_t p0 = v.phase[0], p1 = v.phase[1], p2 = v.phase[2];
+    const uint32_t i0 = v.inc[0], i1 = v.inc[1], i2 = v.inc[2];
+    for (size_t i = 0 ; i < n ; ++i) {
+        int32_t s = SYNTH_WAVE[p0 >> SHIFT];
+        p0 += i0;
+        if (R > 1) {
+            s += SYNTH_WAVE[p1 >> SHIFT];
+            p1 += i1;
+        }
+        if (R > 2) {
+            s += SYNTH_WAVE[p2 >> SHIFT];
+            p2 += i2;
+        }
+        // |s| < 3 * 2^15, level Q14 => fits 31 bits
+        acc[i] += (s * (g >> 16)) >> 14;
+        g += dg;
+    }
+    v.phase[0] = p0;
+    v.phase[1] = p1;
+    v.phase[2] = p2;
+}
+
+void synth_render(int16_t* out, size_t n) {
+    if (n > SYNTH_BLOCK_MAX) n = SYNTH_BLOCK_MAX;
+    bool any = false;
+    for (size_t k = 0 ; k < SYNTH_VOICE_n ; ++k) {
+        SynthVoice& v = synth_voice[k];
+        int32_t level = v.level;
+        int32_t target = v.target;
+        if (!target && !level) continue;
+        if (!any) {
+            memset(synth_acc, 0, n * sizeof(synth_acc[0]));
+            any = true;
+        }
+        int32_t end = synth_ramp(level, target, n);
+        int32_t dg = (end - level) / (int32_t)n;
+        switch (v.reeds) {
+        case 1:
+            synth_mix<1>(v, synth_acc, n, level, dg);
+            break;
+        case 2:
+            synth_mix<2>(v, synth_acc, n, level, dg);
+            break;
+        default:
+            synth_mix<3>(v, synth_acc, n, level, dg);
+            break;
+        }
+        v.level = end;
+    }
+
+    int32_t m = synth_master;
+    int32_t m_end = synth_master_target;
+    synth_master = m_end;
+    if (!any) {
+        memset(out, 0, n * sizeof(out[0]));
+        return;
+    }
+    int32_t dm = (m_end - m) / (int32_t)n;
+    for (size_t i = 0 ; i < n ; ++i) {
+        // headroom for 4 voices at full level; pressure Q15 => fits 31 bits
+        int32_t s = ((synth_acc[i] >> 2) * (m >> 15)) >> 15;
+        if (s > 32767) s = 32767;
+        if (s < -32768) s = -32768;
+        out[i] = s;
+        m += dm;
+    }
+}
+
+
+////////////////////////////////////////
+// benchmark
+
+uint32_t synth_bench() {
+    synth_init();
+    synth_config(SYNTH_REED_MAX, 20);
+    for (uint8_t i = 0 ; i < SYNTH_VOICE_n ; ++i) {
+        MidiEvent e = midi_event(MIDI_EV_NOTE_ON, 0);
+        e.note = 48 + 5 * i;
+        e.velocity = 0xFFFF;
+        synth_event(e);
+    }
+    int16_t out[SYNTH_BLOCK_MAX];
+    synth_render(out, SYNTH_BLOCK_MAX);
+    uint32_t t0 = cyccnt();
+    synth_render(out, SYNTH_BLOCK_MAX);
+    uint32_t dt = cyccnt() - t0;
+    synth_init();
+    return dt;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "midi_event.hpp"
+
+// polyphonic wavetable synthesizer: practice without anything connected
+// - voices follow the note events of the key pipeline (see midi_event.hpp);
+//   velocity sets the level of the voice
+// - each voice: 1..SYNTH_REED_MAX reeds sharing the accordion-reed
+//   wavetable; the 2nd / 3rd reed is detuned up / down by `detune` cents
+//   (musette)
+// - amplitude: per-voice envelope (short attack and release against clicks)
+//   times a global pressure (e.g. bellows)
+// - fixed point: 32-bit phase accumulators (9-bit table index), levels and
+//   pressure Q30 (Q14 / Q15 per sample), 32-bit mix, output clipped to 16 bits
+// - rendered in blocks; levels ramp linearly across each block
+// - ownership: the thread assigns voices (note, pitch, target level), the
+//   renderer (ISR) owns phases and current levels => no locking; a voice is
+//   free once released and silent
+// NOTE: hardware-independent (host-buildable); output: see synth_pwm.hpp
+
+// Hz: divides the timer clock of every clock profile (8, 24, 48, 64, 72MHz)
+static const uint32_t SYNTH_RATE = 31250;
+
+// polyphony: beyond this, a voice is stolen (the quietest released one, else
+// the oldest held one)
+static const size_t SYNTH_VOICE_n = 8;
+static const uint8_t SYNTH_REED_MAX = 3;
+
+// samples per `synth_render` call at most
+static const size_t SYNTH_BLOCK_MAX = 64;
+
+// all voices off, pressure full, 1 reed
+void synth_init(void);
+
+// reeds per voice (1..SYNTH_REED_MAX), detune of the others (cents, 0..50)
+// NOTE: takes effect from the next note on
+void synth_config(uint8_t reeds, uint8_t detune_cents);
+
+// note on / off (other events are ignored)
+// NOTE: thread context (single caller)
+void synth_event(const MidiEvent& e);
+
+// release all voices
+void synth_all_off(void);
+
+// global amplitude (32-bit, see midi_event.hpp)
+void synth_pressure(uint32_t pressure);
+
+// render `n` (<= SYNTH_BLOCK_MAX) samples
+// NOTE: one caller (e.g. the output DMA interrupt)
+void synth_render(int16_t* out, size_t n);
+
+// voices assigned (held or still releasing)
+uint8_t synth_voices(void);
+
+// cycles to render a block of SYNTH_BLOCK_MAX samples with every voice held,
+// all reeds on (worst case; 0 on the host -- see Tools/synth_render.cpp)
+// NOTE: only while nothing renders (before the output starts); voices are
+// reset afterwards, like `synth_init`
+uint32_t synth_bench(void);
+
+// statistics
+extern volatile uint32_t synth_steals;
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t synth_ram_n;
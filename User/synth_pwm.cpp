@@ -0,0 +1,138 @@
+#include "synth_pwm.hpp"
+
+#include "stm32f1xx_hal.h"
+
+#include "clock.hpp"
+#include "synth.hpp"
+
+
+////////////////////////////////////////
+// hardware resources
+
+#define SYNTH_TIM TIM4
+#define SYNTH_DMA_IRQn DMA1_Channel1_IRQn
+
+// not generated by CubeMX (TIM4 is set up here)
+// NOTE: referenced by DMA1_Channel1_IRQHandler
+extern "C" DMA_HandleTypeDef hdma_tim4_ch1;
+DMA_HandleTypeDef hdma_tim4_ch1;
+
+
+////////////////////////////////////////
+// buffer
+
+// compare values (duty cycle), two halves of SYNTH_BLOCK_MAX
+static uint16_t synth_buf[2 * SYNTH_BLOCK_MAX];
+const uint16_t synth_pwm_ram_n = sizeof(synth_buf);
+
+// timer counts per sample (ARR + 1); 0: not running
+static volatile uint16_t synth_top = 0;
+
+// render into one half: samples first, then scaled in place to 0..top-1
+// NOTE: a compare value above ARR never matches => no more DMA requests
+static void synth_fill(uint16_t* half) {
+    int16_t* s = (int16_t*)half;
+    synth_render(s, SYNTH_BLOCK_MAX);
+    uint32_t top = synth_top;
+    for (size_t i = 0 ; i < SYNTH_BLOCK_MAX ; ++i) {
+        half[i] = ((uint32_t)(s[i] + 0x8000) * top) >> 16;
+    }
+}
+
+static void synth_half_cb(DMA_HandleTypeDef* hdma) {
+    synth_fill(synth_buf);
+}
+
+static void synth_cplt_cb(DMA_HandleTypeDef* hdma) {
+    synth_fill(synth_buf + SYNTH_BLOCK_MAX);
+}
+
+// (re)start from silence at the given timer clock
+// NOTE: IRQs masked
+static void synth_start(uint32_t tim_freq) {
+    SYNTH_TIM->CR1 &= ~TIM_CR1_CEN;
+    HAL_DMA_Abort(&hdma_tim4_ch1);
+    DMA1->IFCR = DMA_IFCR_CGIF1;
+    HAL_NVIC_ClearPendingIRQ(SYNTH_DMA_IRQn);
+
+    uint16_t top = tim_freq / SYNTH_RATE;
+    synth_top = top;
+    for (size_t i = 0 ; i < 2 * SYNTH_BLOCK_MAX ; ++i) synth_buf[i] = top / 2;
+    SYNTH_TIM->ARR = top - 1;
+    SYNTH_TIM->CCR1 = top / 2;
+    // load ARR / CCR1 from their preload registers, clear the counter
+    SYNTH_TIM->EGR = TIM_EGR_UG;
+    SYNTH_TIM->SR = 0;
+
+    HAL_DMA_Start_IT(&hdma_tim4_ch1, (uint32_t)synth_buf, (uint32_t)&SYNTH_TIM->CCR1, 2 * SYNTH_BLOCK_MAX);
+    SYNTH_TIM->CR1 |= TIM_CR1_CEN;
+}
+
+
+////////////////////////////////////////
+// setup
+
+static void synth_dma_init() {
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    hdma_tim4_ch1.Instance = DMA1_Channel1;
+    hdma_tim4_ch1.Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma_tim4_ch1.Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma_tim4_ch1.Init.MemInc = DMA_MINC_ENABLE;
+    hdma_tim4_ch1.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    hdma_tim4_ch1.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    hdma_tim4_ch1.Init.Mode = DMA_CIRCULAR;
+    hdma_tim4_ch1.Init.Priority = DMA_PRIORITY_LOW;
+    HAL_DMA_Init(&hdma_tim4_ch1);
+    hdma_tim4_ch1.XferHalfCpltCallback = synth_half_cb;
+    hdma_tim4_ch1.XferCpltCallback = synth_cplt_cb;
+
+    // rendering takes a while, but has a whole half buffer of time: let
+    // everything else go first
+    HAL_NVIC_SetPriority(SYNTH_DMA_IRQn, 7, 0);
+    HAL_NVIC_EnableIRQ(SYNTH_DMA_IRQn);
+}
+
+static void synth_tim_init() {
+    __HAL_RCC_GPIOB_CLK_ENABLE();
+    __HAL_RCC_TIM4_CLK_ENABLE();
+
+    GPIO_InitTypeDef gpio;
+    gpio.Pin = GPIO_PIN_6;
+    gpio.Mode = GPIO_MODE_AF_PP;
+    gpio.Pull = GPIO_NOPULL;
+    gpio.Speed = GPIO_SPEED_FREQ_LOW;
+    HAL_GPIO_Init(GPIOB, &gpio);
+
+    SYNTH_TIM->CR1 = TIM_CR1_ARPE; // up, edge-aligned
+    SYNTH_TIM->PSC = 0;
+    // CC1: PWM mode 1 (high while CNT < CCR1), preloaded => one new duty
+    // cycle per period
+    SYNTH_TIM->CCMR1 = TIM_CCMR1_OC1M_2 | TIM_CCMR1_OC1M_1 | TIM_CCMR1_OC1PE;
+    SYNTH_TIM->CCER = TIM_CCER_CC1E;
+    // DMA request on compare match: the next value is loaded well before
+    // the update event that applies it
+    SYNTH_TIM->DIER = TIM_DIER_CC1DE;
+}
+
+
+////////////////////////////////////////
+// public interface
+
+void synth_pwm_init() {
+    synth_dma_init();
+    synth_tim_init();
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    synth_start(clock_tim_freq(SYNTH_TIM));
+    __set_PRIMASK(primask);
+}
+
+void synth_pwm_retime(uint32_t tim_freq) {
+    if (!synth_top) return; // not initialized
+    // samples already queued are scaled for the old period: start over
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    synth_start(tim_freq);
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// synthesizer output (see synth.hpp): PWM on PB6 (TIM4 channel 1)
+// - carrier frequency = SYNTH_RATE: each compare match requests the duty
+//   cycle of the next period from a circular buffer of two blocks (DMA1
+//   channel 1, TIM4_CH1 request)
+// - each half-transfer / transfer-complete interrupt renders the half just
+//   played => 2ms of slack, lowest interrupt priority
+// - resolution: timer clock / SYNTH_RATE steps (72MHz: 2304 ~ 11 bits,
+//   24MHz: 768, HSI: 256)
+// - needs a low-pass filter (e.g. RC 1k / 10nF, 2nd order for less carrier)
+//   and an amplifier on the pin
+// NOTE: a clock profile switch restarts the output (~2ms of silence)
+
+void synth_pwm_init(void);
+
+// adapt to a new timer input clock frequency (Hz)
+void synth_pwm_retime(uint32_t tim_freq);
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t synth_pwm_ram_n;
@@ -0,0 +1,48 @@
+#include "ump.hpp"
+
+
+static const uint8_t MT_MIDI2 = 0x4;
+
+// MIDI 2.0 channel voice message: status, 2 index bytes, 32-bit data
+static size_t midi2(uint32_t out[UMP_WORD_MAX], const MidiEvent& e, uint8_t status, uint8_t b2, uint8_t b3, uint32_t data) {
+    out[0] = ((uint32_t)MT_MIDI2 << 28)
+        | ((uint32_t)(e.group & 0xF) << 24)
+        | ((uint32_t)status << 20)
+        | ((uint32_t)(e.channel & 0xF) << 16)
+        | ((uint32_t)b2 << 8)
+        | b3;
+    out[1] = data;
+    return 2;
+}
+
+size_t ump_encode(const MidiEvent& e, uint32_t out[UMP_WORD_MAX]) {
+    uint8_t note = e.note & 0x7F;
+    switch (e.type) {
+    case MIDI_EV_NOTE_OFF:
+        return midi2(out, e, 0x8, note, e.attr_type, ((uint32_t)e.velocity << 16) | e.attr);
+    case MIDI_EV_NOTE_ON:
+        return midi2(out, e, 0x9, note, e.attr_type, ((uint32_t)e.velocity << 16) | e.attr);
+    case MIDI_EV_POLY_PRESSURE:
+        return midi2(out, e, 0xA, note, 0, e.value);
+    case MIDI_EV_RPN:
+        return midi2(out, e, 0x2, (e.param >> 7) & 0x7F, e.param & 0x7F, e.value);
+    case MIDI_EV_CONTROL:
+        return midi2(out, e, 0xB, e.ctl & 0x7F, 0, e.value);
+    case MIDI_EV_CHANNEL_PRESSURE:
+        return midi2(out, e, 0xD, 0, 0, e.value);
+    case MIDI_EV_PITCH_BEND:
+        return midi2(out, e, 0xE, 0, 0, e.value);
+    default:
+        return 0;
+    }
+}
+
+size_t ump_bytes(const uint32_t* words, size_t n, uint8_t* out) {
+    for (size_t i = 0 ; i < n ; ++i) {
+        out[4 * i + 0] = words[i] >> 24;
+        out[4 * i + 1] = words[i] >> 16;
+        out[4 * i + 2] = words[i] >> 8;
+        out[4 * i + 3] = words[i];
+    }
+    return 4 * n;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "midi_event.hpp"
+
+// Universal MIDI Packet (MIDI 2.0) serialization of events
+// (see midi_event.hpp)
+// - MIDI 2.0 channel voice messages (message type 4, 64-bit): full
+//   resolution, note attributes and group carried as is
+// - RPN: registered controller message (a single packet)
+// - byte links: words are sent big-endian (`ump_bytes`)
+// NOTE: hardware-independent (host-buildable)
+
+static const size_t UMP_WORD_MAX = 2; // longest packet produced (words)
+
+// return: number of words written to `out` (0: not encodable)
+size_t ump_encode(const MidiEvent& e, uint32_t out[UMP_WORD_MAX]);
+
+// words => bytes (big-endian, 4 per word); return: number of bytes
+size_t ump_bytes(const uint32_t* words, size_t n, uint8_t* out);
@@ -0,0 +1,178 @@
+#pragma once
+
+// build-time options for user code
+// NOTE: preprocessor-only -- also included by the scatter file (MDK-ARM/firmware.sct)
+
+
+////////////////////////////////////////
+// code placement
+
+// USER_RAMFUNC: execute hot paths (scan ISR, debouncing, event enqueue,
+// UART/DMA IRQ handlers) from SRAM instead of FLASH (see ramfunc.h)
+#ifndef USER_RAMFUNC
+#   define USER_RAMFUNC 1
+#endif
+
+// USER_VTOR_RAM: relocate the vector table to SRAM (see vtor.hpp)
+#ifndef USER_VTOR_RAM
+#   define USER_VTOR_RAM 1
+#endif
+
+
+////////////////////////////////////////
+// key scanning
+
+// USER_KEYMAT_VOTE: sample each row 3 times and keep the bitwise majority
+// (see keymat_conf.hpp) => a single-sample spike never reaches the debouncer
+// - samples 2us apart, the last (as otherwise the only one) 19us after the
+//   row switch; voted: 15, 17, 19us
+// - row / field period unchanged (20 / 200us); the DMA buffer grows 10x
+//   (80 => 800 bytes) as every 2us sample is captured
+// - uses TIM3 to count the reads requested: scanning restarts if one was
+//   ever lost (see keymat.cpp)
+// otherwise: one sample per row
+#ifndef USER_KEYMAT_VOTE
+#   define USER_KEYMAT_VOTE 0
+#endif
+
+
+////////////////////////////////////////
+// clocking
+
+// USER_CLOCK_SCALING: run at the FULL clock profile while playing, drop to the
+// IDLE profile after USER_CLOCK_IDLE_TIMEOUT_ms without key activity (see clock.hpp)
+// otherwise: stay at FULL
+#ifndef USER_CLOCK_SCALING
+#   define USER_CLOCK_SCALING 1
+#endif
+#ifndef USER_CLOCK_IDLE_TIMEOUT_ms
+#   define USER_CLOCK_IDLE_TIMEOUT_ms 3000
+#endif
+
+
+////////////////////////////////////////
+// low-power idle
+
+// USER_SLEEP_MODE: what to do after USER_SLEEP_TIMEOUT_ms without key activity
+// (see power.hpp)
+// - 0: nothing (keep scanning)
+// - 1: SLEEP (CPU halted, clocks running)
+// - 2: STOP (all clocks stopped, regulator in low-power mode); falls back to
+//   SLEEP with USER_MIDI_IN or USER_HOSTLINK (their input would be lost)
+#ifndef USER_SLEEP_MODE
+#   define USER_SLEEP_MODE 2
+#endif
+#ifndef USER_SLEEP_TIMEOUT_ms
+#   define USER_SLEEP_TIMEOUT_ms 60000
+#endif
+
+
+////////////////////////////////////////
+// runtime
+
+// USER_RTOS: run the event pipeline as an RTOS thread (CMSIS-RTOS)
+// otherwise: bare-metal superloop (ISR => ring => WFI loop => DMA UART)
+#ifndef USER_RTOS
+#   define USER_RTOS 1
+#endif
+
+
+////////////////////////////////////////
+// output timing
+
+// USER_SCHED_FIXED_LATENCY: release every key event to the wire exactly
+// USER_SCHED_DELAY_us after it was sampled (see sched.hpp)
+// - trades a constant latency for (almost) zero jitter
+// - delay must cover worst-case processing + UART backlog (3 bytes @ 115200
+//   baud = 260us each); late messages go out as soon as possible
+// otherwise: send as soon as processed
+#ifndef USER_SCHED_FIXED_LATENCY
+#   define USER_SCHED_FIXED_LATENCY 0
+#endif
+#ifndef USER_SCHED_DELAY_us
+#   define USER_SCHED_DELAY_us 1500
+#endif
+
+
+////////////////////////////////////////
+// MIDI input
+
+// USER_MIDI_IN: receive MIDI input (USART3 RX)
+// - merged into the output (see midi_thru.hpp; can be turned off at run time)
+// - SysEx configuration (see settings_sysex.hpp)
+// otherwise: input is not received at all
+#ifndef USER_MIDI_IN
+#   define USER_MIDI_IN 1
+#endif
+
+
+////////////////////////////////////////
+// expression
+
+// USER_BELLOWS: bellows pressure sensor on PB0 (see bellows.hpp), sent as a
+// continuous controller (see expr.hpp)
+// NOTE: leave off without the sensor -- a floating input would send noise
+#ifndef USER_BELLOWS
+#   define USER_BELLOWS 0
+#endif
+
+
+////////////////////////////////////////
+// host link
+
+// USER_HOSTLINK: binary packet link to our host software on USART2 (see
+// hostlink.hpp) at USER_HOSTLINK_BAUD
+// - MIDI 2.0 output (UMP) alongside the MIDI 1.0 output
+// - telemetry on request, settings (same commands as SysEx) as bulk data
+// NOTE: PCLK1 is 24-36MHz (see clock.hpp): up to 1.5Mbaud on every profile
+// but HSI; 1Mbaud divides all of them exactly
+#ifndef USER_HOSTLINK
+#   define USER_HOSTLINK 1
+#endif
+#ifndef USER_HOSTLINK_BAUD
+#   define USER_HOSTLINK_BAUD 1000000
+#endif
+
+
+////////////////////////////////////////
+// synthesizer
+
+// USER_SYNTH: play the notes on a built-in synthesizer, PWM output on PB6
+// (see synth.hpp, synth_pwm.hpp), USER_SYNTH_REEDS reeds per note, the
+// others detuned by USER_SYNTH_DETUNE_cents (musette); follows the bellows
+// NOTE: the pin needs a low-pass filter and an amplifier -- off by default
+// (drives PB6, and adds a DMA interrupt about every 1ms, which also keeps
+// waking the core from SLEEP)
+#ifndef USER_SYNTH
+#   define USER_SYNTH 0
+#endif
+#ifndef USER_SYNTH_REEDS
+#   define USER_SYNTH_REEDS 3
+#endif
+#ifndef USER_SYNTH_DETUNE_cents
+#   define USER_SYNTH_DETUNE_cents 15
+#endif
+
+
+////////////////////////////////////////
+// diagnostics
+
+// USER_BENCH: benchmark debouncing once at startup, before scanning starts
+// (see keymat_bench.hpp; ~20ms), and a synthesizer block at full polyphony
+// (see synth.hpp); results go out with the telemetry
+// USER_BENCH_BUDGET_PCT: pass if the worst field takes at most this share of
+// the field period (the rest is for everything else running)
+#ifndef USER_BENCH
+#   define USER_BENCH 1
+#endif
+#ifndef USER_BENCH_BUDGET_PCT
+#   define USER_BENCH_BUDGET_PCT 25
+#endif
+
+// USER_WCET_THRES_us: capture the context (field, keys changed, events
+// queued) whenever an interrupt handler runs longer than this (see
+// cpuload.h; 0: off); initial value for every source, can be changed per
+// source over the host link
+#ifndef USER_WCET_THRES_us
+#   define USER_WCET_THRES_us 50
+#endif
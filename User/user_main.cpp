@@ -4,101 +4,697 @@
 #include "usart.h"
 #include "gpio.h"
 
-#include "cmsis_os.h"
-
 #include <string.h>
 
+#include "user_conf.h"
+#include "bellows.hpp"
+#include "clock.hpp"
+#include "coupler.hpp"
+#include "cpuload.h"
+#include "cyccnt.h"
+#include "expr.hpp"
+#include "flash_stm32.hpp"
+#include "flash_store.hpp"
+#include "hostlink.hpp"
+#include "power.hpp"
+#include "ram.hpp"
+#include "ramfunc.h"
+#include "ring.hpp"
+#include "vtor.hpp"
+
+#if USER_RTOS
+#   include "cmsis_os.h"
+#endif // USER_RTOS
+
+#include "keymap.hpp"
 #include "keymat.hpp"
+#include "keymat_bench.hpp"
+#include "midi1.hpp"
+#include "midi_event.hpp"
+#include "midi_out.hpp"
+#include "midi_in.hpp"
+#include "midi_thru.hpp"
+#include "mpe.hpp"
+#include "note.hpp"
+#include "sched.hpp"
+#include "settings.hpp"
+#include "scope.hpp"
+#include "settings_sysex.hpp"
+#include "synth.hpp"
+#include "synth_pwm.hpp"
+#include "ump.hpp"
 
 
 ////////////////////////////////////////
-// UART (simple helpers)
+// key event handling
 
-static const size_t N_BUF = 64;
-static char buf[N_BUF];
-static void send_1(unsigned char c) {
-    HAL_UART_Transmit(&huart3, &c, 1, HAL_MAX_DELAY);
+enum KeyEventType : uint8_t {
+    KEY_EVENT_KEY,
+    KEY_EVENT_MIDI_IN, // wake-up only: MIDI input available
+    KEY_EVENT_EXPR,    // wake-up only: new expression (bellows) value
+    KEY_EVENT_HOST,    // wake-up only: host link input / scan stream output
+    KEY_EVENT_TYPE_n,
+};
+
+struct KeyEvent {
+    KeyEventType type;
+    NoteKey note;
+    uint32_t t_detect; // cycle count at detection (for latency measurement)
+    uint16_t t_sample; // time the key was sampled (us, see sched.hpp)
+};
+
+// time the current field was completed (us)
+static uint16_t field_t = 0;
+
+// apply settings changed since the last field
+static void settings_activate() {
+    note_settings_activate();
+    midi_thru_enabled = settings().thru;
 }
-static void send_len() {
-    HAL_UART_Transmit(&huart3, (uint8_t*)buf, strlen(buf), HAL_MAX_DELAY);
+
+// forward decl
+static void key_event_wake(KeyEventType type);
+
+RAMFUNC static void key_field_handler() {
+    // NOTE: before any event of this field -- a field sees either the old or
+    // the new settings as a whole
+    if (settings_field()) settings_activate();
+#if USER_BELLOWS
+    if (bellows_field()) key_event_wake(KEY_EVENT_EXPR);
+#endif // USER_BELLOWS
+#if USER_SCHED_FIXED_LATENCY
+    field_t = sched_now();
+#endif // USER_SCHED_FIXED_LATENCY
 }
-static void send_n(size_t n) {
-    HAL_UART_Transmit(&huart3, (uint8_t*)buf, n, HAL_MAX_DELAY);
+
+// when a key in row `ri` of the current field was actually sampled
+// NOTE: removes the dependency of output timing on row position
+static uint16_t key_sample_time(uint8_t ri) {
+    return field_t - (KEYMAT_ROW_n - 1 - ri) * KEYMAT_ROW_PERIOD_Tus;
 }
 
+// key events in flight (ISR => main thread)
+// NOTE: static in both builds -- nothing is allocated at run time; a full
+// queue drops the event (as a full mail pool used to)
+static const uint8_t KEY_EVENT_n = 8;
+static Ring<KeyEvent, KEY_EVENT_n> key_events;
+const uint16_t user_ram_n = sizeof(key_events);
 
-////////////////////////////////////////
-// key event handling
+#if USER_RTOS
+// the main thread waits for this signal: key event queued, or wake-up
+static const int32_t KEY_EVENT_SIGNAL = 0x0001;
+static osThreadId main_thread;
 
-// default (hardcoded) mapping: Bayan (B-griff)
-static_assert(KEYMAT_ROW_n == 10, "current mapping assumes 10 rows");
-static_assert(KEYMAT_COL_n == 10, "current mapping assumes 10 cols");
-typedef uint8_t keycode_t;
-keycode_t mapping[KEYMAT_ROW_n][KEYMAT_COL_n] = {
-    {34, 40, 46, 52, 58, 64, 70, 76, 82, 88}, // A# E
-    {37, 43, 49, 55, 61, 67, 73, 79, 85, 91}, // C# G
-    {35, 41, 47, 53, 59, 65, 71, 77, 83, 89}, // B  F
-    {38, 44, 50, 56, 62, 68, 74, 80, 86, 92}, // D  G#
-    {33, 39, 45, 51, 57, 63, 69, 75, 81, 87}, // A  D#
-    {36, 42, 48, 54, 60, 66, 72, 78, 84, 90}, // C  F#
-    {34, 40, 46, 52, 58, 64, 70, 76, 82, 88}, // A# E
-    {37, 43, 49, 55, 61, 67, 73, 79, 85, 91}, // C# G
-    {32, 38, 44, 50, 56, 62, 68, 74, 80, 86}, // G# D
-    {35, 41, 47, 53, 59, 65, 71, 77, 83, 89}, // B  F
-};
+static void key_event_init() {
+    main_thread = osThreadGetId();
+}
 
-struct KeyEvent {
-    keycode_t keycode;
-    bool state;
+static void key_event_signal() {
+    osSignalSet(main_thread, KEY_EVENT_SIGNAL);
+}
+#else
+static void key_event_init() {}
+
+// NOTE: the interrupt itself has already woken the superloop
+static void key_event_signal() {}
+#endif // USER_RTOS
+
+static uint8_t key_event_depth() {
+    return key_events.size();
+}
+
+// NOTE: callback from ISR -- cannot wait
+RAMFUNC static void key_event_handler(uint8_t ri, uint8_t ci, bool state) {
+    KeyEvent e;
+    if (!note_key(ri, ci, state, e.note)) return;
+    e.type = KEY_EVENT_KEY;
+    e.t_detect = cyccnt();
+    e.t_sample = key_sample_time(ri);
+    if (key_events.push(e)) key_event_signal();
+}
+
+// wake-ups pending, by type
+static volatile bool key_event_posted[KEY_EVENT_TYPE_n];
+
+// wake up the main thread (no payload)
+// NOTE: ISR -- cannot wait
+static void key_event_wake(KeyEventType type) {
+    if (key_event_posted[type]) return;
+    key_event_posted[type] = true;
+    key_event_signal();
+}
+
+// woken (and clear)
+static bool key_event_woken(KeyEventType type) {
+    if (!key_event_posted[type]) return false;
+    key_event_posted[type] = false;
+    return true;
+}
+
+#if USER_MIDI_IN
+// NOTE: callback from ISR -- cannot wait
+static void midi_in_handler() {
+    key_event_wake(KEY_EVENT_MIDI_IN);
+    power_wake();
+}
+
+// SysEx configuration (see settings_sysex.hpp)
+static bool sysex_handler(const uint8_t* data, size_t n) {
+    static uint8_t reply[SETTINGS_SYSEX_REPLY_n];
+    size_t reply_n;
+    if (!settings_sysex(data, n, reply, reply_n)) return false;
+    // NOTE: never waits for room -- the host retries when a reply is missing
+    if (reply_n) midi_out_send(reply, reply_n);
+    // broadcast: for the instruments down the chain as well
+    return !settings_sysex_broadcast(data, n);
+}
+#endif // USER_MIDI_IN
+
+// detection => handed to the UART
+volatile uint32_t event_latency_us_last = 0;
+volatile uint32_t event_latency_us_max = 0;
+
+// startup benchmark (see user_conf.h)
+static KeymatBenchResult bench[KEYMAT_BENCH_n];
+static uint32_t bench_period_cycles = 0; // field period
+static uint32_t bench_synth_cycles = 0; // synthesizer block
+
+static void bench_run() {
+#if USER_BENCH
+    for (uint8_t i = 0 ; i < KEYMAT_BENCH_n ; ++i) {
+        keymat_bench_run((keymat_bench_pattern_t)i, bench[i]);
+    }
+    bench_period_cycles = SystemCoreClock / 1000000 * KEYMAT_FIELD_PERIOD_Tus;
+#if USER_SYNTH
+    bench_synth_cycles = synth_bench();
+#endif // USER_SYNTH
+#endif // USER_BENCH
+}
+
+// worst-case handler times (see cpuload.h): context when over the threshold
+// NOTE: a snapshot may be torn if the thread reads it while a trigger writes it
+struct WcetSnapshot {
+    uint32_t tick;      // ms
+    uint32_t field;     // `keymat_fields`
+    uint32_t ns;        // handler run time
+    uint8_t irq;        // cpuload_irq_t
+    uint8_t changes;    // keys changed in the last field
+    uint8_t queue;      // key events queued
 };
-osMailQDef(key_events, 8, KeyEvent);
-osMailQId key_events;
+static WcetSnapshot wcet_last;
+static WcetSnapshot wcet_worst;
 
-static void key_event_init() {
-    key_events = osMailCreate(osMailQ(key_events), NULL);
+// NOTE: callback from ISR -- cannot wait
+static void wcet_trigger(cpuload_irq_t irq, uint32_t ns) {
+    WcetSnapshot w = {HAL_GetTick(), keymat_fields, ns, (uint8_t)irq, keymat_field_changes, key_event_depth()};
+    wcet_last = w;
+    if (ns > wcet_worst.ns) wcet_worst = w;
+}
+
+// threshold for a source (us; 0: off)
+static void wcet_set_threshold(uint8_t irq, uint32_t us) {
+    cpuload_set_thres((cpuload_irq_t)irq, us);
+}
+
+static void wcet_init() {
+    for (uint8_t i = 0 ; i < CPULOAD_IRQ_n ; ++i) wcet_set_threshold(i, USER_WCET_THRES_us);
+    // renders a whole block per interrupt: only of interest when it gets
+    // close to the time it has (half the output buffer)
+    wcet_set_threshold(CPULOAD_SYNTH, SYNTH_BLOCK_MAX * 1000000 / SYNTH_RATE / 2);
+    cpuload_trigger = wcet_trigger;
 }
 
+#if USER_HOSTLINK
 // NOTE: callback from ISR -- cannot wait
-static void key_event_handler(uint8_t ri, uint8_t ci, bool state) {
-    KeyEvent* e = (KeyEvent*)osMailAlloc(key_events, 0);
-    if (!e) return;
-    e->keycode = mapping[ri][ci];
-    e->state = state;
-    osMailPut(key_events, e);
+// NOTE: while the scan is streamed, this keeps the instrument awake
+static void hostlink_handler() {
+    key_event_wake(KEY_EVENT_HOST);
+    power_wake();
+}
+
+static uint8_t* put32(uint8_t* p, uint32_t v) {
+    p[0] = v; p[1] = v >> 8; p[2] = v >> 16; p[3] = v >> 24;
+    return p + 4;
+}
+
+// telemetry snapshot: version, then little-endian 32-bit counters
+// - startup benchmark (field period in cycles, budget %, then mean / max
+//   cycles per pattern; all 0 without USER_BENCH)
+// - CPU load (last, max in 0.1%), then accumulated cycles: thread, each
+//   interrupt source (see cpuload.h)
+// - worst case: longest run of each interrupt source (ns), triggers,
+//   then the worst and the last trigger snapshot (tick, field, ns,
+//   source | changed keys << 8 | queued events << 16)
+// - RAM (bytes, see ram.hpp): main stack size, least free space on the main
+//   stack and on the main thread stack, static data, spare; then the number
+//   of budget entries and their sizes (16-bit each)
+// - synthesizer benchmark: cycles per block (0 without USER_BENCH /
+//   USER_SYNTH)
+// - scan restarts, column reads out of step (USER_KEYMAT_VOTE)
+static const uint8_t TELEMETRY_VERSION = 9;
+
+static uint8_t* put_wcet(uint8_t* p, const WcetSnapshot& w) {
+    p = put32(p, w.tick);
+    p = put32(p, w.field);
+    p = put32(p, w.ns);
+    return put32(p, w.irq | (w.changes << 8) | (w.queue << 16));
+}
+
+static void telemetry_send() {
+    static const size_t BUDGET_MAX = 14;
+    uint8_t buf[1 + 4 * (12 + 2 + 2 * KEYMAT_BENCH_n + 3 + CPULOAD_IRQ_n + CPULOAD_IRQ_n + 1 + 2 * 4 + 5) + 1 + 2 * BUDGET_MAX + 4 + 4];
+    static_assert(sizeof(buf) <= HOSTLINK_PAYLOAD_n, "");
+    uint8_t* p = buf;
+    *p++ = TELEMETRY_VERSION;
+    p = put32(p, HAL_GetTick());
+    p = put32(p, event_latency_us_last);
+    p = put32(p, event_latency_us_max);
+    p = put32(p, keymat_field_cycles_max);
+#if USER_MIDI_IN
+    p = put32(p, midi_in_overruns);
+#else
+    p = put32(p, 0);
+#endif // USER_MIDI_IN
+    p = put32(p, mpe_steals);
+    p = put32(p, flash_store_errors);
+    p = put32(p, hostlink_preempts);
+    p = put32(p, hostlink_tx_drops);
+    p = put32(p, hostlink_rx_overruns);
+    p = put32(p, hostlink_rx.errors);
+    p = put32(p, scope_lost);
+    p = put32(p, bench_period_cycles);
+    p = put32(p, bench_period_cycles ? USER_BENCH_BUDGET_PCT : 0);
+    for (uint8_t i = 0 ; i < KEYMAT_BENCH_n ; ++i) {
+        p = put32(p, bench[i].cycles_mean);
+        p = put32(p, bench[i].cycles_max);
+    }
+    p = put32(p, cpuload_permille_last);
+    p = put32(p, cpuload_permille_max);
+    p = put32(p, cpuload_thread_cycles);
+    for (uint8_t i = 0 ; i < CPULOAD_IRQ_n ; ++i) p = put32(p, cpuload_irq_cycles[i]);
+    for (uint8_t i = 0 ; i < CPULOAD_IRQ_n ; ++i) p = put32(p, cpuload_irq_max[i]);
+    p = put32(p, cpuload_triggers);
+    p = put_wcet(p, wcet_worst);
+    p = put_wcet(p, wcet_last);
+    p = put32(p, ram_stack_size(RAM_STACK_MAIN));
+    p = put32(p, ram_stack_free(RAM_STACK_MAIN));
+    p = put32(p, ram_stack_free(RAM_STACK_THREAD));
+    p = put32(p, ram_data_bytes());
+    p = put32(p, ram_spare_bytes());
+    uint8_t budget_n = ram_budget_n < BUDGET_MAX ? ram_budget_n : BUDGET_MAX;
+    *p++ = budget_n;
+    for (uint8_t i = 0 ; i < budget_n ; ++i) {
+        uint16_t bytes = *ram_budget[i].bytes;
+        *p++ = bytes;
+        *p++ = bytes >> 8;
+    }
+    p = put32(p, bench_synth_cycles);
+    p = put32(p, keymat_resyncs);
+    hostlink_send(HOSTLINK_CH_TELEMETRY, buf, p - buf);
+}
+
+// host => device frames
+// - TELEMETRY: any frame requests a snapshot; with 5 bytes, it first sets the
+//   worst-case trigger threshold of a source: | source | us (4, LE; 0: off) |
+// - BULK: settings commands (SysEx messages, see settings_sysex.hpp), replied
+//   to on the same channel
+// - SCAN: start (1) / stop (0) the raw scan stream
+static void hostlink_frame_handler(uint8_t ch, const uint8_t* data, size_t n) {
+    switch (ch) {
+    case HOSTLINK_CH_TELEMETRY:
+        if (n == 5) wcet_set_threshold(data[0], data[1] | (data[2] << 8) | (data[3] << 16) | ((uint32_t)data[4] << 24));
+        telemetry_send();
+        break;
+    case HOSTLINK_CH_BULK: {
+        static uint8_t reply[SETTINGS_SYSEX_REPLY_n];
+        size_t reply_n;
+        if (settings_sysex(data, n, reply, reply_n) && reply_n) {
+            hostlink_send(HOSTLINK_CH_BULK, reply, reply_n);
+        }
+        break;
+    }
+    case HOSTLINK_CH_SCAN:
+        if (n >= 1 && data[0]) {
+            scope_start();
+        } else {
+            scope_stop();
+        }
+        break;
+    default:
+        break;
+    }
+}
+#endif // USER_HOSTLINK
+
+// release time of the notes being generated (see sched.hpp)
+static uint16_t note_t = 0;
+
+// MIDI 1.0 transport: one message to the wire
+static void note_send_midi1(const uint8_t* msg, size_t n) {
+#if USER_SCHED_FIXED_LATENCY
+    while (!sched_send(note_t, msg, n));
+#else
+    while (!midi_out_send(msg, n));
+#endif // USER_SCHED_FIXED_LATENCY
+}
+
+#if USER_HOSTLINK
+// MIDI 2.0 transport (UMP byte stream, see ump.hpp)
+// NOTE: never on the MIDI output (MIDI 1.0 receivers)
+// NOTE: dropped if the link is backed up (see `hostlink_tx_drops`) -- it
+// drains at 1Mbaud whether a host listens or not
+static void ump_send_hostlink(const uint8_t* data, size_t n) {
+    hostlink_send(HOSTLINK_CH_MIDI, data, n);
+}
+#endif // USER_HOSTLINK
+
+// note output settings changed (see `note_settings_update`)
+static void note_update() {
+#if USER_SCHED_FIXED_LATENCY
+    // NOTE: not earlier than anything already queued
+    note_t = sched_now() + USER_SCHED_DELAY_us;
+#endif // USER_SCHED_FIXED_LATENCY
+    note_settings_update();
+}
+
+
+
+////////////////////////////////////////
+// expression (continuous controllers)
+
+static const uint16_t BELLOWS_NRPN = 0x0080; // MSB 1, LSB 0
+
+static ExprDest expr_midi_out;
+static MidiEvent expr_ump_last; // last sent over UMP
+
+static void expr_send_midi_out(const uint8_t* msg, size_t n) {
+    while (!midi_out_send(msg, n));
+}
+
+static void expr_init() {
+    expr_dest_init(expr_midi_out, expr_send_midi_out, huart3.Init.BaudRate, EXPR_RES_AUTO);
+    expr_ump_last = midi_event(MIDI_EV_TYPE_n, 0);
+}
+
+// send whatever changed
+static void expr_update() {
+#if USER_BELLOWS
+    const Settings& s = settings();
+    if (expr_midi_out.res != s.expr_res) expr_dest_set_res(expr_midi_out, (expr_res_t)s.expr_res);
+    ExprCtl bellows = {s.bellows_cc, BELLOWS_NRPN};
+    // MPE: zone-wide, on the manager channel
+    MidiEvent e = midi_event(MIDI_EV_CONTROL, mpe_zone() ? 0 : s.channel);
+    e.ctl = s.bellows_cc;
+    e.value = midi_scale_up(bellows_value(), 14, 32);
+    expr_send(expr_midi_out, 0, bellows, e.channel, e.value);
+#if USER_SYNTH
+    synth_pressure(e.value);
+#endif // USER_SYNTH
+    // UMP: one packet at full resolution, whenever anything changed
+    if (e.type != expr_ump_last.type || e.channel != expr_ump_last.channel
+        || e.ctl != expr_ump_last.ctl || e.value != expr_ump_last.value) {
+        note_send_ump(e);
+        expr_ump_last = e;
+    }
+#endif // USER_BELLOWS
+}
+
+
+////////////////////////////////////////
+// key event processing
+
+static void key_event_process(const KeyEvent& e) {
+    note_update();
+    note_t = e.t_sample + USER_SCHED_DELAY_us;
+    note_key_play(e.note);
+
+    uint32_t dt = (cyccnt() - e.t_detect) / (SystemCoreClock / 1000000);
+    event_latency_us_last = dt;
+    if (dt > event_latency_us_max) event_latency_us_max = dt;
+}
+
+
+////////////////////////////////////////
+// inactivity handling
+
+static bool keys_released() {
+    for (size_t ri = 0 ; ri < KEYMAT_ROW_n ; ++ri) {
+        if (keymat_state[ri]) return false;
+    }
+    return true;
 }
 
+// learned debouncing thresholds (see `keymat_set_adaptive`): kept in the
+// settings, so that they survive a reboot
+// - copied into the staging settings and applied like any edit, then saved
+//   once active
+// - at most every LEARNED_SAVE_INTERVAL_ms: the thresholds keep moving a
+//   little while playing, each save wears the flash
+// NOTE: not while the host has unapplied edits -- they would go along
+static const uint32_t LEARNED_SAVE_INTERVAL_ms = 30 * 60 * 1000;
+static uint32_t learned_updates = 0;    // `keymat_adapt_updates` as copied
+static uint32_t learned_t = 0;          // ms, last copy
+static bool learned_saved = false;      // copied at least once
+static bool learned_save = false;       // copy applied, save when active
+
+static void learned_store() {
+    if (!settings().debounce_adapt || learned_save || settings_dirty()) return;
+    uint32_t updates = keymat_adapt_updates;
+    if (updates == learned_updates) return;
+    if (learned_saved && HAL_GetTick() - learned_t < LEARNED_SAVE_INTERVAL_ms) return;
+    Settings* s = settings_edit();
+    if (!s) return;
+    keymat_get_learned(&s->debounce_learned[0][0]);
+    if (!settings_apply()) {
+        settings_revert();
+        return;
+    }
+    learned_updates = updates;
+    learned_t = HAL_GetTick();
+    learned_saved = true;
+    learned_save = true;
+}
+
+static void learned_poll() {
+    if (learned_save && !settings_apply_pending() && settings_save()) learned_save = false;
+}
+
+// called after `timeout_ms` without key events
+// return: whether the idle time counter should restart
+static bool idle_handler(uint32_t idle_ms) {
+    // settings store: erasing a flash page stalls everything running from
+    // flash for ~20-40ms -- only while nothing is being played
+    if (keys_released()) {
+        learned_store();
+        flash_store_poll(true);
+    }
+#if USER_CLOCK_SCALING
+    // slow down (scanning continues)
+    // NOTE: not while the synthesizer sounds (e.g. a chord held): the clock
+    // switch restarts its output (see synth_pwm_retime) -- a click
+#if USER_SYNTH
+    if (!synth_voices())
+#endif // USER_SYNTH
+    clock_set_profile(CLOCK_PROFILE_IDLE);
+#endif // USER_CLOCK_SCALING
+#if USER_SLEEP_MODE
+    // stop scanning and sleep until the next key press
+    if (idle_ms >= USER_SLEEP_TIMEOUT_ms && power_sleep()) return true;
+#endif // USER_SLEEP_MODE
+    return false;
+}
+
+// first check for inactivity after this long
+#if USER_CLOCK_SCALING
+static const uint32_t idle_timeout_ms = USER_CLOCK_IDLE_TIMEOUT_ms;
+#elif USER_SLEEP_MODE
+static const uint32_t idle_timeout_ms = USER_SLEEP_TIMEOUT_ms;
+#else
+// still needed for background work (settings store)
+static const uint32_t idle_timeout_ms = USER_CLOCK_IDLE_TIMEOUT_ms;
+#endif
+
 
 ////////////////////////////////////////
 // main thread
 
+#if !USER_RTOS
+// no RTOS port to provide the tick
+extern "C" void SysTick_Handler() {
+    cpuload_irq_enter();
+    HAL_IncTick();
+    cpuload_irq_exit(CPULOAD_SYSTICK);
+}
+#endif // !USER_RTOS
+
 extern "C" void user_main() {
     HAL_GPIO_WritePin(GPIOC, GPIO_PIN_0, GPIO_PIN_SET);
 
+    ram_stack_paint();
+    cyccnt_init();
+    vtor_relocate();
+    clock_init();
+    clock_set_profile(CLOCK_PROFILE_FULL);
+
+#if USER_RTOS
     osKernelInitialize();
     osKernelStart();
+    // now running as the main thread (own stack)
+    ram_stack_paint();
+#endif // USER_RTOS
 
     HAL_GPIO_WritePin(GPIOC, GPIO_PIN_0, GPIO_PIN_RESET);
 
+    midi_out_init();
+#if USER_MIDI_IN
+    midi_in_callback = midi_in_handler;
+    midi_thru_sysex_callback = sysex_handler;
+    midi_in_init();
+#endif // USER_MIDI_IN
+#if USER_HOSTLINK
+    hostlink_notify = hostlink_handler;
+    hostlink_rx_callback = hostlink_frame_handler;
+    scope_notify = hostlink_handler;
+    hostlink_init(USER_HOSTLINK_BAUD);
+    note_ump_output = ump_send_hostlink;
+#endif // USER_HOSTLINK
+#if USER_SCHED_FIXED_LATENCY
+    sched_init();
+#endif // USER_SCHED_FIXED_LATENCY
     key_event_init();
+#if USER_BELLOWS
+    bellows_init();
+#endif // USER_BELLOWS
+    expr_init();
+    keymap_init();
+    coupler_init();
+    note_midi1_output = note_send_midi1;
+    coupler_output = note_output;
+    mpe_output = note_send;
+    settings_init();
+    flash_store_init(&flash_stm32);
+    settings_restore();
     keymat_init();
+    bench_run();
+#if USER_SYNTH
+    synth_init();
+    synth_config(USER_SYNTH_REEDS, USER_SYNTH_DETUNE_cents);
+    synth_pwm_init();
+#endif // USER_SYNTH
+    wcet_init();
+    settings_activate();
     keymat_callback = key_event_handler;
+    keymat_field_callback = key_field_handler;
     keymat_start();
 
     HAL_GPIO_WritePin(GPIOC, GPIO_PIN_0, GPIO_PIN_SET);
 
-    while (1) {
-        osEvent ose = osMailGet(key_events, osWaitForever);
-        if (ose.status == osEventMail) {
-            KeyEvent* e = (KeyEvent*)ose.value.p;
-
-            // NOTE: MIDI handling is hardcoded for now
-            buf[0] = (e->state ? 0x90 : 0x80); // use ch0
-            buf[1] = e->keycode;
-            buf[2] = 100; // use hard-coded velocity
-
-            osMailFree(key_events, e);
+    cpuload_busy();
+    uint32_t idle_ms = 0;
 
-            send_n(3); // blocking call
+#if USER_RTOS
+    uint32_t quiet_ms = 0; // waited without events since the last idle check
+    while (1) {
+        // background work pending (e.g. upstream input held back by local
+        // events, settings being written): retry shortly
+        bool busy = flash_store_busy();
+#if USER_MIDI_IN
+        busy = busy || midi_thru_pending();
+#endif // USER_MIDI_IN
+        uint32_t wait = busy ? 1 : idle_timeout_ms - quiet_ms;
+        cpuload_idle();
+        osEvent ose = osSignalWait(KEY_EVENT_SIGNAL, wait);
+        cpuload_busy();
+        if (ose.status == osEventTimeout) {
+            quiet_ms += wait;
+            if (quiet_ms >= idle_timeout_ms) {
+                quiet_ms = 0;
+                idle_ms += idle_timeout_ms;
+                if (idle_handler(idle_ms)) idle_ms = 0;
+            }
+        } else if (ose.status == osEventSignal) {
+            idle_ms = 0;
+            quiet_ms = 0;
+            // NOTE: an event queued from here on signals again
+            for (uint8_t i = KEY_EVENT_KEY + 1 ; i < KEY_EVENT_TYPE_n ; ++i) key_event_woken((KeyEventType)i);
+            KeyEvent e;
+            if (key_events.pop(e)) key_event_process(e);
+            // NOTE: switch after sending -- the first event goes out at
+            // IDLE speed rather than waiting for the PLL to relock
+            clock_set_profile(CLOCK_PROFILE_FULL);
+            while (key_events.pop(e)) key_event_process(e);
+        }
+#if USER_MIDI_IN
+        // after local events: these take priority over upstream input
+        midi_thru_poll();
+#endif // USER_MIDI_IN
+#if USER_HOSTLINK
+        hostlink_poll();
+        scope_poll();
+#endif // USER_HOSTLINK
+        learned_poll();
+        flash_store_poll(false);
+        note_update();
+        expr_update();
+        cpuload_update();
+    }
+#else
+    // superloop: ISR => ring => (here) => DMA UART
+    uint32_t t_last = HAL_GetTick();
+    while (1) {
+        KeyEvent e;
+        if (key_events.pop(e)) {
+            idle_ms = 0;
+            t_last = HAL_GetTick();
+            key_event_process(e);
+            clock_set_profile(CLOCK_PROFILE_FULL);
+            continue;
+        }
+#if USER_MIDI_IN
+        // after local events: these take priority over upstream input
+        // NOTE: upstream traffic also counts as activity (no sleep during thru)
+        if (key_event_woken(KEY_EVENT_MIDI_IN) || midi_in_available()) {
+            idle_ms = 0;
+            t_last = HAL_GetTick();
+        }
+        midi_thru_poll();
+#endif // USER_MIDI_IN
+#if USER_HOSTLINK
+        // NOTE: host traffic also counts as activity
+        if (key_event_woken(KEY_EVENT_HOST)) {
+            idle_ms = 0;
+            t_last = HAL_GetTick();
+        }
+        hostlink_poll();
+        scope_poll();
+#endif // USER_HOSTLINK
+        // NOTE: bellows movement also counts as activity
+        if (key_event_woken(KEY_EVENT_EXPR)) {
+            idle_ms = 0;
+            t_last = HAL_GetTick();
+        }
+        expr_update();
+        learned_poll();
+        flash_store_poll(false);
+        note_update();
+        if (idle_timeout_ms && HAL_GetTick() - t_last >= idle_timeout_ms) {
+            idle_ms += idle_timeout_ms;
+            if (idle_handler(idle_ms)) idle_ms = 0;
+            t_last = HAL_GetTick();
+        }
+        // sleep until the next interrupt
+        // NOTE: an event pushed between the check and WFI still wakes the
+        // core -- IRQs are masked but pend
+        // NOTE: background work (held-back upstream input, settings being
+        // written) is retried on the next interrupt (at the latest SysTick)
+        cpuload_update();
+        __disable_irq();
+        if (key_events.empty()) {
+            cpuload_idle();
+            __WFI();
+            cpuload_busy();
         }
+        __enable_irq();
     }
+#endif // USER_RTOS
 }
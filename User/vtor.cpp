@@ -0,0 +1,35 @@
+#include "vtor.hpp"
+
+#include <string.h>
+
+#include "user_conf.h"
+
+
+// 16 system exceptions + device IRQs (STM32F103xB: last one is USBWakeUp)
+static const size_t VTOR_n = 16 + USBWakeUp_IRQn + 1;
+
+// NOTE: VTOR requires the table to be aligned to its size rounded up to the
+// next power of 2 (59 words => 256 bytes)
+static_assert(VTOR_n * 4 <= 256, "");
+__attribute__((aligned(256))) static vtor_handler_t vtor_table[VTOR_n];
+const uint16_t vtor_ram_n = sizeof(vtor_table);
+
+static bool vtor_relocated = false;
+
+void vtor_relocate() {
+#if USER_VTOR_RAM
+    if (vtor_relocated) return;
+    memcpy(vtor_table, (const void*)SCB->VTOR, sizeof(vtor_table));
+    // single write => handlers stay valid even if an IRQ fires in between
+    SCB->VTOR = (uint32_t)vtor_table;
+    __DSB();
+    vtor_relocated = true;
+#endif // USER_VTOR_RAM
+}
+
+bool vtor_set(IRQn_Type irq, vtor_handler_t handler) {
+    if (!vtor_relocated) return false;
+    vtor_table[16 + irq] = handler;
+    __DSB();
+    return true;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "stm32f1xx.h"
+
+// vector table relocation to SRAM
+// - handlers are fetched from SRAM instead of FLASH on exception entry
+// - individual handlers can be swapped at run time
+
+typedef void (*vtor_handler_t)(void);
+
+// copy the active (FLASH) vector table to SRAM and point VTOR at it
+// NOTE: no-op unless USER_VTOR_RAM
+void vtor_relocate(void);
+
+// replace the handler of an exception/IRQ
+// return: false if the vector table has not been relocated
+bool vtor_set(IRQn_Type irq, vtor_handler_t handler);
+
+// static RAM: buffers (bytes, see ram.hpp)
+extern const uint16_t vtor_ram_n;